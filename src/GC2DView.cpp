@@ -1,12 +1,19 @@
 #include "GC2DView.h"
 
 #include "GCModel.h"
+#include "GCDiffer.h"
+#include "GCOverhangAnalyzer.h"
+#include "GCArcItem.h"
 #include "GCThreadItem.h"
 #include "GCGraphicsView.h"
+#include "GCJobScheduler.h"
+#include "GCTreeWalker.h"
+#include "GCColors.h"
 #include "GCTree/GCFile.h"
 #include "GCTree/GCLayer.h"
 #include "GCTree/GCPath.h"
 #include "GCTree/GCCommand.h"
+#include "GCTree/GCArcCommand.h"
 
 #include <QGraphicsLineItem>
 #include <QVBoxLayout>
@@ -14,16 +21,119 @@
 #include <QSpacerItem>
 #include <QGroupBox>
 #include <QRadioButton>
+#include <QComboBox>
+#include <QLabel>
+#include <QHash>
 
-const QColor layerColor(0, 127, 0);
-const QColor pathColor(127, 127, 0);
-const QColor commandColor(0, 0, 127);
+const QColor overhangColor(255, 0, 0);
+const QColor unchangedColor(191, 191, 191);
+const QColor addedColor(0, 191, 0);
+const QColor removedColor(255, 0, 0);
+
+// Neighbouring layers simplified ahead on each side of the shown one.
+const int prefetchDistance = 1;
+
+// Simplifies runs of one layer on worker thread, walking the tree the same way as GC2DView::addItem().
+class GCLayerThreadsJob : public GCJob, private GCTreeWalker
+{
+public:
+	explicit GCLayerThreadsJob(const GCTreeItem *layer)
+		: GCJob(),
+		  GCTreeWalker(),
+		  threads(),
+		  m_layer(layer),
+		  m_simplifier()
+	{
+	}
+
+	QHash<const GCCommand *, std::vector<GCPathSimplifier::Thread> > threads;	// Keyed by first command of run.
+
+protected:
+	virtual void run()
+	{
+		walk(m_layer, true, this);
+	}
+
+private:
+	virtual void visitRun(const std::vector<const GCCommand *> &commands, const std::vector<int> &rows)
+	{
+		Q_UNUSED(rows);
+
+		m_simplifier.simplify(commands, threads[commands[0]]);
+	}
+
+	const GCTreeItem *m_layer;
+	GCPathSimplifier m_simplifier;
+};
+
+// Adds items of the walked tree item to the scene, commands are looked up by their rows.
+class GC2DView::ItemAdder : public GCTreeWalker
+{
+public:
+	ItemAdder(GC2DView *view, const QModelIndex &index)
+		: GCTreeWalker(),
+		  m_view(view),
+		  m_parents(1, index)
+	{
+	}
+
+protected:
+	virtual void enterItem(int row)
+	{
+		m_parents.push_back(m_view->model()->index(row, 0, m_parents.back()));
+	}
+
+	virtual void leaveItem()
+	{
+		m_parents.pop_back();
+	}
+
+	virtual void visitRun(const std::vector<const GCCommand *> &commands, const std::vector<int> &rows)
+	{
+		std::vector<QModelIndex> indices;
+
+		for (size_t i = 0; i < rows.size(); ++i) {
+			indices.push_back(m_view->model()->index(rows[i], 0, m_parents.back()));
+		}
+
+		m_view->addThreads(commands, indices);
+	}
+
+	virtual void visitCommand(const GCCommand *gcCommand, int row)
+	{
+		Q_UNUSED(gcCommand);
+
+		m_view->addItem(m_view->model()->index(row, 0, m_parents.back()));
+	}
+
+private:
+	GC2DView *m_view;
+	std::vector<QModelIndex> m_parents;		// Index of the walked item and of the nested items entered.
+};
+
+static void setItemColor(QGraphicsItem *item, const QColor &color)
+{
+	if (GCThreadItem *line = dynamic_cast<GCThreadItem *>(item)) {
+		line->setColor(color);
+	} else if (GCArcItem *arc = dynamic_cast<GCArcItem *>(item)) {
+		arc->setColor(color);
+	}
+}
 
 GC2DView::GC2DView(QWidget *parent)
 	: GCAbstractView(parent),
 	  m_gcGraphicsView(0),
 	  m_offRBtn(0), m_foregroundRBtn(0), m_backgroundRBtn(0),
-	  m_indexToItem(), m_itemToIndex()
+	  m_colorBy(ByLayer),
+	  m_differ(0),
+	  m_overhangAnalyzer(0),
+	  m_indexToItem(), m_itemToIndex(),
+	  m_extrusionNumbers(),
+	  m_simplifier(),
+	  m_threadJobs(),
+	  m_layerThreads(),
+	  m_pinnedLayer(-1),
+	  m_commandHighlight(0)
 {
 	QWidget *mainWidget = new QWidget();
 	QVBoxLayout *vLayout = new QVBoxLayout();
@@ -44,7 +154,14 @@ GC2DView::GC2DView(QWidget *parent)
 	gridGrpBoxLayout->addWidget(m_backgroundRBtn);
 	gridGrpBox->setLayout(gridGrpBoxLayout);
 	m_foregroundRBtn->setChecked(true);
+	QComboBox *colorByCBox = new QComboBox();
+	// Item order follows ColorBy.
+	colorByCBox->addItem(tr("Layer"));
+	colorByCBox->addItem(tr("Overhang"));
+	colorByCBox->addItem(tr("Difference"));
 	QHBoxLayout *hLayout = new QHBoxLayout();
+	hLayout->addWidget(new QLabel(tr("Color by:")));
+	hLayout->addWidget(colorByCBox);
 	hLayout->addSpacerItem(new QSpacerItem(40, 20, QSizePolicy::Expanding, QSizePolicy::Minimum));
 	hLayout->addWidget(gridGrpBox);
 
@@ -56,12 +173,18 @@ GC2DView::GC2DView(QWidget *parent)
 	connect(m_offRBtn, SIGNAL(toggled(bool)), this, SLOT(on_gridRBtn_toggled()));
 	connect(m_foregroundRBtn, SIGNAL(toggled(bool)), this, SLOT(on_gridRBtn_toggled()));
 	connect(m_backgroundRBtn, SIGNAL(toggled(bool)), this, SLOT(on_gridRBtn_toggled()));
+	connect(colorByCBox, SIGNAL(currentIndexChanged(int)), this, SLOT(setColorBy(int)));
 
 	on_gridRBtn_toggled();
 
 	setViewport(mainWidget);
 }
 
+GC2DView::~GC2DView()
+{
+	cancelThreadJobs();
+}
+
 void GC2DView::setGridDimensions(const QRectF &dimensions)
 {
 	m_gcGraphicsView->setGridDimensions(dimensions);
@@ -72,6 +195,16 @@ const QRectF &GC2DView::gridDimensions() const
 	return m_gcGraphicsView->gridDimensions();
 }
 
+void GC2DView::setDiffer(GCDiffer *differ)
+{
+	m_differ = differ;
+}
+
+void GC2DView::setOverhangAnalyzer(GCOverhangAnalyzer *overhangAnalyzer)
+{
+	m_overhangAnalyzer = overhangAnalyzer;
+}
+
 void GC2DView::on_gridRBtn_toggled()
 {
 	if (m_offRBtn->isChecked()) {
@@ -101,21 +234,51 @@ void GC2DView::currentChanged(const QModelIndex &current, const QModelIndex &pre
 	if (currLayer != prevLayer) {
 		// Change layer.
 		clear();
+		pinLayer(currLayer.row());
+
+		// Simplified ahead or, when still queued, right now.
+		m_layerThreads = m_threadJobs.value(currLayer.row());
+		if (m_layerThreads) {
+			m_layerThreads->wait();
+		}
+
+		// Values of extrusions are looked up by their numbers within layer.
+		if (m_colorBy != ByLayer) {
+			std::vector<GCCommand *> extrusions;
+			GCTreeWalker::collectExtrusions(static_cast<GCTreeItem *>(currLayer.internalPointer()), extrusions);
+
+			for (size_t i = 0; i < extrusions.size(); ++i) {
+				m_extrusionNumbers.insert(extrusions[i], static_cast<int>(i));
+			}
+		}
+
 		int numItems = model()->rowCount(currLayer);
 
 		for (int item = 0; item < numItems; ++item) {
 			addItem(model()->index(item, 0, currLayer));
 		}
 
+		int referenceLayer = m_differ ? m_differ->comparedLayer(currLayer.row()) : -1;
+
+		if (m_colorBy == ByDifference && referenceLayer >= 0) {
+			addRemovedItems(referenceLayer);
+		}
+
+		prefetchLayers(currLayer.row());
+
+		emit sceneMemoryChanged(sceneMemoryUsage());
+
 	} else {
+		removeCommandHighlight();
+
 		// Deselect previously selected item.
 		if (prevPathIndex.isValid()) {
-			highlightItem(prevPathIndex, layerColor);
+			highlightItem(prevPathIndex, QColor());
 		}
 
 		if (prevCmdIndex.isValid() && m_indexToItem.contains(prevCmdIndex)) {
 			m_indexToItem[prevCmdIndex]->setSelected(false);
-			highlightItem(prevCmdIndex, layerColor);
+			highlightItem(prevCmdIndex, QColor());
 		}
 
 	}
@@ -131,7 +294,7 @@ void GC2DView::currentChanged(const QModelIndex &current, const QModelIndex &pre
 	if (currCmdIndex.isValid()) {
 		if (m_indexToItem.contains(current)) {
 			m_indexToItem[current]->setSelected(true);
-			highlightItem(currCmdIndex, commandColor);
+			highlightCommand(currCmdIndex);
 		}
 	}
 
@@ -143,6 +306,7 @@ void GC2DView::reset()
 	QAbstractItemView::reset();
 
 	clear();
+	emit sceneMemoryChanged(sceneMemoryUsage());
 }
 
 void GC2DView::selection()
@@ -166,6 +330,26 @@ void GC2DView::selection()
 
 }
 
+void GC2DView::setColorBy(int colorBy)
+{
+	if (m_colorBy == colorBy) {
+		return;
+	}
+
+	m_colorBy = static_cast<ColorBy>(colorBy);
+	updateColors();
+}
+
+void GC2DView::updateColors()
+{
+	if (!model()) {
+		return;
+	}
+
+	// Scene of the shown layer is built again.
+	currentChanged(currentIndex(), QModelIndex());
+}
+
 void GC2DView::addItem(const QModelIndex &index)
 {
 	const GCCommand *gcCommand = dynamic_cast<const GCCommand *>(static_cast<GCTreeItem *>(index.internalPointer()));
@@ -176,23 +360,84 @@ void GC2DView::addItem(const QModelIndex &index)
 			return;
 		}
 
-		GCThreadItem *line = new GCThreadItem(*gcCommand);
+		QGraphicsItem *line;
 
-		if (!line) {
-			return;
+		if (gcCommand->isArc()) {
+			line = new GCArcItem(*static_cast<const GCArcCommand *>(gcCommand));
+		} else {
+			line = new GCThreadItem(*gcCommand);
 		}
 
-		line->setColor(layerColor);
+		setItemColor(line, commandBaseColor(index));
 
 		m_indexToItem.insert(index, line);
 		m_itemToIndex.insert(line, index);
 		m_gcGraphicsView->scene()->addItem(line);
 	} else {
-		int numItems = model()->rowCount(index);
+		// Merged threads have single color, commands are drawn one by one when colored by their values.
+		ItemAdder adder(this, index);
+		adder.walk(static_cast<const GCTreeItem *>(index.internalPointer()), m_colorBy == ByLayer);
+	}
+}
 
-		for (int item = 0; item < numItems; ++item) {
-			addItem(model()->index(item, 0, index));
+void GC2DView::addThreads(const std::vector<const GCCommand *> &commands, const std::vector<QModelIndex> &indices)
+{
+	if (commands.empty()) {
+		return;
+	}
+
+	std::vector<GCPathSimplifier::Thread> threads;
+
+	if (m_layerThreads && m_layerThreads->threads.contains(commands[0])) {
+		threads = m_layerThreads->threads.value(commands[0]);
+	} else {
+		m_simplifier.simplify(commands, threads);
+	}
+
+	for (size_t threadNo = 0; threadNo < threads.size(); ++threadNo) {
+		const GCPathSimplifier::Thread &thread = threads[threadNo];
+
+		GCThreadItem *line = new GCThreadItem(thread.line, thread.width);
+		line->setColor(layerColor);
+
+		for (size_t commandNo = thread.firstCommand; commandNo < thread.firstCommand + thread.numCommands; ++commandNo) {
+			m_indexToItem.insert(indices[commandNo], line);
+		}
+
+		m_itemToIndex.insert(line, indices[thread.firstCommand]);
+		m_gcGraphicsView->scene()->addItem(line);
+	}
+}
+
+void GC2DView::addRemovedItems(int referenceLayer)
+{
+	GCModel *reference = m_differ->reference();
+	std::vector<GCCommand *> extrusions;
+
+	// Compared layers aren't kept loaded.
+	reference->fetchLayer(referenceLayer);
+	GCTreeWalker::collectExtrusions(static_cast<GCTreeItem *>(reference->index(referenceLayer, 0).internalPointer()), extrusions);
+
+	for (size_t i = 0; i < extrusions.size(); ++i) {
+		const GCCommand *gcCommand = extrusions[i];
+
+		if (m_differ->referenceChange(referenceLayer, static_cast<int>(i)) != GCDiffer::Removed) {
+			continue;
 		}
+
+		// Commands of reference have no index in model, they can't be selected.
+		QGraphicsItem *line;
+
+		if (gcCommand->isArc()) {
+			line = new GCArcItem(*static_cast<const GCArcCommand *>(gcCommand));
+		} else {
+			line = new GCThreadItem(*gcCommand);
+		}
+
+		setItemColor(line, removedColor);
+		line->setFlag(QGraphicsItem::ItemIsSelectable, false);
+		line->setZValue(1);
+		m_gcGraphicsView->scene()->addItem(line);
 	}
 }
 
@@ -203,10 +448,27 @@ bool GC2DView::removeItem(const QModelIndex &index)
 	}
 
 	QGraphicsItem *gfxToRemove = m_indexToItem[index];
+	QModelIndex firstIndex = m_itemToIndex.value(gfxToRemove);
+	std::vector<QModelIndex> runIndices;
+
+	// Merged thread is shared by consecutive siblings from its first command on.
+	for (QModelIndex sibling = firstIndex; sibling.isValid() && m_indexToItem.value(sibling) == gfxToRemove;
+		 sibling = sibling.sibling(sibling.row() + 1, 0)) {
+		m_indexToItem.remove(sibling);
+
+		if (sibling != index) {
+			runIndices.push_back(sibling);
+		}
+	}
 
-	m_indexToItem.remove(index);
 	m_itemToIndex.remove(gfxToRemove);
 	m_gcGraphicsView->scene()->removeItem(gfxToRemove);
+	delete gfxToRemove;
+
+	// Rest of the run is drawn command by command.
+	for (size_t i = 0; i < runIndices.size(); ++i) {
+		addItem(runIndices[i]);
+	}
 
 	return true;
 }
@@ -214,7 +476,7 @@ bool GC2DView::removeItem(const QModelIndex &index)
 void GC2DView::highlightItem(const QModelIndex &index, const QColor &color)
 {
 	if (GCModel::type(index) == GCTreeItem::GC_COMMAND && m_indexToItem.contains(index)) {
-		static_cast<GCThreadItem *>(m_indexToItem[index])->setColor(color);
+		setItemColor(m_indexToItem[index], color.isValid() ? color : commandBaseColor(index));
 	} else {
 		int numItems = model()->rowCount(index);
 
@@ -224,9 +486,184 @@ void GC2DView::highlightItem(const QModelIndex &index, const QColor &color)
 	}
 }
 
+QColor GC2DView::commandBaseColor(const QModelIndex &index) const
+{
+	if (m_colorBy == ByLayer) {
+		return layerColor;
+	}
+
+	const GCCommand *gcCommand = static_cast<const GCCommand *>(static_cast<GCTreeItem *>(index.internalPointer()));
+	int layer = GCModel::getLayerIndex(index).row();
+	int extrusion = m_extrusionNumbers.value(gcCommand, -1);
+
+	if (m_colorBy == ByDifference) {
+		return m_differ && m_differ->change(layer, extrusion) == GCDiffer::Added ? addedColor : unchangedColor;
+	}
+
+	double overhang = m_overhangAnalyzer ? m_overhangAnalyzer->overhang(layer, extrusion) : 0.0;
+	overhang = qBound(0.0, overhang, 1.0);
+
+	return QColor::fromRgbF(layerColor.redF() + (overhangColor.redF() - layerColor.redF()) * overhang,
+							layerColor.greenF() + (overhangColor.greenF() - layerColor.greenF()) * overhang,
+							layerColor.blueF() + (overhangColor.blueF() - layerColor.blueF()) * overhang);
+}
+
+void GC2DView::highlightCommand(const QModelIndex &index)
+{
+	QGraphicsItem *item = m_indexToItem[index];
+	const GCCommand *gcCommand = static_cast<const GCCommand *>(static_cast<GCTreeItem *>(index.internalPointer()));
+	GCThreadItem *line = dynamic_cast<GCThreadItem *>(item);
+
+	if (!line || line->line() == gcCommand->thread) {
+		setItemColor(item, commandColor);
+		return;
+	}
+
+	// Command is only a part of merged thread, it is drawn separately on top of it.
+	m_commandHighlight = new GCThreadItem(*gcCommand);
+	m_commandHighlight->setFlag(QGraphicsItem::ItemIsSelectable, false);
+	m_commandHighlight->setColor(commandColor);
+	m_commandHighlight->setZValue(2);
+	m_gcGraphicsView->scene()->addItem(m_commandHighlight);
+}
+
+void GC2DView::removeCommandHighlight()
+{
+	if (m_commandHighlight) {
+		m_gcGraphicsView->scene()->removeItem(m_commandHighlight);
+		delete m_commandHighlight;
+		m_commandHighlight = 0;
+	}
+}
+
+void GC2DView::pinLayer(int layer)
+{
+	if (layer == m_pinnedLayer) {
+		return;
+	}
+
+	// New layer is pinned first, releasing the old one may trim loaded layers.
+	if (layer >= 0) {
+		model()->pinLayers(std::vector<int>(1, layer));
+	}
+
+	if (m_pinnedLayer >= 0) {
+		model()->unpinLayers(std::vector<int>(1, m_pinnedLayer));
+	}
+
+	m_pinnedLayer = layer;
+}
+
+void GC2DView::prefetchLayers(int layer)
+{
+	QMap<int, QSharedPointer<GCLayerThreadsJob> >::iterator it = m_threadJobs.begin();
+
+	// Jobs read the tree, dropped ones must not outlive it.
+	while (it != m_threadJobs.end()) {
+		if (qAbs(it.key() - layer) > prefetchDistance) {
+			it.value()->cancel();
+			it.value()->wait();
+			it = m_threadJobs.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	for (int prefetched = layer - prefetchDistance; prefetched <= layer + prefetchDistance; ++prefetched) {
+		if (prefetched == layer || prefetched < 0 || prefetched >= model()->rowCount()
+				|| m_threadJobs.contains(prefetched)) {
+			continue;
+		}
+
+		// Unloaded layer is parsed on worker thread, it is simplified once inserted.
+		if (model()->canFetchMore(model()->index(prefetched, 0))) {
+			model()->prefetchLayer(prefetched);
+		} else {
+			simplifyLayer(prefetched);
+		}
+	}
+}
+
+void GC2DView::simplifyLayer(int layer)
+{
+	const GCTreeItem *layerItem = static_cast<const GCTreeItem *>(model()->index(layer, 0).internalPointer());
+	QSharedPointer<GCLayerThreadsJob> job(new GCLayerThreadsJob(layerItem));
+
+	m_threadJobs.insert(layer, job);
+	GCJobScheduler::globalInstance()->submit(job, GCJob::Prefetch);
+}
+
+void GC2DView::cancelThreadJobs()
+{
+	QMap<int, QSharedPointer<GCLayerThreadsJob> >::iterator it;
+
+	for (it = m_threadJobs.begin(); it != m_threadJobs.end(); ++it) {
+		it.value()->cancel();
+	}
+
+	for (it = m_threadJobs.begin(); it != m_threadJobs.end(); ++it) {
+		it.value()->wait();
+	}
+
+	m_threadJobs.clear();
+	m_layerThreads.clear();
+}
+
+void GC2DView::modelAboutToBeReset()
+{
+	cancelThreadJobs();
+
+	// Pins go with the layers being reset.
+	m_pinnedLayer = -1;
+}
+
+void GC2DView::rowsInserted(const QModelIndex &parent, int start, int end)
+{
+	int layer = GCModel::getLayerIndex(currentIndex()).row();
+
+	// Prefetched neighbour of shown layer was parsed.
+	if (GCModel::type(parent) == GCTreeItem::GC_LAYER && layer >= 0 && parent.row() != layer
+			&& qAbs(parent.row() - layer) <= prefetchDistance && !m_threadJobs.contains(parent.row())) {
+		simplifyLayer(parent.row());
+	}
+
+	GCAbstractView::rowsInserted(parent, start, end);
+}
+
+void GC2DView::rowsAboutToBeRemoved(const QModelIndex &parent, int start, int end)
+{
+	// Model unloads layers it needs memory for, nothing may keep reading them.
+	if (GCModel::type(parent) == GCTreeItem::GC_LAYER) {
+		QSharedPointer<GCLayerThreadsJob> job = m_threadJobs.take(parent.row());
+
+		// Shown layer is pinned, only neighbours are unloaded.
+		if (job) {
+			job->cancel();
+			job->wait();
+		}
+	}
+
+	GCAbstractView::rowsAboutToBeRemoved(parent, start, end);
+}
+
+qint64 GC2DView::sceneMemoryUsage() const
+{
+	// Rough size of QGraphicsItemPrivate with its scene index entry, Qt does not report it.
+	const qint64 itemPrivateSize = 400;
+	// Key, value and links of a map node.
+	const qint64 mapNodeSize = sizeof(QModelIndex) + sizeof(QGraphicsItem *) + 4 * sizeof(void *);
+
+	qint64 numItems = m_gcGraphicsView->scene()->items().size();
+
+	return numItems * (sizeof(GCThreadItem) + itemPrivateSize)
+			+ (m_indexToItem.size() + m_itemToIndex.size()) * mapNodeSize;
+}
+
 void GC2DView::clear()
 {
+	m_commandHighlight = 0;
 	m_indexToItem.clear();
 	m_itemToIndex.clear();
+	m_extrusionNumbers.clear();
 	m_gcGraphicsView->scene()->clear();
 }
@@ -2,11 +2,22 @@
 #define GC2DVIEW_H
 
 #include "GCAbstractView.h"
+#include "GCPathSimplifier.h"
 
+#include <QSharedPointer>
+#include <QHash>
+#include <vector>
+
+class GCDiffer;
+class GCOverhangAnalyzer;
 class GCModel;
 class QGraphicsItem;
 class GCGraphicsView;
 class QRadioButton;
+class GCCommand;
+class GCThreadItem;
+class GCTreeItem;
+class GCLayerThreadsJob;
 
 class GC2DView : public GCAbstractView
 {
@@ -14,29 +25,73 @@ class GC2DView : public GCAbstractView
 	Q_DISABLE_COPY(GC2DView)
 
 public:
+	enum ColorBy {ByLayer, ByOverhang, ByDifference};
+
 	explicit GC2DView(QWidget *parent = 0);
+	virtual ~GC2DView();
 
 	void setGridDimensions(const QRectF &dimensions);
 	const QRectF &gridDimensions() const;
+	// Extrusions removed from reference are drawn over compared layers when colored by difference.
+	void setDiffer(GCDiffer *differ);
+	// Extrusions are shaded by their scores when colored by overhang.
+	void setOverhangAnalyzer(GCOverhangAnalyzer *overhangAnalyzer);
 
 public slots:
 	void on_gridRBtn_toggled();
 	void currentChanged(const QModelIndex &current, const QModelIndex &previous);
 	void reset();
 	void selection();
+	void setColorBy(int colorBy);
+	// Values of commands changed, e.g. by GCOverhangAnalyzer or GCDiffer.
+	void updateColors();
+
+signals:
+	// Estimated memory taken by items of shown layer.
+	void sceneMemoryChanged(qint64 bytes);
+
+protected slots:
+	virtual void modelAboutToBeReset();
+	virtual void rowsInserted(const QModelIndex &parent, int start, int end);
+	virtual void rowsAboutToBeRemoved(const QModelIndex &parent, int start, int end);
 
 private:
+	class ItemAdder;
+	friend class ItemAdder;
+
 	void addItem(const QModelIndex &index);
+	void addThreads(const std::vector<const GCCommand *> &commands, const std::vector<QModelIndex> &indices);
+	void addRemovedItems(int referenceLayer);
+	void highlightCommand(const QModelIndex &index);
+	void removeCommandHighlight();
 	bool removeItem(const QModelIndex &index);
+	// Invalid color restores colors of commands.
 	void highlightItem(const QModelIndex &index, const QColor &color);
+	QColor commandBaseColor(const QModelIndex &index) const;
 	void clear();
+	qint64 sceneMemoryUsage() const;
+	// Shown layer stays loaded while neighbours are prefetched, previous one is released.
+	void pinLayer(int layer);
+	void prefetchLayers(int layer);
+	void simplifyLayer(int layer);
+	void cancelThreadJobs();
 
 	GCGraphicsView *m_gcGraphicsView;
 
 	QRadioButton *m_offRBtn, *m_foregroundRBtn, *m_backgroundRBtn;
+	ColorBy m_colorBy;
+	GCDiffer *m_differ;
+	GCOverhangAnalyzer *m_overhangAnalyzer;
 
 	QMap<QModelIndex, QGraphicsItem *> m_indexToItem;
-	QMap<QGraphicsItem *, QModelIndex> m_itemToIndex;
+	QMap<QGraphicsItem *, QModelIndex> m_itemToIndex;	// Merged threads map to their first command.
+	QHash<const GCCommand *, int> m_extrusionNumbers;	// Extrusions of shown layer in tree order, when colored by values.
+
+	GCPathSimplifier m_simplifier;
+	QMap<int, QSharedPointer<GCLayerThreadsJob> > m_threadJobs;	// Runs of layers around the current one simplified ahead.
+	QSharedPointer<GCLayerThreadsJob> m_layerThreads;				// Job of the shown layer.
+	int m_pinnedLayer;						// Shown layer, -1 for none.
+	GCThreadItem *m_commandHighlight;		// Selected command drawn over the thread it was merged into.
 };
 
 #endif // GC2DVIEW_H
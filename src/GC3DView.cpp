@@ -1,27 +1,81 @@
 #include "GC3DView.h"
 #include "GCGLView.h"
+#include "GCJobScheduler.h"
+#include "GCOverhangAnalyzer.h"
+#include "GCDiffer.h"
+#include "GCTrace.h"
+#include "GCColors.h"
 #include "GCTree/GCPath.h"
 #include "GCTree/GCCommand.h"
+#include "GCTree/GCArcCommand.h"
 
 #include <QHBoxLayout>
 #include <QVBoxLayout>
 #include <QCheckBox>
+#include <QComboBox>
+#include <QLabel>
+#include <QSlider>
 
 #include <vector>
+#include <algorithm>
 #include <cmath>
+#include <cfloat>
 
 const QColor objectColor(127, 0, 0);
-const QColor layerColor(0, 127, 0);
-const QColor pathColor(127, 127, 0);
-const QColor commandColor(0, 0, 127);
+const QColor travelColor(90, 90, 160);
+
+// Arcs in line tier don't follow LOD.
+const double lineArcTolerance = 0.05;
+
+// Hidden layers above the selected one meshed ahead, they are shown next when stepping up.
+const size_t prefetchLayerCount = 2;
+
+// Meshes one layer on a worker thread with its own copy of the mesher.
+class GCMeshJob : public GCJob
+{
+public:
+	GCMeshJob(const GCLayerMesher &mesher, const GCTreeItem *layer, GLuint firstSegment)
+		: GCJob(),
+		  mesh(),
+		  m_mesher(mesher),
+		  m_layer(layer),
+		  m_firstSegment(firstSegment)
+	{
+	}
+
+	GCGLView::Mesh mesh;
+
+protected:
+	virtual void run()
+	{
+		GC_TRACE_SCOPE("mesh layer");
+
+		m_mesher.meshLayer(m_layer, m_firstSegment, mesh, this);
+
+		GC_TRACE_COUNTER("layer vertices", mesh.vertices.size());
+		GC_TRACE_COUNTER("layer indices", mesh.indices.size() + mesh.coarseIndices.size());
+	}
+
+private:
+	GCLayerMesher m_mesher;
+	const GCTreeItem *m_layer;
+	GLuint m_firstSegment;
+};
 
 GC3DView::GC3DView(QWidget *parent)
 	: GCAbstractView(parent),
 	  m_GCGLView(0),
-	  m_vertices(), m_indices(),
+	  m_mesher(),
+	  m_meshJobs(),
 	  m_itemRanges(),
-	  m_halfFacePoints(0),
-	  m_sinTable(), m_cosTable()
+	  m_layerRanges(),
+	  m_indexedLayers(),
+	  m_firstLayerSlider(0), m_lastLayerSlider(0),
+	  m_colorBy(BySelection),
+	  m_overhangAnalyzer(0),
+	  m_differ(0),
+	  m_dirty(true),
+	  m_prewarm(false)
 {
 	QWidget *mainWidget = new QWidget();
 	QVBoxLayout *vLayout = new QVBoxLayout();
@@ -29,19 +83,61 @@ GC3DView::GC3DView(QWidget *parent)
 
 	QHBoxLayout *hLayout = new QHBoxLayout();
 	QCheckBox *hideLayersChkB = new QCheckBox(tr("Hide &upper layers"));
+	QCheckBox *travelMovesChkB = new QCheckBox(tr("Show &travel moves"));
+	QCheckBox *overviewChkB = new QCheckBox(tr("&Overview (lines only)"));
+	QCheckBox *statisticsChkB = new QCheckBox(tr("Show &statistics"));
+	QComboBox *colorByCBox = new QComboBox();
+	// Item order follows ColorBy.
+	colorByCBox->addItem(tr("Selection"));
+	colorByCBox->addItem(tr("Extrusion width"));
+	colorByCBox->addItem(tr("Layer height"));
+	colorByCBox->addItem(tr("Move time"));
+	colorByCBox->addItem(tr("Overhang"));
+	colorByCBox->addItem(tr("Added extrusions"));
+	hLayout->addWidget(new QLabel(tr("Color by:")));
+	hLayout->addWidget(colorByCBox);
 	hLayout->addSpacerItem(new QSpacerItem(40, 20, QSizePolicy::Expanding, QSizePolicy::Minimum));
+	hLayout->addWidget(statisticsChkB);
+	hLayout->addWidget(overviewChkB);
+	hLayout->addWidget(travelMovesChkB);
 	hLayout->addWidget(hideLayersChkB);
 
 	m_GCGLView = new GCGLView(this);
-
-	vLayout->addWidget(m_GCGLView);
+	m_GCGLView->setHighlightColors(objectColor, layerColor, pathColor, commandColor);
+	m_GCGLView->setTravelColor(travelColor);
+
+	// Visible layers range, shown right of the GL view.
+	m_firstLayerSlider = new QSlider(Qt::Vertical);
+	m_firstLayerSlider->setToolTip(tr("First visible layer"));
+	m_firstLayerSlider->setEnabled(false);
+	m_lastLayerSlider = new QSlider(Qt::Vertical);
+	m_lastLayerSlider->setToolTip(tr("Last visible layer"));
+	m_lastLayerSlider->setEnabled(false);
+
+	QHBoxLayout *viewLayout = new QHBoxLayout();
+	viewLayout->addWidget(m_GCGLView);
+	viewLayout->addWidget(m_firstLayerSlider);
+	viewLayout->addWidget(m_lastLayerSlider);
+
+	vLayout->addLayout(viewLayout);
 	vLayout->addLayout(hLayout);
 
 	connect(hideLayersChkB, SIGNAL(stateChanged(int)), this, SLOT(hideUpperLayers(int)));
+	connect(travelMovesChkB, SIGNAL(stateChanged(int)), this, SLOT(showTravelMoves(int)));
+	connect(overviewChkB, SIGNAL(stateChanged(int)), this, SLOT(setOverview(int)));
+	connect(statisticsChkB, SIGNAL(stateChanged(int)), this, SLOT(showStatistics(int)));
+	connect(colorByCBox, SIGNAL(currentIndexChanged(int)), this, SLOT(setColorBy(int)));
+	connect(m_GCGLView, SIGNAL(segmentPicked(int)), this, SLOT(selectSegment(int)));
+	connect(m_GCGLView, SIGNAL(layerRequested(int)), this, SLOT(buildLayer(int)));
+	connect(m_firstLayerSlider, SIGNAL(valueChanged(int)), this, SLOT(firstLayerChanged(int)));
+	connect(m_lastLayerSlider, SIGNAL(valueChanged(int)), this, SLOT(lastLayerChanged(int)));
 
 	setViewport(mainWidget);
+}
 
-	setLOD(3);
+GC3DView::~GC3DView()
+{
+	cancelMeshJobs();
 }
 
 void GC3DView::setGridDimensions(const QRectF &dimensions)
@@ -56,374 +152,776 @@ const QRectF &GC3DView::gridDimensions() const
 
 void GC3DView::setLOD(unsigned char LOD)
 {
-	if (LOD == this->LOD() && m_halfFacePoints != 0) {
+	if (LOD == this->LOD()) {
 		return;
 	}
 
-	m_halfFacePoints = LOD + 2;
+	m_mesher.setLOD(LOD);
 
-	// Recalculate goniometric tables.
-	double angle = 0;
-	double angleStep = M_PI / (m_halfFacePoints - 1);
+	rebuild();
+}
 
-	m_sinTable = std::vector<double>();
-	m_cosTable = std::vector<double>();
-	for (GLuint i = 0; i < m_halfFacePoints * 2; i++, angle += angleStep) {
-		if (i == m_halfFacePoints) {
-			angle -= angleStep;
-		}
+unsigned char GC3DView::LOD() const
+{
+	return m_mesher.LOD();
+}
 
-		m_sinTable.push_back(sin(angle));
-		m_cosTable.push_back(cos(angle));
-	}
+void GC3DView::setMemoryBudget(size_t bytes)
+{
+	m_GCGLView->setMemoryBudget(bytes);
+}
 
-	// Reload data.
-	loadGCData();
-	m_GCGLView->bufferGCData(m_vertices, m_indices);
+size_t GC3DView::memoryBudget() const
+{
+	return m_GCGLView->memoryBudget();
+}
 
-	// Reselect selected item.
-	if (selectionModel()) {
-		currentChanged(selectionModel()->currentIndex(), QModelIndex());
+void GC3DView::setPrewarm(bool prewarm)
+{
+	m_prewarm = prewarm;
+
+	if (m_prewarm && m_dirty) {
+		prewarmLayers();
 	}
 }
 
-unsigned char GC3DView::LOD() const
+bool GC3DView::prewarm() const
 {
-	return static_cast<unsigned char>(m_halfFacePoints - 2);
+	return m_prewarm;
 }
 
-void GC3DView::addThreadHullIndices()
+void GC3DView::setOverhangAnalyzer(GCOverhangAnalyzer *overhangAnalyzer)
 {
-	GLuint numFacePoints = m_halfFacePoints * 2;
+	m_overhangAnalyzer = overhangAnalyzer;
+}
 
-	if (m_vertices.size() < numFacePoints * 2) {
-		return;
+void GC3DView::setDiffer(GCDiffer *differ)
+{
+	m_differ = differ;
+}
+
+QModelIndex GC3DView::indexAt(const QPoint &point) const
+{
+	return segmentIndex(m_GCGLView->pickSegment(m_GCGLView->mapFrom(viewport(), point)));
+}
+
+QImage GC3DView::renderImage(const QSize &size, GCGLView::ViewDirection direction)
+{
+	GC_TRACE_SCOPE("render model");
+
+	refresh();
+
+	// Extent comes from scan, layers needn't be loaded for it.
+	const GCLayerStats &stats = model() ? model()->totalStats() : GCLayerStats();
+	QVector3D minCorner(stats.minX, stats.minY, stats.minZ);
+	QVector3D maxCorner(stats.maxX, stats.maxY, stats.maxZ);
+
+	// Model without extrusions shows empty bed.
+	if (!stats.numExtrusions) {
+		const QRectF &grid = gridDimensions();
+		minCorner = QVector3D(grid.left(), grid.top(), 0);
+		maxCorner = QVector3D(grid.right(), grid.bottom(), 0);
+	}
+
+	if (!m_GCGLView->beginImage(size, direction, minCorner, maxCorner)) {
+		return QImage();
 	}
 
-	GLuint threadStartVertexIndex = static_cast<GLuint>(m_vertices.size()) - numFacePoints * 2;
+	int firstShown = m_firstLayerSlider->value();
+	int lastShown = m_lastLayerSlider->value();
+	int numLayers = static_cast<int>(m_layerRanges.size());
+
+	// Layers are meshed in parallel a batch at a time, only the batch is pinned and held in memory.
+	int batchSize = qMax(GCJobScheduler::globalInstance()->numWorkers(), 1);
 
-	for (GLuint pointNo = 0; pointNo < numFacePoints; pointNo++) {
-		m_indices.push_back(threadStartVertexIndex + pointNo);
-		m_indices.push_back(threadStartVertexIndex + (pointNo + 1) % numFacePoints);
-		m_indices.push_back(threadStartVertexIndex + pointNo + numFacePoints);
+	for (int firstLayer = 0; firstLayer < numLayers; firstLayer += batchSize) {
+		int endLayer = qMin(firstLayer + batchSize, numLayers);
 
-		m_indices.push_back(threadStartVertexIndex + (pointNo + 1) % numFacePoints);
-		m_indices.push_back(threadStartVertexIndex + (pointNo + 1) % numFacePoints + numFacePoints);
-		m_indices.push_back(threadStartVertexIndex + pointNo + numFacePoints);
+		showLayers(firstLayer, endLayer - 1);
+
+		for (int layer = firstLayer; layer < endLayer; ++layer) {
+			if (!m_GCGLView->isLayerCached(static_cast<size_t>(layer))) {
+				requestLayer(layer, GCJob::Visible);
+			}
+		}
+
+		// Each mesh is painted right after upload, next upload may evict it.
+		for (int layer = firstLayer; layer < endLayer; ++layer) {
+			QSharedPointer<GCMeshJob> job = m_meshJobs.take(layer);
+
+			if (job) {
+				job->wait();
+
+				if (!job->isCanceled()) {
+					m_GCGLView->bufferLayer(static_cast<size_t>(layer), job->mesh);
+				}
+			}
+
+			m_GCGLView->paintImageLayers(static_cast<size_t>(layer), static_cast<size_t>(layer + 1));
+		}
 	}
+
+	showLayers(firstShown, lastShown);
+
+	return m_GCGLView->endImage();
 }
 
-void GC3DView::addThreadFaceIndices(bool start)
+void GC3DView::rebuild()
 {
-	GLuint numFacePoints = m_halfFacePoints * 2;
-
-	if (m_vertices.size() < numFacePoints + 1) {
+	// Not indexed yet, new settings apply once it is.
+	if (m_dirty) {
 		return;
 	}
 
-	GLuint faceStart = static_cast<GLuint>(m_vertices.size()) - (numFacePoints + 1);
+	// Meshes of old LOD would be uploaded after new data.
+	cancelMeshJobs();
 
-	if (start) {
+	uploadLines(true);
+	updateVisibleLayers();
 
-		for (GLuint pointNo = 0; pointNo < numFacePoints; pointNo++) {
-			m_indices.push_back(faceStart + numFacePoints); // center.
-			m_indices.push_back(faceStart + (pointNo + 1) % numFacePoints);
-			m_indices.push_back(faceStart + pointNo);
-		}
-	} else {
-
-		for (GLuint pointNo = 0; pointNo < numFacePoints; pointNo++) {
-			m_indices.push_back(faceStart + pointNo);
-			m_indices.push_back(faceStart + (pointNo + 1) % numFacePoints);
-			m_indices.push_back(faceStart + numFacePoints); // center.
-		}
+	// Reselect selected item.
+	if (selectionModel()) {
+		currentChanged(selectionModel()->currentIndex(), QModelIndex());
 	}
 }
 
-std::vector<GCGLView::Vertex> GC3DView::getThreadVertices(QLineF thread, double width, double height, double z)
+void GC3DView::addLine(const GCCommand *move, GLuint segment, LayerRange &layerRange)
 {
-	std::vector<GCGLView::Vertex> vertices;
-	vertices.reserve(m_halfFacePoints * 2);
+	// Extrusions run through tube centre, travels at nozzle height.
+	GLfloat z = static_cast<GLfloat>(move->threadWidth != 0.0 ? move->z - move->threadHeight / 2 : move->z);
+
+	layerRange.zRange.first = qMin(layerRange.zRange.first, z);
+	layerRange.zRange.second = qMax(layerRange.zRange.second, z);
 
-	if (width < height) {
-		width = height;
+	std::vector<QPointF> points;
+
+	if (move->isArc()) {
+		static_cast<const GCArcCommand *>(move)->arcPolyline(lineArcTolerance, points);
+	} else {
+		points.push_back(move->thread.p1());
+		points.push_back(move->thread.p2());
 	}
 
-	double radius = height / 2;
-	double centerOffset = width / 2 - radius;
+	GCGLView::LineVertex vertex = {{0.0f, 0.0f, z}, segment};
+
+	for (size_t pointNo = 0; pointNo + 1 < points.size(); ++pointNo) {
+		vertex.position[0] = static_cast<GLfloat>(points[pointNo].x());
+		vertex.position[1] = static_cast<GLfloat>(points[pointNo].y());
+		layerRange.lines.push_back(vertex);
+
+		vertex.position[0] = static_cast<GLfloat>(points[pointNo + 1].x());
+		vertex.position[1] = static_cast<GLfloat>(points[pointNo + 1].y());
+		layerRange.lines.push_back(vertex);
+	}
+}
 
-	if (m_halfFacePoints % 2 == 0) {
-		double missingHalfWidth = radius - radius * m_sinTable[m_halfFacePoints / 2];
-		centerOffset += missingHalfWidth;
+bool GC3DView::indexItem(const QModelIndex &index, LayerRange &layerRange, GLuint &segment)
+{
+	if (!model() || !index.isValid()) {
+		return false;
 	}
 
-	QVector2D normal(thread.dy(), -thread.dx());
-	normal.normalize();
-	QVector2D centerVect = normal * centerOffset;
-	double centerZ = z - radius;
+	GLuint startSegment = segment;
 
-	GCGLView::Vertex vertex;
+	const GCCommand *gcCommand = dynamic_cast<const GCCommand *>(static_cast<GCTreeItem *>(index.internalPointer()));
 
-	for (GLuint pointNo = 0; pointNo < m_halfFacePoints * 2; pointNo++) {
+	if (gcCommand) {
+		if (!gcCommand->isMove()) {
+			return false;
+		}
+
+		if (gcCommand->threadWidth == 0.0) {
+			// Travel move, drawn as line only.
+			addLine(gcCommand, GCGLView::travelSegment, layerRange);
+			return false;
+		}
 
-		if (pointNo == m_halfFacePoints) {
-			centerVect *= -1;
+		// Layer stats count extrusions alike, reserved IDs don't run out.
+		if (segment >= layerRange.endSegment) {
+			return false;
 		}
 
-		vertex.position[0] = static_cast<GLfloat>(m_sinTable[pointNo] * normal.x() * radius + centerVect.x() + thread.p1().x());
-		vertex.position[1] = static_cast<GLfloat>(m_sinTable[pointNo] * normal.y() * radius + centerVect.y() + thread.p1().y());
-		vertex.position[2] = static_cast<GLfloat>(centerZ + m_cosTable[pointNo] * radius);
+		layerRange.zRange.first = qMin(layerRange.zRange.first, static_cast<GLfloat>(gcCommand->z - gcCommand->threadHeight));
+		layerRange.zRange.second = qMax(layerRange.zRange.second, static_cast<GLfloat>(gcCommand->z));
 
-		vertex.normal[0] = static_cast<GLfloat>(m_sinTable[pointNo] * normal.x());
-		vertex.normal[1] = static_cast<GLfloat>(m_sinTable[pointNo] * normal.y());
-		vertex.normal[2] = static_cast<GLfloat>(m_cosTable[pointNo]);
+		addLine(gcCommand, segment, layerRange);
+		layerRange.segmentIndices[segment++ - layerRange.firstSegment] = index;
+	} else {
+		int numItems = model()->rowCount(index);
 
-		vertices.push_back(vertex);
+		for (int itemNo = 0; itemNo < numItems; ++itemNo) {
+			indexItem(model()->index(itemNo, 0, index), layerRange, segment);
+		}
 	}
 
-	return vertices;
+	m_itemRanges.insert(index, ItemRange(startSegment, segment));
+	return true;
 }
 
-void GC3DView::terminatePath(const GCCommand *path)
+void GC3DView::unindexItem(const QModelIndex &index)
 {
-	if (!path || m_vertices.size() < m_halfFacePoints * 2) {
-		return;
+	m_itemRanges.remove(index);
+
+	int numItems = model()->rowCount(index);
+
+	for (int itemNo = 0; itemNo < numItems; ++itemNo) {
+		unindexItem(model()->index(itemNo, 0, index));
 	}
+}
 
-	QLineF normal = path->thread.unitVector();
-	GLfloat normalX = static_cast<GLfloat>(normal.dx());
-	GLfloat normalY = static_cast<GLfloat>(normal.dy());
+GC3DView::ItemRange GC3DView::getHgltRange(const QModelIndex &index) const
+{
+	if (index.isValid() && m_itemRanges.contains(index)) {
+		return m_itemRanges[index];
+	} else {
+		return ItemRange();
+	}
+}
 
-	size_t start = m_vertices.size() - m_halfFacePoints * 2;
-	size_t end = m_vertices.size();
+QModelIndex GC3DView::segmentIndex(int segment) const
+{
+	if (segment < 0) {
+		return QModelIndex();
+	}
 
-	GCGLView::Vertex vertex;
+	// Layers hold consecutive segments, the first one ending after segment holds it.
+	size_t first = 0;
+	size_t end = m_layerRanges.size();
 
-	for (; start < end; start++) {
-		vertex = m_vertices[start];
-		vertex.normal[0] = normalX;
-		vertex.normal[1] = normalY;
-		vertex.normal[2] = 0;
+	while (first < end) {
+		size_t middle = (first + end) / 2;
 
-		m_vertices.push_back(vertex);
+		if (m_layerRanges[middle].endSegment <= static_cast<GLuint>(segment)) {
+			first = middle + 1;
+		} else {
+			end = middle;
+		}
 	}
 
-	vertex.position[0] = static_cast<GLfloat>(path->thread.p2().x());
-	vertex.position[1] = static_cast<GLfloat>(path->thread.p2().y());
-	vertex.position[2] = static_cast<GLfloat>(path->z - (path->threadHeight / 2));
+	if (first == m_layerRanges.size()) {
+		return QModelIndex();
+	}
 
-	m_vertices.push_back(vertex);
+	const LayerRange &layerRange = m_layerRanges[first];
+	size_t n = static_cast<GLuint>(segment) - layerRange.firstSegment;
 
-	addThreadFaceIndices(false);
+	return n < layerRange.segmentIndices.size() ? layerRange.segmentIndices[n] : QModelIndex();
 }
 
-void GC3DView::addThread(const GCCommand *thread, const GCCommand *prevThread)
+void GC3DView::updateSegmentScalars()
 {
-	if (!thread) {
+	if (m_colorBy == BySelection) {
+		m_GCGLView->setColorMode(GCGLView::HighlightColor);
 		return;
 	}
 
-	std::vector<GCGLView::Vertex> vertices = getThreadVertices(thread->thread, thread->threadWidth,
-			thread->threadHeight, thread->z);
-	GCGLView::Vertex vertex;
+	// Only indexed layers are drawn, scalars cover just their segments.
+	int firstLayer = m_indexedLayers.first;
+	int endLayer = m_indexedLayers.second;
+	GLuint firstSegment = firstLayer < endLayer ? m_layerRanges[firstLayer].firstSegment : 0;
+	GLuint endSegment = firstLayer < endLayer ? m_layerRanges[endLayer - 1].endSegment : 0;
 
-	if (!prevThread) {
-		QLineF normal = thread->thread.unitVector();
-		GLfloat normalX = static_cast<GLfloat>(-normal.dx());
-		GLfloat normalY = static_cast<GLfloat>(-normal.dy());
+	std::vector<GLfloat> scalars;
+	scalars.reserve(endSegment - firstSegment);
 
-		for (std::vector<GCGLView::Vertex>::const_iterator i = vertices.begin(); i != vertices.end(); ++i) {
-			vertex = *i;
-			vertex.normal[0] = normalX;
-			vertex.normal[1] = normalY;
-			vertex.normal[2] = 0;
+	GLfloat min = 0;
+	GLfloat max = 0;
+	bool found = false;
 
-			m_vertices.push_back(vertex);
-		}
+	for (int layer = firstLayer; layer < endLayer; ++layer) {
+		const LayerRange &layerRange = m_layerRanges[layer];
 
-		vertex.position[0] = static_cast<GLfloat>(thread->thread.p1().x());
-		vertex.position[1] = static_cast<GLfloat>(thread->thread.p1().y());
-		vertex.position[2] = static_cast<GLfloat>(thread->z - thread->threadHeight / 2);
-		vertex.normal[0] = normalX;
-		vertex.normal[1] = normalY;
-		vertex.normal[2] = 0;
+		for (GLuint segment = layerRange.firstSegment; segment < layerRange.endSegment; ++segment) {
+			// Segments of layer are its extrusions in tree order.
+			int extrusion = static_cast<int>(segment - layerRange.firstSegment);
 
-		m_vertices.push_back(vertex);
+			// Reserved segments beyond the extrusions found aren't drawn.
+			if (static_cast<size_t>(extrusion) >= layerRange.segmentIndices.size()
+					|| !layerRange.segmentIndices[extrusion].isValid()) {
+				scalars.push_back(0);
+				continue;
+			}
 
-		addThreadFaceIndices(true);
-	} else if (m_vertices.size() >= m_halfFacePoints * 2) {
-		// Create interconnection segment.
+			const GCCommand *gcCommand = static_cast<const GCCommand *>(static_cast<GCTreeItem *>(layerRange.segmentIndices[extrusion].internalPointer()));
+			GLfloat value;
+
+			switch (m_colorBy) {
+			case ByWidth:
+				value = static_cast<GLfloat>(gcCommand->threadWidth);
+				break;
+			case ByHeight:
+				value = static_cast<GLfloat>(gcCommand->threadHeight);
+				break;
+			case ByOverhang:
+				value = m_overhangAnalyzer ? static_cast<GLfloat>(m_overhangAnalyzer->overhang(layer, extrusion)) : 0.0f;
+				break;
+			case ByDifference:
+				value = m_differ && m_differ->change(layer, extrusion) == GCDiffer::Added ? 1.0f : 0.0f;
+				break;
+			default:
+				value = static_cast<GLfloat>(gcCommand->time);
+				break;
+			}
 
-		double  deltaAngle = thread->thread.angleTo(prevThread->thread) * (M_PI / 180.0) / 2.0;
+			if (!found || value < min) {
+				min = value;
+			}
+
+			if (!found || value > max) {
+				max = value;
+			}
 
-		if (deltaAngle > M_PI / 2.0) {
-			deltaAngle -= M_PI;
+			found = true;
+			scalars.push_back(value);
 		}
+	}
 
-		// Copy last inserted vertices and adjust normals.
-		GCGLView::Vertex vertex;
+	// Overhang is a share and difference a flag, their colours don't depend on the values found.
+	if (m_colorBy == ByOverhang || m_colorBy == ByDifference) {
+		min = 0;
+		max = 1;
+	}
 
-		size_t start = m_vertices.size() - m_halfFacePoints * 2 - 1;
-		size_t end = m_vertices.size();
+	m_GCGLView->setSegmentScalars(scalars, firstSegment, min, max);
+	m_GCGLView->setColorMode(GCGLView::ScalarColor);
+}
 
-		GLfloat cosDAngle = static_cast<GLfloat>(cos(deltaAngle));
-		GLfloat sinDAngle = static_cast<GLfloat>(sin(deltaAngle));
+void GC3DView::indexLayers(int firstLayer, int endLayer)
+{
+	if (!model() || (firstLayer == m_indexedLayers.first && endLayer == m_indexedLayers.second)) {
+		return;
+	}
 
-		for (size_t i = start; i < end; i++) {
-			vertex = m_vertices[i];
-			GLfloat nX = vertex.normal[0];
-			GLfloat nY = vertex.normal[1];
+	GC_TRACE_SCOPE("index");
 
-			vertex.normal[0] = nX * cosDAngle - nY * sinDAngle;
-			vertex.normal[1] = nX * sinDAngle + nY * cosDAngle;
+	std::vector<int> pinned;
+	std::vector<int> released;
 
-			m_vertices.push_back(vertex);
+	for (int layer = firstLayer; layer < endLayer; ++layer) {
+		if (!m_layerRanges[layer].indexed) {
+			pinned.push_back(layer);
 		}
+	}
 
-		// Insert this segment vertices with adjusted normals.
-		cosDAngle = static_cast<GLfloat>(cos(-deltaAngle));
-		sinDAngle = static_cast<GLfloat>(sin(-deltaAngle));
+	for (int layer = m_indexedLayers.first; layer < m_indexedLayers.second; ++layer) {
+		if (layer < firstLayer || layer >= endLayer) {
+			released.push_back(layer);
+		}
+	}
 
-		for (std::vector<GCGLView::Vertex>::const_iterator i = vertices.begin(); i != vertices.end(); ++i) {
-			vertex = *i;
-			GLfloat nX = vertex.normal[0];
-			GLfloat nY = vertex.normal[1];
+	m_indexedLayers = QPair<int, int>(firstLayer, endLayer);
 
-			vertex.normal[0] = nX * cosDAngle - nY * sinDAngle;
-			vertex.normal[1] = nX * sinDAngle + nY * cosDAngle;
+	if (pinned.empty() && released.empty()) {
+		return;
+	}
 
-			m_vertices.push_back(vertex);
-		}
+	model()->pinLayers(pinned);
 
-		addThreadHullIndices();
+	// Mesh jobs and indices of released layers must be gone before model may unload them.
+	for (size_t i = 0; i < released.size(); ++i) {
+		cancelMeshJob(released[i]);
+		unindexLayer(released[i]);
 	}
 
-	m_vertices.insert(m_vertices.end(), vertices.begin(), vertices.end());
-	GLfloat dX = static_cast<GLfloat>(thread->thread.dx());
-	GLfloat dY = static_cast<GLfloat>(thread->thread.dy());
+	model()->unpinLayers(released);
+
+	for (size_t i = 0; i < pinned.size(); ++i) {
+		indexLayer(pinned[i]);
+	}
 
-	for (std::vector<GCGLView::Vertex>::const_iterator i = vertices.begin(); i != vertices.end(); ++i) {
-		vertex = *i;
-		vertex.position[0] += dX;
-		vertex.position[1] += dY;
+	uploadLines(false);
+	updateSegmentScalars();
 
-		m_vertices.push_back(vertex);
+	// Highlight of selected item may cover newly indexed layers.
+	if (selectionModel()) {
+		currentChanged(selectionModel()->currentIndex(), QModelIndex());
 	}
+}
 
-	addThreadHullIndices();
+void GC3DView::indexLayer(int layer)
+{
+	LayerRange &layerRange = m_layerRanges[layer];
+	GLuint segment = layerRange.firstSegment;
+
+	layerRange.segmentIndices.assign(layerRange.endSegment - layerRange.firstSegment, QModelIndex());
+	indexItem(model()->index(layer, 0), layerRange, segment);
+	layerRange.indexed = true;
 }
 
-bool GC3DView::addItem(const QModelIndex &index, QModelIndex &previous)
+void GC3DView::unindexLayer(int layer)
 {
-	if (!model() || !index.isValid()) {
-		return false;
-	}
+	LayerRange &layerRange = m_layerRanges[layer];
 
-	size_t startIndex = m_indices.size();
+	unindexItem(model()->index(layer, 0));
+	layerRange.segmentIndices = std::vector<QModelIndex>();
 
-	const GCCommand *gcCommand = dynamic_cast<const GCCommand *>(static_cast<GCTreeItem *>(index.internalPointer()));
-	const GCCommand *prevCommand = dynamic_cast<const GCCommand *>(static_cast<GCTreeItem *>(previous.internalPointer()));
+	layerRange.indexed = false;
+	layerRange.lines = std::vector<GCGLView::LineVertex>();
+	layerRange.zRange = QPair<GLfloat, GLfloat>(FLT_MAX, -FLT_MAX);
+}
 
-	if (gcCommand) {
-		if (!gcCommand->thread.isNull()) {
-
-			if (gcCommand->threadWidth != 0.0) {
-				addThread(gcCommand, prevCommand);
-				previous = index;
-			} else {
-				// Travel move, break path.
-				terminatePath(prevCommand);
-				m_itemRanges[previous].second = m_indices.size();
-				previous = QModelIndex();
-				return false;
-			}
+void GC3DView::uploadLines(bool resetMeshes)
+{
+	// Lines of indexed layers are drawn from single buffer, in layer order.
+	std::vector<GCGLView::LineVertex> lineVertices;
+	std::vector<size_t> layerLinesEnd;
+	layerLinesEnd.reserve(m_layerRanges.size());
+	size_t numIndexedSegments = 0;
+
+	for (size_t layer = 0; layer < m_layerRanges.size(); ++layer) {
+		const std::vector<GCGLView::LineVertex> &lines = m_layerRanges[layer].lines;
+
+		lineVertices.insert(lineVertices.end(), lines.begin(), lines.end());
+		layerLinesEnd.push_back(lineVertices.size());
+		numIndexedSegments += m_layerRanges[layer].segmentIndices.size();
+	}
 
-			m_itemRanges.insert(index, QPair<size_t, size_t>(startIndex, m_indices.size()));
-			return true;
-		}
+	GC_TRACE_COUNTER("segments", numIndexedSegments);
+	GC_TRACE_COUNTER("line vertices", lineVertices.size());
+
+	if (resetMeshes) {
+		m_GCGLView->bufferGCData(lineVertices, layerLinesEnd);
 	} else {
-		int numItems = model()->rowCount(index);
+		m_GCGLView->bufferLines(lineVertices, layerLinesEnd);
+	}
 
-		for (int itemNo = 0; itemNo < numItems; ++itemNo) {
-			addItem(model()->index(itemNo, 0, index), previous);
-		}
+	if (!model()) {
+		return;
+	}
+
+	// Map nodes are counted without allocator overhead.
+	m_GCGLView->setMemoryCounter(tr("Model"), model()->memoryUsage());
+	m_GCGLView->setMemoryCounter(tr("3D index"),
+								 static_cast<qint64>(lineVertices.size() * sizeof(GCGLView::LineVertex)
+													 + numIndexedSegments * sizeof(QModelIndex)
+													 + m_layerRanges.size() * sizeof(LayerRange)
+													 + m_itemRanges.size() * (sizeof(QModelIndex) + sizeof(ItemRange))));
+}
 
-		if (previous != QModelIndex()) {
-			const GCCommand *prevCommand = dynamic_cast<const GCCommand *>(static_cast<GCTreeItem *>(previous.internalPointer()));
-			terminatePath(prevCommand);
-			m_itemRanges[previous].second = m_indices.size();
-			previous = QModelIndex();
+void GC3DView::buildLayer(int layer)
+{
+	// Requested by GL view only for visible layers.
+	requestLayer(layer, GCJob::Visible);
+}
+
+void GC3DView::requestLayer(int layer, GCJob::Priority priority)
+{
+	if (!model() || layer < 0 || static_cast<size_t>(layer) >= m_layerRanges.size() || !m_layerRanges[layer].indexed) {
+		return;
+	}
+
+	if (m_meshJobs.contains(layer)) {
+		const QSharedPointer<GCMeshJob> &job = m_meshJobs[layer];
+
+		if (job->priority() <= priority || job->isStarted()) {
+			return;
 		}
 
-		m_itemRanges.insert(index, QPair<size_t, size_t>(startIndex, m_indices.size()));
-		return true;
+		// Prefetched layer became visible, it mustn't wait behind other prefetches.
+		job->cancel();
+		job->wait();
 	}
 
-	return false;
+	const GCTreeItem *layerItem = static_cast<const GCTreeItem *>(model()->index(layer, 0).internalPointer());
+	QSharedPointer<GCMeshJob> job(new GCMeshJob(m_mesher, layerItem, m_layerRanges[layer].firstSegment));
+
+	connect(job.data(), SIGNAL(finished()), this, SLOT(meshJobFinished()), Qt::QueuedConnection);
+	m_meshJobs.insert(layer, job);
+	GCJobScheduler::globalInstance()->submit(job, priority);
 }
 
-QPair<size_t, size_t> GC3DView::getHgltRange(const QModelIndex &index) const
+void GC3DView::prefetchLayers(size_t firstLayer)
 {
-	if (index.isValid() && m_itemRanges.contains(index)) {
-		return m_itemRanges[index];
-	} else {
-		return QPair<size_t, size_t>(0, 0);
+	size_t endLayer = qMin(firstLayer + prefetchLayerCount, m_layerRanges.size());
+
+	for (size_t layer = firstLayer; layer < endLayer; ++layer) {
+		if (!m_GCGLView->isLayerCached(layer)) {
+			requestLayer(static_cast<int>(layer), GCJob::Prefetch);
+		}
 	}
 }
 
-void GC3DView::loadGCData()
+void GC3DView::meshJobFinished()
 {
-	if (!model()) {
-		return;
+	// Jobs finish in any order, all finished are collected.
+	QMap<int, QSharedPointer<GCMeshJob> >::iterator it = m_meshJobs.begin();
+
+	while (it != m_meshJobs.end()) {
+		QSharedPointer<GCMeshJob> job = it.value();
+
+		if (!job->isFinished()) {
+			++it;
+			continue;
+		}
+
+		if (!job->isCanceled()) {
+			m_GCGLView->bufferLayer(static_cast<size_t>(it.key()), job->mesh);
+		}
+
+		it = m_meshJobs.erase(it);
 	}
+}
 
-	m_vertices = std::vector<GCGLView::Vertex>();
-	m_indices = std::vector<GLuint>();
+void GC3DView::cancelMeshJob(int layer)
+{
+	QSharedPointer<GCMeshJob> job = m_meshJobs.take(layer);
+
+	if (job) {
+		job->cancel();
+		job->wait();
+	}
+}
 
-	int numItems = model()->rowCount();
+void GC3DView::cancelMeshJobs()
+{
+	QMap<int, QSharedPointer<GCMeshJob> >::iterator it;
 
-	QModelIndex previous;
+	for (it = m_meshJobs.begin(); it != m_meshJobs.end(); ++it) {
+		it.value()->cancel();
+	}
 
-	for (int item = 0; item < numItems; ++item) {
-		addItem(model()->index(item, 0), previous);
+	// Jobs read the tree, it must not change under them.
+	for (it = m_meshJobs.begin(); it != m_meshJobs.end(); ++it) {
+		it.value()->wait();
 	}
 
+	m_meshJobs.clear();
+}
+
+void GC3DView::modelAboutToBeReset()
+{
+	cancelMeshJobs();
 }
 
 void GC3DView::currentChanged(const QModelIndex &current, const QModelIndex &previous)
 {
 	Q_UNUSED(previous)
 
+	if (m_dirty) {
+		// Selection is restored when model is indexed.
+		return;
+	}
+
 	QModelIndex cmdIndex = GCModel::getCommandIndex(current);
 	QModelIndex pathIndex = GCModel::type(current) == GCTreeItem::GC_PATH ? current : cmdIndex.parent();
 
-	QPair<size_t, size_t> hgltLayerRange = getHgltRange(GCModel::getLayerIndex(current));
-	QPair<size_t, size_t> hgltPathRange = getHgltRange(pathIndex);
-	QPair<size_t, size_t> hgltCmdRange = getHgltRange(cmdIndex);
+	ItemRange hgltLayerRange = getHgltRange(GCModel::getLayerIndex(current));
+	ItemRange hgltPathRange = getHgltRange(pathIndex);
+	ItemRange hgltCmdRange = getHgltRange(cmdIndex);
 
-	std::vector<QPair<size_t, QColor> > colorRanges;
-	colorRanges.push_back(QPair<size_t, QColor>(hgltLayerRange.first, objectColor));
-	colorRanges.push_back(QPair<size_t, QColor>(hgltPathRange.first, layerColor));
-	colorRanges.push_back(QPair<size_t, QColor>(hgltCmdRange.first, pathColor));
-	colorRanges.push_back(QPair<size_t, QColor>(hgltCmdRange.second, commandColor));
-	colorRanges.push_back(QPair<size_t, QColor>(hgltPathRange.second, pathColor));
-	colorRanges.push_back(QPair<size_t, QColor>(hgltLayerRange.second, layerColor));
-	colorRanges.push_back(QPair<size_t, QColor>(m_indices.size(), objectColor));
+	// Without selected layer nothing is hidden.
+	size_t upperLayersStart = m_layerRanges.size();
 
-	m_GCGLView->changeColorRanges(colorRanges);
+	int layer = GCModel::getLayerIndex(current).row();
+	if (layer >= 0 && static_cast<size_t>(layer) < m_layerRanges.size()) {
+		upperLayersStart = static_cast<size_t>(layer) + 1;
+	}
+
+	m_GCGLView->changeHighlight(hgltLayerRange.segments(), hgltPathRange.segments(),
+								hgltCmdRange.segments(), upperLayersStart);
+
+	prefetchLayers(upperLayersStart);
+}
+
+void GC3DView::setPrintProgress(const QModelIndex &command)
+{
+	if (m_dirty || !command.isValid()) {
+		m_GCGLView->setPrintProgress(GCGLView::travelSegment);
+		return;
+	}
+
+	// Travels and other commands have no segments, last extrusion before them is printed.
+	for (int row = command.row(); row >= 0; --row) {
+		QModelIndex sibling = command.sibling(row, 0);
+
+		if (m_itemRanges.contains(sibling)) {
+			m_GCGLView->setPrintProgress(m_itemRanges[sibling].endSegment);
+			return;
+		}
+	}
+
+	m_GCGLView->setPrintProgress(getHgltRange(command.parent()).firstSegment);
 }
 
 void GC3DView::reset()
 {
 	QAbstractItemView::reset();
-	m_itemRanges = QMap<QModelIndex, QPair<size_t, size_t> >();
+	m_itemRanges = QMap<QModelIndex, ItemRange>();
+
+	// Indices of old model are invalid, drop them before anything reads them. Its pins went with it.
+	m_layerRanges = std::vector<LayerRange>();
+	m_indexedLayers = QPair<int, int>();
+	m_dirty = true;
+
+	// Hidden view is indexed when first shown, so loading isn't slowed down by it.
+	if (isVisible()) {
+		refresh();
+	} else if (m_prewarm) {
+		prewarmLayers();
+	}
+}
+
+void GC3DView::prewarmLayers()
+{
+	if (!model()) {
+		return;
+	}
+
+	// Layers shown first are parsed by background jobs, indexing them once shown needn't wait for it.
+	int numLayers = model()->layersWithinBudget(0);
+
+	for (int layer = 0; layer < numLayers; ++layer) {
+		model()->prefetchLayer(layer, GCJob::Background);
+	}
+}
+
+void GC3DView::showEvent(QShowEvent *event)
+{
+	GCAbstractView::showEvent(event);
+
+	refresh();
+}
+
+void GC3DView::refresh()
+{
+	if (!m_dirty) {
+		return;
+	}
+
+	m_dirty = false;
+
+	// Segment IDs cover whole file, only visible layers are indexed.
+	int numLayers = model() ? model()->rowCount() : 0;
+	GLuint segment = 0;
+
+	m_layerRanges = std::vector<LayerRange>(numLayers);
+
+	for (int layer = 0; layer < numLayers; ++layer) {
+		m_layerRanges[layer].firstSegment = segment;
+		segment += model()->layerStats(layer).numExtrusions;
+		m_layerRanges[layer].endSegment = segment;
+	}
+
+	uploadLines(true);
+
+	m_GCGLView->changeHighlight(QPair<GLuint, GLuint>(), QPair<GLuint, GLuint>(),
+								QPair<GLuint, GLuint>(), m_layerRanges.size());
+
+	resetLayerSliders();
+	updateVisibleLayers();
+
+	// Selection may have changed while hidden.
+	if (selectionModel()) {
+		currentChanged(selectionModel()->currentIndex(), QModelIndex());
+	}
+}
+
+void GC3DView::resetLayerSliders()
+{
+	int lastLayer = static_cast<int>(m_layerRanges.size()) - 1;
+	// Layers shown first are limited so their trees fit in memory.
+	int lastShown = model() ? model()->layersWithinBudget(0) - 1 : lastLayer;
+
+	m_firstLayerSlider->blockSignals(true);
+	m_lastLayerSlider->blockSignals(true);
+
+	m_firstLayerSlider->setRange(0, qMax(lastLayer, 0));
+	m_lastLayerSlider->setRange(0, qMax(lastLayer, 0));
+	m_firstLayerSlider->setValue(0);
+	m_lastLayerSlider->setValue(lastShown);
+
+	m_firstLayerSlider->blockSignals(false);
+	m_lastLayerSlider->blockSignals(false);
+
+	m_firstLayerSlider->setEnabled(lastLayer > 0);
+	m_lastLayerSlider->setEnabled(lastLayer > 0);
+}
+
+void GC3DView::firstLayerChanged(int layer)
+{
+	if (layer > m_lastLayerSlider->value()) {
+		// Drags last layer along, it updates visible layers itself.
+		m_lastLayerSlider->setValue(layer);
+		return;
+	}
+
+	updateVisibleLayers();
+}
+
+void GC3DView::lastLayerChanged(int layer)
+{
+	if (layer < m_firstLayerSlider->value()) {
+		m_firstLayerSlider->setValue(layer);
+		return;
+	}
+
+	updateVisibleLayers();
+}
+
+void GC3DView::showLayers(int firstLayer, int lastLayer)
+{
+	// Sliders would index intermediate ranges one at a time.
+	m_firstLayerSlider->blockSignals(true);
+	m_lastLayerSlider->blockSignals(true);
 
-	loadGCData();
-	m_GCGLView->bufferGCData(m_vertices, m_indices);
+	m_firstLayerSlider->setValue(firstLayer);
+	m_lastLayerSlider->setValue(lastLayer);
 
-	std::vector<QPair<size_t, QColor> > colorRanges;
-	colorRanges.push_back(QPair<size_t, QColor>(m_indices.size(), objectColor));
-	m_GCGLView->changeColorRanges(colorRanges);
+	m_firstLayerSlider->blockSignals(false);
+	m_lastLayerSlider->blockSignals(false);
+
+	updateVisibleLayers();
+}
+
+void GC3DView::updateVisibleLayers()
+{
+	size_t firstLayer = static_cast<size_t>(m_firstLayerSlider->value());
+	size_t lastLayer = static_cast<size_t>(m_lastLayerSlider->value());
+
+	if (lastLayer >= m_layerRanges.size() || firstLayer > lastLayer) {
+		return;
+	}
+
+	indexLayers(static_cast<int>(firstLayer), static_cast<int>(lastLayer + 1));
+
+	// Lines of layers are contiguous, range of layers is single line draw range.
+	QPair<GLfloat, GLfloat> zRange(FLT_MAX, -FLT_MAX);
+
+	for (size_t layer = firstLayer; layer <= lastLayer; ++layer) {
+		zRange.first = qMin(zRange.first, m_layerRanges[layer].zRange.first);
+		zRange.second = qMax(zRange.second, m_layerRanges[layer].zRange.second);
+	}
+
+	// Clip planes are padded so rounding never cuts visible threads.
+	const GLfloat clipPadding = 0.001f;
+
+	m_GCGLView->setVisibleRange(firstLayer, lastLayer + 1, zRange.first - clipPadding, zRange.second + clipPadding);
+}
+
+void GC3DView::setColorBy(int colorBy)
+{
+	if (m_colorBy == colorBy) {
+		return;
+	}
+
+	m_colorBy = static_cast<ColorBy>(colorBy);
+	updateSegmentScalars();
+}
+
+void GC3DView::updateColors()
+{
+	updateSegmentScalars();
+}
+
+void GC3DView::selectSegment(int segment)
+{
+	QModelIndex index = segmentIndex(segment);
+
+	if (!selectionModel() || !index.isValid()) {
+		return;
+	}
+
+	selectionModel()->setCurrentIndex(index, QItemSelectionModel::ClearAndSelect);
 }
 
 void GC3DView::hideUpperLayers(int hide)
@@ -431,6 +929,26 @@ void GC3DView::hideUpperLayers(int hide)
 	m_GCGLView->hideUpperLayers(hide);
 }
 
+void GC3DView::showTravelMoves(int show)
+{
+	m_GCGLView->showTravelMoves(show);
+}
+
+void GC3DView::setOverview(int overview)
+{
+	m_GCGLView->setOverview(overview);
+}
+
+void GC3DView::showStatistics(int show)
+{
+	m_GCGLView->showStatistics(show);
+}
+
+void GC3DView::setSceneMemoryUsage(qint64 bytes)
+{
+	m_GCGLView->setMemoryCounter(tr("2D scene"), bytes);
+}
+
 void GC3DView::resetView()
 {
 	m_GCGLView->resetView();
@@ -3,12 +3,20 @@
 
 #include "GCAbstractView.h"
 #include "GCGLView.h"
+#include "GCJob.h"
+#include "GCLayerMesher.h"
 
 #include <QMap>
 #include <QPair>
+#include <QSharedPointer>
 #include <vector>
+#include <cfloat>
 
 class QVariant;
+class QSlider;
+class GCMeshJob;
+class GCOverhangAnalyzer;
+class GCDiffer;
 
 class GC3DView : public GCAbstractView
 {
@@ -16,39 +24,127 @@ class GC3DView : public GCAbstractView
 	Q_DISABLE_COPY(GC3DView)
 
 public:
+	enum ColorBy {BySelection, ByWidth, ByHeight, ByTime, ByOverhang, ByDifference};
+
 	explicit GC3DView(QWidget *parent = 0);
+	virtual ~GC3DView();
 
 	virtual void setGridDimensions(const QRectF &dimensions);
 	virtual const QRectF &gridDimensions() const;
 	void setLOD(unsigned char LOD);
 	unsigned char LOD() const;
+	void setMemoryBudget(size_t bytes);
+	size_t memoryBudget() const;
+	void setPrewarm(bool prewarm);
+	bool prewarm() const;
+	// Extrusions are colored by their scores when colored by overhang.
+	void setOverhangAnalyzer(GCOverhangAnalyzer *overhangAnalyzer);
+	// Added extrusions are highlighted when colored by difference.
+	void setDiffer(GCDiffer *differ);
+
+	virtual QModelIndex indexAt(const QPoint &point) const;
+
+	// Whole model is pinned, indexed and meshed first, view needn't be shown.
+	QImage renderImage(const QSize &size, GCGLView::ViewDirection direction);
 
 public slots:
 	void currentChanged(const QModelIndex &current, const QModelIndex &previous);
 	void reset();
 	void hideUpperLayers(int hide);
+	void showTravelMoves(int show);
+	void setOverview(int overview);
+	void showStatistics(int show);
+	void setSceneMemoryUsage(qint64 bytes);
+	void setColorBy(int colorBy);
+	// Values of commands changed, e.g. by GCOverhangAnalyzer or GCDiffer.
+	void updateColors();
+	void selectSegment(int segment);
+	void firstLayerChanged(int layer);
+	void lastLayerChanged(int layer);
 	void resetView();
+	// Extrusions after command are faded, invalid index shows whole model printed.
+	void setPrintProgress(const QModelIndex &command);
+
+protected:
+	virtual void showEvent(QShowEvent *event);
+
+protected slots:
+	virtual void modelAboutToBeReset();
+
+private slots:
+	void buildLayer(int layer);
+	void meshJobFinished();
 
 private:
-	void addThreadHullIndices();
-	void addThreadFaceIndices(bool start);
-	std::vector<GCGLView::Vertex> getThreadVertices(QLineF thread, double width, double height, double z);
-	void terminatePath(const GCCommand *path);
-	void addThread(const GCCommand *thread, const GCCommand *prevThread);
-	bool addItem(const QModelIndex &index, QModelIndex &previous);
-	QPair<size_t, size_t> getHgltRange(const QModelIndex &index) const;
-	void loadGCData();
+	// Segment IDs generated for a tree item.
+	struct ItemRange {
+		ItemRange()
+			: firstSegment(0), endSegment(0) {}
+		ItemRange(GLuint firstSegment, GLuint endSegment)
+			: firstSegment(firstSegment), endSegment(endSegment) {}
+
+		QPair<GLuint, GLuint> segments() const {
+			return QPair<GLuint, GLuint>(firstSegment, endSegment);
+		}
+
+		GLuint firstSegment;
+		GLuint endSegment;
+	};
+
+	// Segment IDs of every layer are reserved from its stats, layer needn't be loaded.
+	struct LayerRange {
+		LayerRange()
+			: firstSegment(0), endSegment(0), indexed(false), segmentIndices(), lines(), zRange(FLT_MAX, -FLT_MAX) {}
+
+		GLuint firstSegment;
+		GLuint endSegment;
+		bool indexed;						// Layer stays pinned in model while it is.
+		std::vector<QModelIndex> segmentIndices;	// Command drawn as n-th segment of layer, empty while not indexed.
+		std::vector<GCGLView::LineVertex> lines;	// Both endpoints of every move, travels included.
+		QPair<GLfloat, GLfloat> zRange;		// Lowest and highest point of layer threads.
+	};
+
+	void addLine(const GCCommand *move, GLuint segment, LayerRange &layerRange);
+	bool indexItem(const QModelIndex &index, LayerRange &layerRange, GLuint &segment);
+	void unindexItem(const QModelIndex &index);
+	// Layers of range are pinned and indexed, layers out of it are released.
+	void indexLayers(int firstLayer, int endLayer);
+	void indexLayer(int layer);
+	void unindexLayer(int layer);
+	void requestLayer(int layer, GCJob::Priority priority);
+	void prefetchLayers(size_t firstLayer);
+	void cancelMeshJob(int layer);
+	void cancelMeshJobs();
+
+	ItemRange getHgltRange(const QModelIndex &index) const;
+	// Command drawn as segment, invalid when its layer isn't indexed.
+	QModelIndex segmentIndex(int segment) const;
+	void resetLayerSliders();
+	void showLayers(int firstLayer, int lastLayer);
+	void updateVisibleLayers();
+	void updateSegmentScalars();
+	void uploadLines(bool resetMeshes);
+	void rebuild();
+	void refresh();
+	void prewarmLayers();
 
 	GCGLView *m_GCGLView;
+	GCLayerMesher m_mesher;
+	QMap<int, QSharedPointer<GCMeshJob> > m_meshJobs;	// Layers being meshed on worker threads.
+
+	QMap<QModelIndex, ItemRange> m_itemRanges;
+	std::vector<LayerRange> m_layerRanges;
+	QPair<int, int> m_indexedLayers;			// First and end layer.
 
-	std::vector<GCGLView::Vertex> m_vertices;
-	std::vector<GLuint> m_indices;
+	QSlider *m_firstLayerSlider;
+	QSlider *m_lastLayerSlider;
 
-	QMap<QModelIndex, QPair<size_t, size_t> > m_itemRanges;
+	ColorBy m_colorBy;
+	GCOverhangAnalyzer *m_overhangAnalyzer;
+	GCDiffer *m_differ;
+	bool m_dirty;						// Model was reset and is not indexed yet.
+	bool m_prewarm;						// Layers shown first are parsed after reset even when hidden.
 
-	GLuint m_halfFacePoints;
-	std::vector<double> m_sinTable;
-	std::vector<double> m_cosTable;
 };
 
 #endif // GC3DVIEW_H
@@ -2,6 +2,8 @@
 
 #include <QLabel>
 #include <QSlider>
+#include <QSpinBox>
+#include <QCheckBox>
 #include <QPushButton>
 #include <QHBoxLayout>
 #include <QVBoxLayout>
@@ -11,23 +13,35 @@
 GC3DViewSettingsDia::GC3DViewSettingsDia(QWidget *parent, Qt::WindowFlags f)
 	: QDialog(parent, f),
 	  m_savedLOD(0),
+	  m_savedMemoryBudget(0),
+	  m_savedPrewarm(false),
 	  m_LODSlider(0),
+	  m_memoryBudgetSpinBox(0),
+	  m_prewarmChkB(0),
 	  m_saveBtn(0)
 {
 	init();
 
 	m_LODSlider->setValue(m_savedLOD);
+	m_memoryBudgetSpinBox->setValue(m_savedMemoryBudget);
+	m_prewarmChkB->setChecked(m_savedPrewarm);
 }
 
-GC3DViewSettingsDia::GC3DViewSettingsDia(unsigned char LOD, QWidget *parent, Qt::WindowFlags f)
+GC3DViewSettingsDia::GC3DViewSettingsDia(unsigned char LOD, int memoryBudget, bool prewarm, QWidget *parent, Qt::WindowFlags f)
 	: QDialog(parent, f),
 	  m_savedLOD(0),
+	  m_savedMemoryBudget(0),
+	  m_savedPrewarm(false),
 	  m_LODSlider(0),
+	  m_memoryBudgetSpinBox(0),
+	  m_prewarmChkB(0),
 	  m_saveBtn(0)
 {
 	init();
 
 	m_LODSlider->setValue(LOD);
+	m_memoryBudgetSpinBox->setValue(memoryBudget);
+	m_prewarmChkB->setChecked(prewarm);
 }
 
 void GC3DViewSettingsDia::init()
@@ -41,6 +55,17 @@ void GC3DViewSettingsDia::init()
 	LODLayout->addWidget(LODLabel);
 	LODLayout->addWidget(m_LODSlider);
 
+	QHBoxLayout *memoryBudgetLayout = new QHBoxLayout();
+	QLabel *memoryBudgetLabel = new QLabel(tr("GPU memory budget:"));
+	m_memoryBudgetSpinBox = new QSpinBox();
+	m_memoryBudgetSpinBox->setRange(16, 65536);
+	m_memoryBudgetSpinBox->setSingleStep(64);
+	m_memoryBudgetSpinBox->setSuffix(tr(" MiB"));
+	memoryBudgetLayout->addWidget(memoryBudgetLabel);
+	memoryBudgetLayout->addWidget(m_memoryBudgetSpinBox);
+
+	m_prewarmChkB = new QCheckBox(tr("Prepare 3D view right after loading"));
+
 	QHBoxLayout *btnLayout = new QHBoxLayout();
 	QPushButton *okBtn = new QPushButton("Ok");
 	m_saveBtn = new QPushButton("Save", this);
@@ -57,6 +82,8 @@ void GC3DViewSettingsDia::init()
 
 	QVBoxLayout *dialogLayout = new QVBoxLayout(this);
 	dialogLayout->addLayout(LODLayout);
+	dialogLayout->addLayout(memoryBudgetLayout);
+	dialogLayout->addWidget(m_prewarmChkB);
 	dialogLayout->addSpacerItem(new QSpacerItem(40, 20, QSizePolicy::Minimum, QSizePolicy::Expanding));
 	dialogLayout->addLayout(btnLayout);
 
@@ -67,6 +94,8 @@ void GC3DViewSettingsDia::init()
 	connect(cancelBtn, SIGNAL(clicked()), this, SLOT(on_cancelBtn_clicked()));
 
 	connect(m_LODSlider, SIGNAL(valueChanged(int)), this, SLOT(on_qslider_valueChanged(int)));
+	connect(m_memoryBudgetSpinBox, SIGNAL(valueChanged(int)), this, SLOT(on_memoryBudgetSpinBox_valueChanged(int)));
+	connect(m_prewarmChkB, SIGNAL(stateChanged(int)), this, SLOT(on_prewarmChkB_stateChanged(int)));
 
 	readSettings();
 }
@@ -76,6 +105,16 @@ unsigned char GC3DViewSettingsDia::LOD() const
 	return static_cast<unsigned char>(m_LODSlider->value());
 }
 
+int GC3DViewSettingsDia::memoryBudget() const
+{
+	return m_memoryBudgetSpinBox->value();
+}
+
+bool GC3DViewSettingsDia::prewarm() const
+{
+	return m_prewarmChkB->isChecked();
+}
+
 void GC3DViewSettingsDia::on_okBtn_clicked()
 {
 	accept();
@@ -92,9 +131,25 @@ void GC3DViewSettingsDia::on_cancelBtn_clicked()
 	reject();
 }
 
-void GC3DViewSettingsDia::on_qslider_valueChanged(int value)
+void GC3DViewSettingsDia::on_qslider_valueChanged(int)
+{
+	updateSaveBtn();
+}
+
+void GC3DViewSettingsDia::on_memoryBudgetSpinBox_valueChanged(int)
+{
+	updateSaveBtn();
+}
+
+void GC3DViewSettingsDia::on_prewarmChkB_stateChanged(int)
+{
+	updateSaveBtn();
+}
+
+void GC3DViewSettingsDia::updateSaveBtn()
 {
-	m_saveBtn->setEnabled(value != m_savedLOD);
+	m_saveBtn->setEnabled(m_LODSlider->value() != m_savedLOD || m_memoryBudgetSpinBox->value() != m_savedMemoryBudget
+						  || m_prewarmChkB->isChecked() != m_savedPrewarm);
 }
 
 void GC3DViewSettingsDia::readSettings()
@@ -103,17 +158,25 @@ void GC3DViewSettingsDia::readSettings()
 
 	settings.beginGroup("3d_view_settings");
 	m_savedLOD = static_cast<unsigned char>(settings.value("LOD", 3).toUInt());
+	m_savedMemoryBudget = settings.value("memory_budget", 512).toInt();
+	m_savedPrewarm = settings.value("prewarm", false).toBool();
 	settings.endGroup();
 }
 
 void GC3DViewSettingsDia::saveSettings() const
 {
 	unsigned char LOD = static_cast<unsigned char>(m_LODSlider->value());
+	int memoryBudget = m_memoryBudgetSpinBox->value();
+	bool prewarm = m_prewarmChkB->isChecked();
 
 	QSettings settings;
 	settings.beginGroup("3d_view_settings");
 	settings.setValue("LOD", LOD);
+	settings.setValue("memory_budget", memoryBudget);
+	settings.setValue("prewarm", prewarm);
 	settings.endGroup();
 
 	m_savedLOD = LOD;
+	m_savedMemoryBudget = memoryBudget;
+	m_savedPrewarm = prewarm;
 }
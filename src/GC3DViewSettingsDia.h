@@ -4,6 +4,8 @@
 #include <QDialog>
 
 class QSlider;
+class QSpinBox;
+class QCheckBox;
 class QPushButton;
 
 class GC3DViewSettingsDia : public QDialog
@@ -13,24 +15,33 @@ class GC3DViewSettingsDia : public QDialog
 
 public:
 	explicit GC3DViewSettingsDia(QWidget *parent = 0, Qt::WindowFlags f = 0);
-	GC3DViewSettingsDia(unsigned char LOD, QWidget *parent = 0, Qt::WindowFlags f = 0);
+	GC3DViewSettingsDia(unsigned char LOD, int memoryBudget, bool prewarm, QWidget *parent = 0, Qt::WindowFlags f = 0);
 
 	unsigned char LOD() const;
+	int memoryBudget() const;			// MiB of GPU memory for layer meshes.
+	bool prewarm() const;
 
 public slots:
 	void on_okBtn_clicked();
 	void on_saveBtn_clicked();
 	void on_cancelBtn_clicked();
 	void on_qslider_valueChanged(int);
+	void on_memoryBudgetSpinBox_valueChanged(int);
+	void on_prewarmChkB_stateChanged(int);
 
 private:
 	void init();
 	void readSettings();
 	void saveSettings() const;
+	void updateSaveBtn();
 
 	mutable unsigned char m_savedLOD;
+	mutable int m_savedMemoryBudget;
+	mutable bool m_savedPrewarm;
 
 	QSlider *m_LODSlider;
+	QSpinBox *m_memoryBudgetSpinBox;
+	QCheckBox *m_prewarmChkB;
 	QPushButton *m_saveBtn;
 };
 
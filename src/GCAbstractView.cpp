@@ -16,7 +16,17 @@ GCAbstractView::GCAbstractView(QWidget *parent)
 
 void GCAbstractView::setModel(GCModel *model)
 {
+	if (this->model()) {
+		// Work on data of old model must stop before it goes away.
+		modelAboutToBeReset();
+		disconnect(this->model(), SIGNAL(modelAboutToBeReset()), this, SLOT(modelAboutToBeReset()));
+	}
+
 	QAbstractItemView::setModel(model);
+
+	if (model) {
+		connect(model, SIGNAL(modelAboutToBeReset()), this, SLOT(modelAboutToBeReset()));
+	}
 }
 
 
@@ -50,6 +60,10 @@ void GCAbstractView::currentChanged(const QModelIndex &current, const QModelInde
 	QAbstractItemView::currentChanged(current, previous);
 }
 
+void GCAbstractView::modelAboutToBeReset()
+{
+}
+
 QRegion GCAbstractView::visualRegionForSelection(const QItemSelection &selection) const
 {
 	Q_UNUSED(selection)
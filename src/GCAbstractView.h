@@ -27,6 +27,10 @@ public:
 public slots:
 	void currentChanged(const QModelIndex &current, const QModelIndex &previous);
 
+protected slots:
+	// Model data is still valid here, unlike in reset().
+	virtual void modelAboutToBeReset();
+
 protected:
 	virtual QRegion visualRegionForSelection(const QItemSelection &selection) const;
 	virtual void setSelection(const QRect &rect, QItemSelectionModel::SelectionFlags command);
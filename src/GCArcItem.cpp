@@ -0,0 +1,55 @@
+#include "GCArcItem.h"
+#include "GCThreadItem.h"
+
+#include <QPainterPath>
+#include <QPen>
+#include <QStyleOptionGraphicsItem>
+
+#include <cmath>
+
+GCArcItem::GCArcItem(const GCArcCommand &data, QGraphicsItem *parent, QGraphicsScene *scene)
+	: QGraphicsPathItem(arcPath(data), parent, scene)
+{
+	setFlag(QGraphicsItem::ItemIsSelectable, true);
+	setPen(GCThreadItem::threadPen(data.threadWidth, pen().color()));
+	setBrush(Qt::NoBrush);
+}
+
+void GCArcItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+	// Disable painting of dashed rectangle around selected items.
+	QStyleOptionGraphicsItem opt = *option;
+	opt.state &= !QStyle::State_Selected;
+
+	QGraphicsPathItem::paint(painter, &opt, widget);
+}
+
+QVariant GCArcItem::itemChange(QGraphicsItem::GraphicsItemChange change, const QVariant &value)
+{
+	if (change == QGraphicsItem::ItemSelectedChange) {
+		setZValue(value.toBool() ? 1 : 0);
+	}
+
+	return QGraphicsItem::itemChange(change, value);
+}
+
+void GCArcItem::setColor(const QColor &color)
+{
+	QPen p = pen();
+	p.setColor(color);
+	setPen(p);
+
+	update();
+}
+
+QPainterPath GCArcItem::arcPath(const GCArcCommand &data)
+{
+	double r = data.arcRadius;
+	QRectF circle(data.arcCenter - QPointF(r, r), QSizeF(2 * r, 2 * r));
+
+	// Qt angles are in degrees and turn towards negative y.
+	QPainterPath path(data.thread.p1());
+	path.arcTo(circle, -data.arcStartAngle * 180 / M_PI, -data.arcSweep * 180 / M_PI);
+
+	return path;
+}
@@ -0,0 +1,22 @@
+#ifndef GCARCITEM_H
+#define GCARCITEM_H
+
+#include "GCTree/GCArcCommand.h"
+
+#include <QGraphicsPathItem>
+#include <QPainterPath>
+
+// G2/G3 move drawn as a true arc.
+class GCArcItem : public QGraphicsPathItem
+{
+public:
+	GCArcItem(const GCArcCommand &data, QGraphicsItem *parent = 0, QGraphicsScene *scene = 0);
+
+	virtual void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = 0);
+	virtual QVariant itemChange(GraphicsItemChange change, const QVariant &value);
+	void setColor(const QColor &color);
+
+	static QPainterPath arcPath(const GCArcCommand &data);
+};
+
+#endif // GCARCITEM_H
@@ -0,0 +1,222 @@
+#include "GCBatchRenderer.h"
+#include "GC3DView.h"
+#include "GCModel.h"
+#include "GCGzipDevice.h"
+#include "GCJobScheduler.h"
+#include "GCTrace.h"
+#include "FilamentSettingsDia.h"
+#include "GC3DViewSettingsDia.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QScopedPointer>
+#include <QTextStream>
+
+#include <cstdio>
+
+// Grid of rendered bed, same as in main window.
+const QRectF renderGrid(0, 0, 200, 200);
+
+QString GCBatchRenderer::parseArguments(const QStringList &arguments, Options &options)
+{
+	int renderArg = arguments.indexOf("--render");
+
+	if (renderArg < 0) {
+		return tr("Missing --render option.");
+	}
+
+	for (int i = renderArg + 1; i < arguments.size() && !arguments[i].startsWith('-'); ++i) {
+		options.inputs.append(arguments[i]);
+	}
+
+	if (options.inputs.isEmpty()) {
+		return tr("No input files after --render.");
+	}
+
+	for (int i = 1; i < arguments.size(); ++i) {
+		const QString &argument = arguments[i];
+		bool hasValue = i + 1 < arguments.size();
+
+		if (argument == "-o") {
+			if (!hasValue) {
+				return tr("Missing output after -o.");
+			}
+
+			options.output = arguments[++i];
+		} else if (argument == "--view") {
+			QString view = hasValue ? arguments[++i] : QString();
+
+			if (view == "top") {
+				options.direction = GCGLView::TopView;
+			} else if (view == "front") {
+				options.direction = GCGLView::FrontView;
+			} else if (view == "iso") {
+				options.direction = GCGLView::IsoView;
+			} else {
+				return tr("Unknown view \"%1\", expected top, front or iso.").arg(view);
+			}
+		} else if (argument == "--size") {
+			bool ok = false;
+			options.size = hasValue ? arguments[++i].toInt(&ok) : 0;
+
+			if (!ok || options.size <= 0) {
+				return tr("Invalid image size.");
+			}
+		}
+	}
+
+	return QString();
+}
+
+GCBatchRenderer::GCBatchRenderer(const Options &options, QObject *parent)
+	: QObject(parent),
+	  m_options(options),
+	  m_filamentDiameter(0),
+	  m_packingDensity(0),
+	  m_view(0),
+	  m_loading(),
+	  m_nextInput(0),
+	  m_rendered(0),
+	  m_failed(0),
+	  m_timer()
+{
+	// Same settings as interactive viewer, so images match what user sees.
+	FilamentSettingsDia filamentSettings;
+	m_filamentDiameter = filamentSettings.filamentDiameter();
+	m_packingDensity = filamentSettings.packingDensity();
+
+	GC3DViewSettingsDia gc3DViewSettings;
+	m_view = new GC3DView();
+	m_view->setLOD(gc3DViewSettings.LOD());
+	m_view->setMemoryBudget(static_cast<size_t>(gc3DViewSettings.memoryBudget()) * 1024 * 1024);
+	m_view->setGridDimensions(renderGrid);
+}
+
+GCBatchRenderer::~GCBatchRenderer()
+{
+	delete m_view;
+	qDeleteAll(m_loading.keys());
+}
+
+void GCBatchRenderer::start()
+{
+	m_timer.start();
+
+	// With several inputs output is a directory, it may not exist yet.
+	if (m_options.inputs.size() > 1 && !m_options.output.isEmpty() && !QDir().mkpath(m_options.output)) {
+		m_failed = m_options.inputs.size();
+		QTextStream(stderr) << tr("Unable to create directory %1.").arg(m_options.output) << endl;
+		finish();
+		return;
+	}
+
+	// Files are scanned in parallel, one per worker keeps every worker busy while the view renders.
+	int numLoads = qMax(1, GCJobScheduler::globalInstance()->numWorkers());
+
+	for (int i = 0; i < numLoads; ++i) {
+		loadNext();
+	}
+
+	if (m_loading.isEmpty()) {
+		finish();
+	}
+}
+
+int GCBatchRenderer::exitCode() const
+{
+	return m_failed ? 1 : 0;
+}
+
+void GCBatchRenderer::modelLoaded()
+{
+	GCModel *model = static_cast<GCModel *>(sender());
+
+	if (!m_loading.contains(model)) {
+		return;
+	}
+
+	QString input = m_loading.take(model);
+	QString output = outputPath(input);
+
+	if (!model->loadError().isEmpty()) {
+		++m_failed;
+		QTextStream(stderr) << tr("Unable to read %1: %2").arg(input, model->loadError()) << endl;
+	} else {
+		GC_TRACE_SCOPE("render file");
+
+		m_view->setModel(model);
+		QImage image = m_view->renderImage(QSize(m_options.size, m_options.size), m_options.direction);
+		m_view->setModel(0);
+
+		if (!image.isNull() && image.save(output)) {
+			++m_rendered;
+			QTextStream(stdout) << input << " -> " << output << endl;
+		} else {
+			++m_failed;
+			QTextStream(stderr) << tr("Unable to render %1 to %2.").arg(input, output) << endl;
+		}
+	}
+
+	// Model is still emitting the signal.
+	model->deleteLater();
+
+	loadNext();
+
+	if (m_loading.isEmpty()) {
+		finish();
+	}
+}
+
+QString GCBatchRenderer::outputPath(const QString &input) const
+{
+	if (m_options.inputs.size() == 1 && !m_options.output.isEmpty()) {
+		return m_options.output;
+	}
+
+	QFileInfo inputInfo(input);
+	QString baseName = inputInfo.completeBaseName();
+
+	// Compressed files keep .gcode in base name.
+	if (inputInfo.suffix().compare("gz", Qt::CaseInsensitive) == 0 && baseName.endsWith(".gcode", Qt::CaseInsensitive)) {
+		baseName.chop(6);
+	}
+
+	QDir dir = m_options.output.isEmpty() ? inputInfo.absoluteDir() : QDir(m_options.output);
+
+	return dir.filePath(baseName + ".png");
+}
+
+void GCBatchRenderer::loadNext()
+{
+	while (m_nextInput < m_options.inputs.size()) {
+		QString input = m_options.inputs[m_nextInput++];
+
+		QScopedPointer<QIODevice> gcFile(GCGzipDevice::openGCode(input));
+
+		if (!gcFile) {
+			++m_failed;
+			QTextStream(stderr) << tr("Unable to open G-code file %1.").arg(input) << endl;
+			continue;
+		}
+
+		GCModel *model = new GCModel();
+		connect(model, SIGNAL(layersNumChanged(int)), this, SLOT(modelLoaded()));
+		m_loading.insert(model, input);
+		model->loadGCode(gcFile.take(), m_filamentDiameter, m_packingDensity);
+
+		return;
+	}
+}
+
+void GCBatchRenderer::finish()
+{
+	double seconds = m_timer.elapsed() / 1000.0;
+	int numFiles = m_options.inputs.size();
+
+	QTextStream(stdout) << tr("Rendered %1 of %2 files in %3 s (%4 files/s)")
+						   .arg(m_rendered).arg(numFiles).arg(seconds, 0, 'f', 2)
+						   .arg(seconds > 0 ? m_rendered / seconds : 0, 0, 'f', 2) << endl;
+
+	emit finished();
+}
@@ -0,0 +1,64 @@
+#ifndef GCBATCHRENDERER_H
+#define GCBATCHRENDERER_H
+
+#include "GCGLView.h"
+
+#include <QObject>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QMap>
+
+class GCModel;
+class GC3DView;
+
+// Renders snapshots of G-code files without main window, started with --render on command line.
+// Files are loaded several at a time on job scheduler, rendering is done one by one by single hidden 3D view.
+class GCBatchRenderer : public QObject
+{
+	Q_OBJECT
+	Q_DISABLE_COPY(GCBatchRenderer)
+
+public:
+	struct Options {
+		Options()
+			: inputs(), output(), direction(GCGLView::IsoView), size(512) {}
+
+		QStringList inputs;
+		QString output;					// Image file for single input, directory otherwise.
+		GCGLView::ViewDirection direction;
+		int size;						// Pixels, images are square.
+	};
+
+	// Returns error message, empty when arguments are valid.
+	static QString parseArguments(const QStringList &arguments, Options &options);
+
+	explicit GCBatchRenderer(const Options &options, QObject *parent = 0);
+	virtual ~GCBatchRenderer();
+
+	void start();
+	int exitCode() const;
+
+signals:
+	void finished();
+
+private slots:
+	void modelLoaded();
+
+private:
+	QString outputPath(const QString &input) const;
+	void loadNext();
+	void finish();
+
+	Options m_options;
+	double m_filamentDiameter;
+	double m_packingDensity;
+
+	GC3DView *m_view;
+	QMap<GCModel *, QString> m_loading;	// Input file of every model being loaded.
+	int m_nextInput;
+	int m_rendered;
+	int m_failed;
+	QElapsedTimer m_timer;
+};
+
+#endif // GCBATCHRENDERER_H
@@ -0,0 +1,11 @@
+#ifndef GCCOLORS_H
+#define GCCOLORS_H
+
+#include <QColor>
+
+// Colors shared by 2D and 3D views and exported layer images.
+const QColor layerColor(0, 127, 0);
+const QColor pathColor(127, 127, 0);
+const QColor commandColor(0, 0, 127);
+
+#endif // GCCOLORS_H
@@ -0,0 +1,288 @@
+#include "GCDiffer.h"
+
+#include "GCModel.h"
+#include "GCJobGroup.h"
+#include "GCTreeWalker.h"
+#include "GCTrace.h"
+#include "GCTree/GCCommand.h"
+#include "GCTree/GCLayer.h"
+
+#include <algorithm>
+#include <utility>
+
+// Hash and number of extrusion within layer.
+typedef std::pair<quint64, int> HashedExtrusion;
+
+// Null for layer missing in one of the files.
+static GCTreeItem *layerItem(GCModel *model, int layer)
+{
+	return layer >= 0 ? static_cast<GCTreeItem *>(model->index(layer, 0).internalPointer()) : 0;
+}
+
+// Heights of aligned layers are compared to a micrometre, like ends of extrusions.
+static qint64 layerHeight(GCModel *model, int layer)
+{
+	return qRound64(static_cast<GCLayer *>(layerItem(model, layer))->z() * 1000.0);
+}
+
+// Extrusions as counted by GCLayerStats::addMove(), with their hashes.
+static void collectExtrusions(GCTreeItem *item, std::vector<HashedExtrusion> &extrusions)
+{
+	std::vector<GCCommand *> commands;
+	GCTreeWalker::collectExtrusions(item, commands);
+
+	for (size_t i = 0; i < commands.size(); ++i) {
+		extrusions.push_back(HashedExtrusion(GCLayerStats::extrusionHash(commands[i]), static_cast<int>(i)));
+	}
+}
+
+// Pairs equal extrusions of both layers, the rest is added to the model or removed from reference.
+// Changes are kept in the job, both layers are read by the job itself and released when it ends.
+class GCDiffJob : public GCJob
+{
+public:
+	GCDiffJob(const GCModel *model, int layer, const GCModel *reference, int referenceLayer)
+		: GCJob(),
+		  layer(layer),
+		  referenceLayer(referenceLayer),
+		  changes(),
+		  referenceChanges(),
+		  numAdded(0),
+		  numRemoved(0),
+		  m_model(model),
+		  m_reference(reference)
+	{
+	}
+
+	int layer;
+	int referenceLayer;
+	std::vector<GCDiffer::Change> changes;				// By extrusion of layer.
+	std::vector<GCDiffer::Change> referenceChanges;		// By extrusion of reference layer.
+	int numAdded;
+	int numRemoved;
+
+protected:
+	virtual void run()
+	{
+		GC_TRACE_SCOPE("diff layer");
+
+		// Layer missing in one of the files reads as null, it has no extrusions.
+		std::vector<HashedExtrusion> extrusions;
+		std::vector<HashedExtrusion> referenceExtrusions;
+		QScopedPointer<GCLayer> copy;
+		collectExtrusions(m_model->readLayer(layer, copy), extrusions);
+
+		// Only hashes are compared, layer is released before the reference one is read.
+		copy.reset();
+		collectExtrusions(m_reference->readLayer(referenceLayer, copy), referenceExtrusions);
+		copy.reset();
+
+		if (isCanceled()) {
+			return;
+		}
+
+		changes.assign(extrusions.size(), GCDiffer::Unchanged);
+		referenceChanges.assign(referenceExtrusions.size(), GCDiffer::Unchanged);
+
+		std::sort(extrusions.begin(), extrusions.end());
+		std::sort(referenceExtrusions.begin(), referenceExtrusions.end());
+
+		size_t i = 0;
+		size_t j = 0;
+
+		while (i < extrusions.size() || j < referenceExtrusions.size()) {
+			if (j == referenceExtrusions.size()
+					|| (i < extrusions.size() && extrusions[i].first < referenceExtrusions[j].first)) {
+				changes[extrusions[i++].second] = GCDiffer::Added;
+				++numAdded;
+			} else if (i == extrusions.size() || referenceExtrusions[j].first < extrusions[i].first) {
+				referenceChanges[referenceExtrusions[j++].second] = GCDiffer::Removed;
+				++numRemoved;
+			} else {
+				++i;
+				++j;
+			}
+		}
+	}
+
+private:
+	const GCModel *m_model;
+	const GCModel *m_reference;
+};
+
+GCDiffer::GCDiffer(GCModel *model, GCModel *reference, QObject *parent)
+	: QObject(parent),
+	  m_model(model),
+	  m_reference(reference),
+	  m_comparedLayers(),
+	  m_changes(),
+	  m_referenceChanges(),
+	  m_jobs(0)
+{
+	m_jobs = new GCJobGroup(this);
+	connect(m_jobs, SIGNAL(progressChanged(int)), this, SIGNAL(progressChanged(int)));
+	connect(m_jobs, SIGNAL(finished()), this, SLOT(jobsFinished()));
+
+	// Jobs read both trees, neither may change under them.
+	connect(m_model, SIGNAL(modelAboutToBeReset()), this, SLOT(forget()));
+	connect(m_reference, SIGNAL(modelAboutToBeReset()), this, SLOT(forget()));
+}
+
+GCDiffer::~GCDiffer()
+{
+	cancel();
+}
+
+void GCDiffer::start()
+{
+	cancel();
+	clearChanges();
+
+	std::vector<LayerPair> pairs = alignLayers();
+	std::vector<LayerPair> comparedPairs;
+
+	// Equal hashes mean same extrusions, only the other layers are parsed.
+	for (size_t i = 0; i < pairs.size(); ++i) {
+		const LayerPair &pair = pairs[i];
+		const GCLayerStats &stats = m_model->layerStats(pair.layer);
+		const GCLayerStats &referenceStats = m_reference->layerStats(pair.referenceLayer);
+
+		if (stats.hash == referenceStats.hash && stats.numExtrusions == referenceStats.numExtrusions) {
+			continue;
+		}
+
+		comparedPairs.push_back(pair);
+
+		if (pair.layer >= 0) {
+			m_comparedLayers[pair.layer] = pair.referenceLayer;
+		}
+	}
+
+	// Jobs read their own layer pairs, loaded layers of both models aren't touched.
+	for (size_t i = 0; i < comparedPairs.size(); ++i) {
+		const LayerPair &pair = comparedPairs[i];
+		m_jobs->submit(QSharedPointer<GCJob>(new GCDiffJob(m_model, pair.layer, m_reference, pair.referenceLayer)));
+	}
+
+	if (!m_jobs->size()) {
+		emit finished(0, 0, 0);
+	}
+}
+
+void GCDiffer::cancel()
+{
+	m_jobs->cancel();
+}
+
+bool GCDiffer::isRunning() const
+{
+	return m_jobs->isRunning();
+}
+
+GCModel *GCDiffer::reference() const
+{
+	return m_reference;
+}
+
+int GCDiffer::comparedLayer(int layer) const
+{
+	if (layer < 0 || static_cast<size_t>(layer) >= m_comparedLayers.size()) {
+		return -1;
+	}
+
+	return m_comparedLayers[layer];
+}
+
+GCDiffer::Change GCDiffer::change(int layer, int extrusion) const
+{
+	return tableChange(m_changes, layer, extrusion);
+}
+
+GCDiffer::Change GCDiffer::referenceChange(int referenceLayer, int extrusion) const
+{
+	return tableChange(m_referenceChanges, referenceLayer, extrusion);
+}
+
+void GCDiffer::jobsFinished()
+{
+	int numChangedLayers = 0;
+	int numAdded = 0;
+	int numRemoved = 0;
+
+	// Layers with different hashes may still hold same extrusions, e.g. when hashes collide.
+	for (int i = 0; i < m_jobs->size(); ++i) {
+		GCDiffJob *job = static_cast<GCDiffJob *>(m_jobs->job(i));
+
+		if (job->layer >= 0) {
+			m_changes[job->layer].swap(job->changes);
+		}
+
+		if (job->referenceLayer >= 0) {
+			m_referenceChanges[job->referenceLayer].swap(job->referenceChanges);
+		}
+
+		numChangedLayers += (job->numAdded || job->numRemoved) ? 1 : 0;
+		numAdded += job->numAdded;
+		numRemoved += job->numRemoved;
+	}
+
+	cancel();
+	emit finished(numChangedLayers, numAdded, numRemoved);
+}
+
+void GCDiffer::forget()
+{
+	cancel();
+	m_comparedLayers.clear();
+	m_changes.clear();
+	m_referenceChanges.clear();
+}
+
+std::vector<GCDiffer::LayerPair> GCDiffer::alignLayers() const
+{
+	std::vector<LayerPair> pairs;
+	int numLayers = m_model->rowCount();
+	int numReferenceLayers = m_reference->rowCount();
+	int layer = 0;
+	int referenceLayer = 0;
+
+	// Both files go up layer by layer, heights missing in one of them are added or removed layers.
+	while (layer < numLayers || referenceLayer < numReferenceLayers) {
+		if (referenceLayer == numReferenceLayers) {
+			pairs.push_back(LayerPair(layer++, -1));
+		} else if (layer == numLayers) {
+			pairs.push_back(LayerPair(-1, referenceLayer++));
+		} else {
+			qint64 z = layerHeight(m_model, layer);
+			qint64 referenceZ = layerHeight(m_reference, referenceLayer);
+
+			if (z < referenceZ) {
+				pairs.push_back(LayerPair(layer++, -1));
+			} else if (referenceZ < z) {
+				pairs.push_back(LayerPair(-1, referenceLayer++));
+			} else {
+				pairs.push_back(LayerPair(layer++, referenceLayer++));
+			}
+		}
+	}
+
+	return pairs;
+}
+
+void GCDiffer::clearChanges()
+{
+	m_comparedLayers.assign(m_model->rowCount(), -1);
+	m_changes.assign(m_model->rowCount(), std::vector<Change>());
+	m_referenceChanges.assign(m_reference->rowCount(), std::vector<Change>());
+}
+
+GCDiffer::Change GCDiffer::tableChange(const std::vector<std::vector<Change> > &changes, int layer, int extrusion)
+{
+	if (layer < 0 || static_cast<size_t>(layer) >= changes.size()) {
+		return Unchanged;
+	}
+
+	const std::vector<Change> &layerChanges = changes[layer];
+
+	return extrusion >= 0 && static_cast<size_t>(extrusion) < layerChanges.size() ? layerChanges[extrusion] : Unchanged;
+}
@@ -0,0 +1,68 @@
+#ifndef GCDIFFER_H
+#define GCDIFFER_H
+
+#include <QObject>
+
+#include <vector>
+
+class GCModel;
+class GCJobGroup;
+
+// Compares extrusions of model with reference file, changes are kept by layer and extrusion number of either file.
+// Layers are aligned by height and compared by hashes gathered while loading, only layers whose hashes
+// differ are parsed and compared extrusion by extrusion, by jobs in parallel.
+class GCDiffer : public QObject
+{
+	Q_OBJECT
+	Q_DISABLE_COPY(GCDiffer)
+
+public:
+	enum Change {Unchanged, Added, Removed};
+
+	GCDiffer(GCModel *model, GCModel *reference, QObject *parent = 0);
+	virtual ~GCDiffer();
+
+	void start();
+	bool isRunning() const;
+	GCModel *reference() const;
+	// Layer of reference compared in detail with layer of model, -1 when the layers are same or weren't compared.
+	int comparedLayer(int layer) const;
+	// Extrusions are numbered within layer in tree order, like GCLayerStats counts them.
+	// Extrusions of model may be added, those of reference removed; Unchanged when not compared.
+	Change change(int layer, int extrusion) const;
+	Change referenceChange(int referenceLayer, int extrusion) const;
+
+public slots:
+	void cancel();
+
+signals:
+	void progressChanged(int percent);
+	void finished(int numChangedLayers, int numAdded, int numRemoved);
+
+private slots:
+	void jobsFinished();
+	// Changes belong to the files being reset.
+	void forget();
+
+private:
+	struct LayerPair {
+		LayerPair(int layer, int referenceLayer)
+			: layer(layer), referenceLayer(referenceLayer) {}
+
+		int layer;						// -1 for layers of reference only.
+		int referenceLayer;				// -1 for layers of model only.
+	};
+
+	std::vector<LayerPair> alignLayers() const;
+	void clearChanges();
+	static Change tableChange(const std::vector<std::vector<Change> > &changes, int layer, int extrusion);
+
+	GCModel *m_model;
+	GCModel *m_reference;
+	std::vector<int> m_comparedLayers;	// Index of reference layer for each model layer.
+	std::vector<std::vector<Change> > m_changes;			// By layer and extrusion of model.
+	std::vector<std::vector<Change> > m_referenceChanges;	// By layer and extrusion of reference.
+	GCJobGroup *m_jobs;
+};
+
+#endif // GCDIFFER_H
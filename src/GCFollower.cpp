@@ -0,0 +1,150 @@
+#include "GCFollower.h"
+
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QHostAddress>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif // Q_OS_UNIX
+
+// Name is resolved to a file like QLocalServer does, only a socket may be removed to take its name over.
+static bool isSocketFile(const QString &address)
+{
+#ifdef Q_OS_UNIX
+	QString path = address.startsWith(QChar('/')) ? address : QDir::tempPath() + QChar('/') + address;
+	struct stat info;
+
+	return ::lstat(QFile::encodeName(path).constData(), &info) == 0 && S_ISSOCK(info.st_mode);
+#else
+	Q_UNUSED(address);
+	return false;
+#endif // Q_OS_UNIX
+}
+
+GCFollower::GCFollower(QObject *parent)
+	: QObject(parent),
+	  m_tcpServer(0),
+	  m_localServer(0),
+	  m_client(0)
+{
+}
+
+GCFollower::~GCFollower()
+{
+	stop();
+}
+
+QString GCFollower::listen(const QString &address)
+{
+	stop();
+
+	bool isPort;
+	quint16 port = address.toUShort(&isPort);
+
+	if (isPort) {
+		// Progress of a print is not published beyond this machine.
+		m_tcpServer = new QTcpServer(this);
+		connect(m_tcpServer, SIGNAL(newConnection()), this, SLOT(newConnection()));
+
+		if (!m_tcpServer->listen(QHostAddress::LocalHost, port)) {
+			QString error = m_tcpServer->errorString();
+			stop();
+			return error;
+		}
+	} else {
+		m_localServer = new QLocalServer(this);
+		connect(m_localServer, SIGNAL(newConnection()), this, SLOT(newConnection()));
+
+		// Socket file left by a crashed listener blocks the name, other files are never removed.
+		if (!m_localServer->listen(address) && m_localServer->serverError() == QAbstractSocket::AddressInUseError
+				&& isSocketFile(address)) {
+			QLocalServer::removeServer(address);
+			m_localServer->listen(address);
+		}
+
+		if (!m_localServer->isListening()) {
+			QString error = m_localServer->errorString();
+			stop();
+			return error;
+		}
+	}
+
+	return QString();
+}
+
+bool GCFollower::isListening() const
+{
+	return m_tcpServer || m_localServer;
+}
+
+void GCFollower::stop()
+{
+	if (m_client) {
+		m_client->disconnect(this);
+		m_client->close();
+		m_client->deleteLater();
+		m_client = 0;
+	}
+
+	delete m_tcpServer;
+	m_tcpServer = 0;
+	delete m_localServer;
+	m_localServer = 0;
+}
+
+void GCFollower::newConnection()
+{
+	QIODevice *client = m_tcpServer ? static_cast<QIODevice *>(m_tcpServer->nextPendingConnection())
+									: static_cast<QIODevice *>(m_localServer->nextPendingConnection());
+
+	if (!client) {
+		return;
+	}
+
+	if (m_client) {
+		m_client->disconnect(this);
+		m_client->close();
+		m_client->deleteLater();
+	}
+
+	m_client = client;
+	connect(m_client, SIGNAL(readyRead()), this, SLOT(readLines()));
+}
+
+void GCFollower::readLines()
+{
+	// Host can send hundreds of lines per second, only the newest one is shown.
+	qint64 lastLine = -1;
+
+	while (m_client->canReadLine()) {
+		QByteArray text = m_client->readLine();
+		const char *pos = text.constData();
+		const char *end = pos + text.size();
+
+		while (pos < end && (*pos < '0' || *pos > '9')) {
+			++pos;
+		}
+
+		if (pos == end) {
+			continue;
+		}
+
+		qint64 line = 0;
+
+		while (pos < end && *pos >= '0' && *pos <= '9') {
+			line = line * 10 + (*pos++ - '0');
+		}
+
+		lastLine = line;
+	}
+
+	if (lastLine >= 0) {
+		emit lineReached(lastLine);
+	}
+}
@@ -0,0 +1,43 @@
+#ifndef GCFOLLOWER_H
+#define GCFOLLOWER_H
+
+#include <QObject>
+#include <QString>
+
+class QIODevice;
+class QLocalServer;
+class QTcpServer;
+
+// Receives lines being executed by the printer from host software. Each text line sent by the client carries
+// a line number of the file as its first integer, e.g. "N1234" or "1234".
+class GCFollower : public QObject
+{
+	Q_OBJECT
+	Q_DISABLE_COPY(GCFollower)
+
+public:
+	explicit GCFollower(QObject *parent = 0);
+	virtual ~GCFollower();
+
+	// Address is a TCP port on localhost or name of a local socket. Returns error, empty string once listening.
+	QString listen(const QString &address);
+	bool isListening() const;
+
+public slots:
+	void stop();
+
+signals:
+	// Lines received together are reported once with the last of them.
+	void lineReached(qint64 line);
+
+private slots:
+	void newConnection();
+	void readLines();
+
+private:
+	QTcpServer *m_tcpServer;
+	QLocalServer *m_localServer;
+	QIODevice *m_client;				// Only the newest client is followed.
+};
+
+#endif // GCFOLLOWER_H
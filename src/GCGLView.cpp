@@ -1,33 +1,129 @@
 #include "GCGLView.h"
+#include "GCMeshCache.h"
+#include "GCTrace.h"
 
 #include <QtOpenGL/QGLShader>
+#include <QtOpenGL/QGLFramebufferObject>
 #include <QVector4D>
+#include <QTimer>
+#include <QStringList>
 
 #include <cmath>
 #include <clocale>
+#include <cstddef>
+#include <cfloat>
 
 // TODO: Error checking, overflows.
 
+// Frames slower than this are drawn coarse while camera moves (~30 fps).
+const qint64 frameBudget = 33;
+
+// Camera still for this long switches back to full quality.
+const int refineDelay = 250;
+
+// Default GPU memory for layer meshes.
+const size_t defaultMemoryBudget = 512 * 1024 * 1024;
+
+// Samples per pixel of rendered snapshots.
+const int snapshotSamples = 4;
+
+// Free space around model in rendered snapshots, fraction of its size.
+const qreal snapshotMargin = 0.05;
+
+// Weight of the newest sample in smoothed overlay times.
+const double statisticsSmoothing = 0.1;
+
+const GLuint GCGLView::primitiveRestartIndex;
+const GLuint GCGLView::travelSegment;
+
 GCGLView::GCGLView(QWidget *parent)
 	: QGLWidget(QGLFormat(QGL::SampleBuffers | QGL::AlphaChannel), parent),
+	  m_initialized(false),
 	  m_bedGrid(), m_bedPlane(),
-	  m_lastPos(),
+	  m_lastPos(), m_pressPos(),
 	  m_nearPlane(), m_farPlane(),
 	  m_cameraZoom(1),
 	  m_viewPortAspectR(static_cast<qreal>(width()) / (height() ? height() : 1)),
 	  m_projectionMatrix(), m_viewMatrix(),
 	  m_hideUpperLayers(false),
-	  m_shaderProgram(0),
-	  m_printBedVBO(0), m_threadVerticesVBO(0), m_threadIndicesVBO(0),
-	  m_indicesSize(0),
-	  m_thinLinessRange(), m_thickLinesRange(), m_colorRanges()
+	  m_showTravelMoves(false),
+	  m_overview(false),
+	  m_shaderProgram(0), m_pickProgram(0), m_lineProgram(0),
+	  m_printBedVBO(0), m_lineVerticesVBO(0),
+	  m_segmentScalarsTexture(0), m_transferFunctionTexture(0),
+	  m_pickFBO(0), m_pickColorRB(0), m_pickDepthRB(0),
+	  m_pickBufferSize(),
+	  m_meshCache(0),
+	  m_layerLinesEnd(),
+	  m_pendingLayers(),
+	  m_streamTimer(0),
+	  m_thinLinessRange(), m_thickLinesRange(),
+	  m_colorMode(HighlightColor),
+	  m_travelColor(Qt::gray),
+	  m_upperLayersStart(0), m_printedEnd(travelSegment), m_visibleLayers(0, 0),
+	  m_clipZ(-FLT_MAX, FLT_MAX),
+	  m_scalarsRange(0, 1),
+	  m_scalarSegments(0, 0),
+	  m_interacting(false),
+	  m_refineTimer(0),
+	  m_frameTimer(),
+	  m_fullFrameTime(0),
+	  m_showStatistics(false),
+	  m_timerQueriesSupported(false),
+	  m_frameNumber(0),
+	  m_frameStats(), m_lastFrameStats(),
+	  m_cpuTimer(),
+	  m_cpuFrameTime(0),
+	  m_lineBytes(0),
+	  m_memoryCounters(),
+	  m_imageFBO(0),
+	  m_widgetCamera()
 {
+	for (int i = 0; i < 2; ++i) {
+		m_timerQueriesIssued[i] = false;
+		m_timedFullFrame[i] = false;
+
+		for (int pass = 0; pass < numTimedPasses; ++pass) {
+			m_timerQueries[i][pass] = 0;
+		}
+	}
+
+	for (int pass = 0; pass < numTimedPasses; ++pass) {
+		m_gpuPassTime[pass] = 0;
+	}
+
 	m_shaderProgram = new QGLShaderProgram(context(), this);
+	m_pickProgram = new QGLShaderProgram(context(), this);
+	m_lineProgram = new QGLShaderProgram(context(), this);
+
+	m_refineTimer = new QTimer(this);
+	m_refineTimer->setSingleShot(true);
+	m_refineTimer->setInterval(refineDelay);
+	connect(m_refineTimer, SIGNAL(timeout()), this, SLOT(refine()));
+
+	// Missing layer meshes are streamed in between frames.
+	m_streamTimer = new QTimer(this);
+	m_streamTimer->setSingleShot(true);
+	m_streamTimer->setInterval(0);
+	connect(m_streamTimer, SIGNAL(timeout()), this, SLOT(streamLayers()));
+
+	m_meshCache = new GCMeshCache(defaultMemoryBudget);
 }
 
-void GCGLView::setGridDimensions(const QRectF &dimensions)
+GCGLView::~GCGLView()
 {
+	// Mesh buffers are released in GL context.
+	makeCurrent();
+	delete m_imageFBO;
+	delete m_meshCache;
+
+	if (m_timerQueriesSupported) {
+		glDeleteQueries(2 * numTimedPasses, &m_timerQueries[0][0]);
+	}
+}
 
+void GCGLView::setGridDimensions(const QRectF &dimensions)
+{
 	if (m_bedGrid == dimensions) {
 		return;
 	}
@@ -43,7 +139,7 @@ void GCGLView::setGridDimensions(const QRectF &dimensions)
 	createPrintBed();
 	updateZPlanes();
 
-	updateGL();
+	update();
 }
 
 const QRectF &GCGLView::gridDimensions() const
@@ -75,29 +171,170 @@ void GCGLView::hideUpperLayers(int hide)
 {
 	if (m_hideUpperLayers != static_cast<bool>(hide)) {
 		m_hideUpperLayers = hide;
-		updateGL();
+		update();
+	}
+
+}
+
+void GCGLView::showTravelMoves(bool show)
+{
+	if (m_showTravelMoves != show) {
+		m_showTravelMoves = show;
+		update();
 	}
+}
 
+void GCGLView::setOverview(bool overview)
+{
+	if (m_overview != overview) {
+		m_overview = overview;
+		update();
+	}
 }
 
-void GCGLView::bufferGCData(const std::vector<Vertex> &vertices, const std::vector<GLuint> &indices)
+void GCGLView::setMemoryBudget(size_t bytes)
 {
-	glBindBuffer(GL_ARRAY_BUFFER, m_threadVerticesVBO);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+	makeCurrent();
+	m_meshCache->setBudget(bytes);
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_threadIndicesVBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
+	update();
+}
 
-	m_indicesSize = indices.size();
-	
-	m_colorRanges.clear();
+size_t GCGLView::memoryBudget() const
+{
+	return m_meshCache->budget();
 }
 
-void GCGLView::changeColorRanges(const std::vector<QPair<size_t, QColor> > &colorRanges)
+void GCGLView::bufferGCData(const std::vector<LineVertex> &lineVertices, const std::vector<size_t> &layerLinesEnd)
 {
-	m_colorRanges = colorRanges;
+	makeContextCurrent();
 
-	updateGL();
+	// Layer meshes are requested once they become visible.
+	m_meshCache->reset(layerLinesEnd.size());
+	m_pendingLayers = std::vector<size_t>();
+
+	bufferLines(lineVertices, layerLinesEnd);
+
+	m_upperLayersStart = layerLinesEnd.size();
+	m_visibleLayers = QPair<size_t, size_t>(0, layerLinesEnd.size());
+	m_clipZ = QPair<GLfloat, GLfloat>(-FLT_MAX, FLT_MAX);
+
+	for (int i = 0; i < 3; ++i) {
+		m_highlightRanges[i] = QPair<GLuint, GLuint>();
+	}
+	m_printedEnd = travelSegment;
+}
+
+void GCGLView::bufferLines(const std::vector<LineVertex> &lineVertices, const std::vector<size_t> &layerLinesEnd)
+{
+	GC_TRACE_SCOPE("upload lines");
+	GC_TRACE_COUNTER("line bytes", lineVertices.size() * sizeof(LineVertex));
+
+	makeContextCurrent();
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_lineVerticesVBO);
+	glBufferData(GL_ARRAY_BUFFER, lineVertices.size() * sizeof(LineVertex), lineVertices.empty() ? 0 : &lineVertices[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	m_lineBytes = lineVertices.size() * sizeof(LineVertex);
+
+	m_layerLinesEnd = layerLinesEnd;
+
+	update();
+}
+
+void GCGLView::bufferLayer(size_t layer, const Mesh &mesh)
+{
+	GC_TRACE_SCOPE("upload layer");
+
+	makeContextCurrent();
+
+	if (m_meshCache->upload(layer, mesh)) {
+		update();
+	}
+
+	GC_TRACE_COUNTER("mesh cache bytes", m_meshCache->usedBytes());
+}
+
+bool GCGLView::isLayerCached(size_t layer) const
+{
+	return m_meshCache->isResident(layer) || m_meshCache->isStored(layer);
+}
+
+void GCGLView::setHighlightColors(const QColor &object, const QColor &layer, const QColor &path, const QColor &command)
+{
+	m_highlightColors[0] = object;
+	m_highlightColors[1] = layer;
+	m_highlightColors[2] = path;
+	m_highlightColors[3] = command;
+}
+
+void GCGLView::setTravelColor(const QColor &travel)
+{
+	m_travelColor = travel;
+}
+
+void GCGLView::changeHighlight(const QPair<GLuint, GLuint> &layerSegments, const QPair<GLuint, GLuint> &pathSegments,
+							   const QPair<GLuint, GLuint> &commandSegments, size_t upperLayersStart)
+{
+	// Only uniforms change, buffers stay untouched.
+	m_highlightRanges[0] = layerSegments;
+	m_highlightRanges[1] = pathSegments;
+	m_highlightRanges[2] = commandSegments;
+	m_upperLayersStart = qMin(upperLayersStart, m_layerLinesEnd.size());
+
+	update();
+}
+
+void GCGLView::setVisibleRange(size_t firstLayer, size_t endLayer, GLfloat zMin, GLfloat zMax)
+{
+	// No buffer is touched, only drawn layers and clip planes change.
+	m_visibleLayers = QPair<size_t, size_t>(qMin(firstLayer, m_layerLinesEnd.size()),
+											qMin(endLayer, m_layerLinesEnd.size()));
+	m_clipZ = QPair<GLfloat, GLfloat>(zMin, zMax);
+
+	update();
+}
+
+void GCGLView::setPrintProgress(GLuint printedEnd)
+{
+	if (m_printedEnd != printedEnd) {
+		m_printedEnd = printedEnd;
+		update();
+	}
+}
+
+void GCGLView::setColorMode(ColorMode colorMode)
+{
+	if (m_colorMode != colorMode) {
+		m_colorMode = colorMode;
+		update();
+	}
+}
+
+void GCGLView::setSegmentScalars(const std::vector<GLfloat> &scalars, GLuint firstSegment, GLfloat min, GLfloat max)
+{
+	makeContextCurrent();
+
+	// Scalars are stored row by row in 2D texture, 1D textures are too short.
+	GLint maxTextureSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+
+	GLsizei width = static_cast<GLsizei>(qMin(scalars.size(), static_cast<size_t>(maxTextureSize)));
+	width = qMax(width, 1);
+	GLsizei height = static_cast<GLsizei>((scalars.size() + width - 1) / width);
+	height = qMax(height, 1);
+
+	std::vector<GLfloat> texels(scalars);
+	texels.resize(width * height, 0);
+
+	glBindTexture(GL_TEXTURE_2D, m_segmentScalarsTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, &texels[0]);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	m_scalarsRange = QPair<GLfloat, GLfloat>(min, (max > min) ? max : min + 1);
+	m_scalarSegments = QPair<GLuint, GLuint>(firstSegment, firstSegment + static_cast<GLuint>(scalars.size()));
+
+	update();
 }
 
 void GCGLView::initializeGL()
@@ -107,47 +344,132 @@ void GCGLView::initializeGL()
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_CULL_FACE);
 
+	glEnable(GL_PRIMITIVE_RESTART);
+	glPrimitiveRestartIndex(primitiveRestartIndex);
+
 	glGenBuffers(1, &m_printBedVBO);
-	glGenBuffers(1, &m_threadVerticesVBO);
-	glGenBuffers(1, &m_threadIndicesVBO);
+	glGenBuffers(1, &m_lineVerticesVBO);
+
+	// GL_TIME_ELAPSED is core since 3.3.
+	QByteArray extensions(reinterpret_cast<const char *>(glGetString(GL_EXTENSIONS)));
+	m_timerQueriesSupported = (QGLFormat::openGLVersionFlags() & QGLFormat::OpenGL_Version_3_3)
+			|| extensions.contains("GL_ARB_timer_query");
 
+	if (m_timerQueriesSupported) {
+		glGenQueries(2 * numTimedPasses, &m_timerQueries[0][0]);
+	}
+
+	glGenFramebuffers(1, &m_pickFBO);
+	glGenRenderbuffers(1, &m_pickColorRB);
+	glGenRenderbuffers(1, &m_pickDepthRB);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_pickFBO);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_pickColorRB);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_pickDepthRB);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glGenTextures(1, &m_segmentScalarsTexture);
+	glBindTexture(GL_TEXTURE_2D, m_segmentScalarsTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	createTransferFunction();
 	initializeShaders();
 
 	createPrintBed();
 	resetView();
+
+	m_initialized = true;
 }
 
 void GCGLView::paintGL()
 {
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	GC_TRACE_SCOPE("paint");
 
-	qreal w = m_cameraZoom * m_viewPortAspectR;
-	qreal h = m_cameraZoom;
+	// Coarse threads only when full quality frame would not fit in budget.
+	bool coarse = m_interacting && m_fullFrameTime > frameBudget;
 
-	m_projectionMatrix.setToIdentity();
-	m_projectionMatrix.ortho(-w / 2, w / 2, -h / 2, h / 2, -m_nearPlane, -m_farPlane);
+	m_cpuTimer.start();
+	m_frameStats = FrameStats();
+	readTimerQueries();
+
+	if (m_interacting) {
+		glDisable(GL_MULTISAMPLE);
+	} else {
+		glEnable(GL_MULTISAMPLE);
+		m_frameTimer.start();
+	}
+
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	updateProjectionMatrix();
 
 	m_shaderProgram->setUniformValue("proj_view_matrix", m_projectionMatrix * m_viewMatrix);
 	m_shaderProgram->setUniformValue("normal_matrix", m_viewMatrix.normalMatrix());
 
+	beginTimedPass(PrintBedPass);
 	paintPrintBed();
-	paintThreads();
+	endTimedPass();
+
+	beginTimedPass(ModelPass);
+
+	if (!m_overview) {
+		m_meshCache->beginFrame();
+	}
+
+	std::vector<size_t> missingLayers;
+	paintModel(coarse, missingLayers);
+
+	m_pendingLayers.swap(missingLayers);
+	if (!m_pendingLayers.empty()) {
+		m_streamTimer->start();
+	}
+
+	endTimedPass();
+
+	m_timerQueriesIssued[m_frameNumber % 2] = m_timerQueriesSupported;
+	m_timedFullFrame[m_frameNumber % 2] = !m_interacting;
+	++m_frameNumber;
+
+	m_lastFrameStats = m_frameStats;
+	m_cpuFrameTime += (m_cpuTimer.nsecsElapsed() / 1e6 - m_cpuFrameTime) * statisticsSmoothing;
+
+	if (m_showStatistics) {
+		paintStatistics();
+	}
+
+	// Without timer queries only CPU side of full quality frames is measured.
+	if (!m_interacting && !m_timerQueriesSupported) {
+		m_fullFrameTime = m_frameTimer.elapsed();
+	}
 
 	glFlush();
 }
 
 void GCGLView::resizeGL(int w, int h)
 {
-
 	glViewport(0, 0, static_cast<GLint>(w), static_cast<GLint>(h));
 	m_viewPortAspectR = static_cast<qreal>(w) / (h ? h : 1);
 
-	updateGL();
+	update();
 }
 
 void GCGLView::mousePressEvent(QMouseEvent *event)
 {
 	m_lastPos = event->pos();
+	m_pressPos = event->pos();
+}
+
+void GCGLView::mouseReleaseEvent(QMouseEvent *event)
+{
+	// Left click without dragging picks segment.
+	if (event->button() == Qt::LeftButton && (event->pos() - m_pressPos).manhattanLength() < 3) {
+		int segment = pickSegment(event->pos());
+
+		if (segment >= 0) {
+			emit segmentPicked(segment);
+		}
+	}
 }
 
 void GCGLView::mouseMoveEvent(QMouseEvent *event)
@@ -171,7 +493,7 @@ void GCGLView::mouseMoveEvent(QMouseEvent *event)
 	m_viewMatrix = transform * m_viewMatrix;
 	updateZPlanes();
 
-	updateGL();
+	interact();
 }
 
 void GCGLView::wheelEvent(QWheelEvent *event)
@@ -182,7 +504,60 @@ void GCGLView::wheelEvent(QWheelEvent *event)
 		m_cameraZoom = 0.001;
 	}
 
-	updateGL();
+	interact();
+}
+
+void GCGLView::interact()
+{
+	// Redraws are coalesced by update(), full quality returns once camera stops.
+	m_interacting = true;
+	m_refineTimer->start();
+
+	update();
+}
+
+void GCGLView::refine()
+{
+	m_interacting = false;
+
+	update();
+}
+
+void GCGLView::streamLayers()
+{
+	GC_TRACE_SCOPE("stream layers");
+
+	makeCurrent();
+
+	// Load as many layers as fit in one frame, the rest is left for next frames.
+	QElapsedTimer timer;
+	timer.start();
+
+	bool loaded = false;
+
+	for (size_t i = 0; i < m_pendingLayers.size() && timer.elapsed() < frameBudget; ++i) {
+		size_t layer = m_pendingLayers[i];
+
+		if (m_meshCache->isResident(layer)) {
+			continue;
+		}
+
+		if (m_meshCache->isStored(layer)) {
+			// Layers which would only evict visible layers stay drawn as lines.
+			if (m_meshCache->load(layer)) {
+				loaded = true;
+			}
+		} else {
+			emit layerRequested(static_cast<int>(layer));
+			loaded = loaded || m_meshCache->isResident(layer);
+		}
+	}
+
+	m_pendingLayers = std::vector<size_t>();
+
+	if (loaded) {
+		update();
+	}
 }
 
 void GCGLView::createPrintBed()
@@ -280,12 +655,14 @@ void GCGLView::paintPrintBed()
 {
 	glBindBuffer(GL_ARRAY_BUFFER, m_printBedVBO);
 	m_shaderProgram->enableAttributeArray("position");
-	m_shaderProgram->setAttributeBuffer("position", GL_FLOAT, 0, 3, static_cast<int>(sizeof(GLfloat) * 6));
+	m_shaderProgram->setAttributeBuffer("position", GL_FLOAT, 0, 3, static_cast<int>(sizeof(Vertex)));
 	m_shaderProgram->enableAttributeArray("normal");
-	m_shaderProgram->setAttributeBuffer("normal", GL_FLOAT, static_cast<int>(3 * sizeof(GLfloat)), 3, static_cast<int>(sizeof(GLfloat) * 6));
+	m_shaderProgram->setAttributeBuffer("normal", GL_FLOAT, static_cast<int>(offsetof(Vertex, normal)), 3, static_cast<int>(sizeof(Vertex)));
 
+	m_shaderProgram->setUniformValue("color_mode", static_cast<GLint>(GlobalColor));
 	m_shaderProgram->setUniformValue("global_color", 0.5, 0.5, 0.5, 1.0);
 	glDrawArrays(GL_QUADS, 0, 4);
+	m_frameStats.triangles += 2;
 
 	glLineWidth(1);
 	m_shaderProgram->setUniformValue("global_color", 0.0, 0.0, 0.0, 1.0);
@@ -294,41 +671,442 @@ void GCGLView::paintPrintBed()
 	glLineWidth(3);
 	m_shaderProgram->setUniformValue("global_color", 0.0, 0.0, 0.0, 1.0);
 	glDrawArrays(GL_LINES, m_thickLinesRange.first, m_thickLinesRange.second - m_thickLinesRange.first);
+
+	m_frameStats.drawCalls += 3;
+	m_frameStats.lines += (m_thinLinessRange.second - m_thinLinessRange.first
+						   + m_thickLinesRange.second - m_thickLinesRange.first) / 2;
 }
 
-void GCGLView::paintThreads()
+void GCGLView::paintModel(bool coarse, std::vector<size_t> &missingLayers)
 {
-	glBindBuffer(GL_ARRAY_BUFFER, m_threadVerticesVBO);
-	m_shaderProgram->enableAttributeArray("position");
-	m_shaderProgram->setAttributeBuffer("position", GL_FLOAT, 0, 3, static_cast<int>(sizeof(Vertex)));
-	m_shaderProgram->enableAttributeArray("normal");
-	m_shaderProgram->setAttributeBuffer("normal", GL_FLOAT, static_cast<int>(3 * sizeof(GLfloat)), 3, static_cast<int>(sizeof(Vertex)));
+	// Lines are cheap, they are never coarsened.
+	if (m_overview) {
+		paintLines(visibleLayers(), true, m_showTravelMoves);
+		return;
+	}
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_threadIndicesVBO);
+	paintThreads(coarse, missingLayers);
 
-	GLsizei start = 0;
-	for (size_t i = 0; i < m_colorRanges.size(); ++i) {
-		if (i == m_colorRanges.size() - 1 && m_hideUpperLayers) {
-			break;
-		}
+	// Layers not yet in GPU memory are drawn as lines until they stream in.
+	if (!missingLayers.empty()) {
+		paintLines(missingLayers, true, false);
+	}
+
+	if (m_showTravelMoves) {
+		paintLines(visibleLayers(), false, true);
+	}
+}
+
+void GCGLView::paintThreads(bool coarse, std::vector<size_t> &missingLayers)
+{
+	m_shaderProgram->setUniformValue("color_mode", static_cast<GLint>(m_colorMode));
+	m_shaderProgram->setUniformValue("clip_z", m_clipZ.first, m_clipZ.second);
+	setHighlightUniforms(m_shaderProgram);
+	m_shaderProgram->setUniformValue("scalar_range", m_scalarsRange.first, m_scalarsRange.second);
+	glUniform2ui(m_shaderProgram->uniformLocation("scalar_segments"), m_scalarSegments.first, m_scalarSegments.second);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, m_segmentScalarsTexture);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_1D, m_transferFunctionTexture);
 
-		GLsizei end = static_cast<GLsizei>(m_colorRanges[i].first);
+	// One call per layer, highlighting is resolved in shader.
+	drawThreads(m_shaderProgram, coarse, missingLayers);
 
-		if (end <= start) {
+	glBindTexture(GL_TEXTURE_1D, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	releaseThreadAttributes(m_shaderProgram);
+}
+
+void GCGLView::setHighlightUniforms(QGLShaderProgram *program)
+{
+	program->setUniformValue("object_color", m_highlightColors[0]);
+	program->setUniformValue("layer_color", m_highlightColors[1]);
+	program->setUniformValue("path_color", m_highlightColors[2]);
+	program->setUniformValue("command_color", m_highlightColors[3]);
+	glUniform2ui(program->uniformLocation("layer_range"), m_highlightRanges[0].first, m_highlightRanges[0].second);
+	glUniform2ui(program->uniformLocation("path_range"), m_highlightRanges[1].first, m_highlightRanges[1].second);
+	glUniform2ui(program->uniformLocation("command_range"), m_highlightRanges[2].first, m_highlightRanges[2].second);
+	glUniform1ui(program->uniformLocation("printed_end"), m_printedEnd);
+}
+
+void GCGLView::bindThreadAttributes(QGLShaderProgram *program, GLuint verticesVBO)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, verticesVBO);
+	program->enableAttributeArray("position");
+	program->setAttributeBuffer("position", GL_FLOAT, 0, 3, static_cast<int>(sizeof(Vertex)));
+
+	if (program->attributeLocation("normal") >= 0) {
+		program->enableAttributeArray("normal");
+		program->setAttributeBuffer("normal", GL_FLOAT, static_cast<int>(offsetof(Vertex, normal)), 3, static_cast<int>(sizeof(Vertex)));
+	}
+
+	program->enableAttributeArray("segment");
+	program->setAttributeBuffer("segment", GL_FLOAT, static_cast<int>(offsetof(Vertex, segment)), 1, static_cast<int>(sizeof(Vertex)));
+
+	// Integer attribute, QGLShaderProgram would convert it to float.
+	GLuint firstSegmentLocation = static_cast<GLuint>(program->attributeLocation("first_segment"));
+	glEnableVertexAttribArray(firstSegmentLocation);
+	glVertexAttribIPointer(firstSegmentLocation, 1, GL_UNSIGNED_INT, static_cast<GLsizei>(sizeof(Vertex)),
+						   reinterpret_cast<GLvoid *>(offsetof(Vertex, firstSegment)));
+}
+
+void GCGLView::releaseThreadAttributes(QGLShaderProgram *program)
+{
+	program->disableAttributeArray("segment");
+	glDisableVertexAttribArray(static_cast<GLuint>(program->attributeLocation("first_segment")));
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void GCGLView::drawThreads(QGLShaderProgram *program, bool coarse, std::vector<size_t> &missingLayers)
+{
+	glEnable(GL_CLIP_DISTANCE0);
+	glEnable(GL_CLIP_DISTANCE1);
+
+	size_t end = visibleLayersEnd();
+
+	for (size_t layer = m_visibleLayers.first; layer < end; ++layer) {
+		const GCMeshCache::Chunk *chunk = m_meshCache->use(layer);
+
+		if (!chunk) {
+			missingLayers.push_back(layer);
 			continue;
 		}
 
-		GLsizei count = end - start;
-		QColor &color = m_colorRanges[i].second;
+		size_t count = coarse ? chunk->numCoarseIndices : chunk->numIndices;
+
+		if (!count) {
+			continue;
+		}
 
-		m_shaderProgram->setUniformValue("global_color", color);
-		glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, reinterpret_cast<GLvoid *>(start * sizeof(GLuint)));
+		bindThreadAttributes(program, chunk->verticesVBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, coarse ? chunk->coarseIndicesVBO : chunk->indicesVBO);
+		glDrawElements(GL_TRIANGLE_STRIP, static_cast<GLsizei>(count), GL_UNSIGNED_INT, 0);
 
-		start = end;
+		++m_frameStats.drawCalls;
+		m_frameStats.triangles += coarse ? chunk->numCoarseTriangles : chunk->numTriangles;
 	}
 
+	glDisable(GL_CLIP_DISTANCE0);
+	glDisable(GL_CLIP_DISTANCE1);
+}
+
+void GCGLView::paintLines(const std::vector<size_t> &layers, bool extrusions, bool travels)
+{
+	m_lineProgram->bind();
+	m_lineProgram->setUniformValue("proj_view_matrix", m_projectionMatrix * m_viewMatrix);
+	m_lineProgram->setUniformValue("show_extrusions", extrusions);
+	m_lineProgram->setUniformValue("show_travels", travels);
+	m_lineProgram->setUniformValue("travel_color", m_travelColor);
+	setHighlightUniforms(m_lineProgram);
+
+	bindLineAttributes(m_lineProgram);
+
+	glLineWidth(1);
+	drawLines(layers);
+
+	glDisableVertexAttribArray(3);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	m_shaderProgram->bind();
+}
+
+void GCGLView::bindLineAttributes(QGLShaderProgram *program)
+{
+	// Arrays left enabled by other programs would be read past the end of their buffers.
+	glDisableVertexAttribArray(1);
+	glDisableVertexAttribArray(2);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_lineVerticesVBO);
+	program->enableAttributeArray("position");
+	program->setAttributeBuffer("position", GL_FLOAT, 0, 3, static_cast<int>(sizeof(LineVertex)));
+
+	// Segment ID goes to first_segment location in every program, see bindAttributeLocations().
+	glEnableVertexAttribArray(3);
+	glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, static_cast<GLsizei>(sizeof(LineVertex)),
+						   reinterpret_cast<GLvoid *>(offsetof(LineVertex, segment)));
+
+	program->setUniformValue("clip_z", m_clipZ.first, m_clipZ.second);
+}
+
+void GCGLView::drawLines(const std::vector<size_t> &layers)
+{
+	glEnable(GL_CLIP_DISTANCE0);
+	glEnable(GL_CLIP_DISTANCE1);
+
+	// Lines of consecutive layers are drawn in one call.
+	for (size_t i = 0; i < layers.size(); ) {
+		size_t firstLayer = layers[i];
+		size_t lastLayer = firstLayer;
+
+		for (++i; i < layers.size() && layers[i] == lastLayer + 1; ++i) {
+			lastLayer = layers[i];
+		}
+
+		size_t first = firstLayer ? m_layerLinesEnd[firstLayer - 1] : 0;
+		size_t end = m_layerLinesEnd[lastLayer];
+
+		if (end > first) {
+			glDrawArrays(GL_LINES, static_cast<GLint>(first), static_cast<GLsizei>(end - first));
+
+			++m_frameStats.drawCalls;
+			m_frameStats.lines += (end - first) / 2;
+		}
+	}
+
+	glDisable(GL_CLIP_DISTANCE0);
+	glDisable(GL_CLIP_DISTANCE1);
+}
+
+size_t GCGLView::visibleLayersEnd() const
+{
+	return m_hideUpperLayers ? qMin(m_visibleLayers.second, m_upperLayersStart) : m_visibleLayers.second;
+}
+
+std::vector<size_t> GCGLView::visibleLayers() const
+{
+	std::vector<size_t> layers;
+
+	for (size_t layer = m_visibleLayers.first; layer < visibleLayersEnd(); ++layer) {
+		layers.push_back(layer);
+	}
+
+	return layers;
+}
+
+int GCGLView::pickSegment(const QPoint &pos)
+{
+	if (m_layerLinesEnd.empty() || !rect().contains(pos)) {
+		return -1;
+	}
+
+	makeCurrent();
+
+	// Segment IDs are rendered on demand into offscreen integer buffer matching widget size.
+	if (m_pickBufferSize != size()) {
+		m_pickBufferSize = size();
+
+		glBindRenderbuffer(GL_RENDERBUFFER, m_pickColorRB);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_R32UI, width(), height());
+		glBindRenderbuffer(GL_RENDERBUFFER, m_pickDepthRB);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width(), height());
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_pickFBO);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		return -1;
+	}
+
+	// Zero marks no segment, IDs are stored incremented by one.
+	const GLuint clearId[4] = {0, 0, 0, 0};
+	glClearBufferuiv(GL_COLOR, 0, clearId);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	updateProjectionMatrix();
+
+	m_pickProgram->bind();
+	m_pickProgram->setUniformValue("proj_view_matrix", m_projectionMatrix * m_viewMatrix);
+	m_pickProgram->setUniformValue("clip_z", m_clipZ.first, m_clipZ.second);
+
+	// Only what is drawn can be picked, nothing is streamed in for picking.
+	std::vector<size_t> lineLayers;
+
+	if (m_overview) {
+		lineLayers = visibleLayers();
+	} else {
+		drawThreads(m_pickProgram, false, lineLayers);
+		releaseThreadAttributes(m_pickProgram);
+	}
+
+	if (!lineLayers.empty()) {
+		// Line segment ID feeds first_segment with constant zero segment, travel IDs wrap to background.
+		bindLineAttributes(m_pickProgram);
+		m_pickProgram->disableAttributeArray("segment");
+		m_pickProgram->setAttributeValue("segment", 0.0f);
+		drawLines(lineLayers);
+		glDisableVertexAttribArray(3);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// Read small neighbourhood so thin threads are easy to hit.
+	const int pickRadius = 3;
+	const int pickSize = pickRadius * 2 + 1;
+	GLuint ids[pickSize * pickSize] = {0};
+
+	QRect pickRect(pos.x() - pickRadius, height() - 1 - pos.y() - pickRadius, pickSize, pickSize);
+	pickRect &= QRect(0, 0, width(), height());
+
+	glReadPixels(pickRect.x(), pickRect.y(), pickRect.width(), pickRect.height(), GL_RED_INTEGER, GL_UNSIGNED_INT, ids);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	m_shaderProgram->bind();
+
+	// Take segment closest to the center.
+	int picked = -1;
+	int pickedDistance = 0;
+	QPoint center(pos.x(), height() - 1 - pos.y());
+
+	for (int y = 0; y < pickRect.height(); ++y) {
+		for (int x = 0; x < pickRect.width(); ++x) {
+			GLuint id = ids[y * pickRect.width() + x];
+
+			if (id == 0) {
+				continue;
+			}
+
+			int distance = (QPoint(pickRect.x() + x, pickRect.y() + y) - center).manhattanLength();
+
+			if (picked < 0 || distance < pickedDistance) {
+				picked = static_cast<int>(id - 1);
+				pickedDistance = distance;
+			}
+		}
+	}
+
+	return picked;
+}
+
+void GCGLView::showStatistics(bool show)
+{
+	if (m_showStatistics != show) {
+		m_showStatistics = show;
+		update();
+	}
+}
+
+void GCGLView::setMemoryCounter(const QString &name, qint64 bytes)
+{
+	m_memoryCounters[name] = bytes;
+
+	if (m_showStatistics) {
+		update();
+	}
+}
+
+bool GCGLView::beginImage(const QSize &size, ViewDirection direction, const QVector3D &minCorner, const QVector3D &maxCorner)
+{
+	makeContextCurrent();
+
+	QGLFramebufferObjectFormat format;
+	format.setAttachment(QGLFramebufferObject::Depth);
+	format.setSamples(snapshotSamples);
+
+	delete m_imageFBO;
+	m_imageFBO = new QGLFramebufferObject(size, format);
+
+	if (!m_imageFBO->isValid()) {
+		delete m_imageFBO;
+		m_imageFBO = 0;
+		return false;
+	}
+
+	m_widgetCamera.viewMatrix = m_viewMatrix;
+	m_widgetCamera.zoom = m_cameraZoom;
+	m_widgetCamera.aspectRatio = m_viewPortAspectR;
+	m_widgetCamera.nearPlane = m_nearPlane;
+	m_widgetCamera.farPlane = m_farPlane;
+
+	m_viewPortAspectR = static_cast<qreal>(size.width()) / (size.height() ? size.height() : 1);
+	fitView(direction, minCorner, maxCorner);
+	updateProjectionMatrix();
+
+	m_imageFBO->bind();
+	glViewport(0, 0, size.width(), size.height());
+	glEnable(GL_MULTISAMPLE);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	m_shaderProgram->setUniformValue("proj_view_matrix", m_projectionMatrix * m_viewMatrix);
+	m_shaderProgram->setUniformValue("normal_matrix", m_viewMatrix.normalMatrix());
+	paintPrintBed();
+
+	m_imageFBO->release();
+	glViewport(0, 0, width(), height());
+
+	return true;
+}
+
+void GCGLView::paintImageLayers(size_t firstLayer, size_t endLayer)
+{
+	if (!m_imageFBO) {
+		return;
+	}
+
+	GC_TRACE_SCOPE("paint image layers");
+
+	makeContextCurrent();
+
+	// Image isn't cleared, layers painted before stay and depth test sorts them out.
+	m_imageFBO->bind();
+	glViewport(0, 0, m_imageFBO->width(), m_imageFBO->height());
+	glEnable(GL_MULTISAMPLE);
+
+	m_shaderProgram->setUniformValue("proj_view_matrix", m_projectionMatrix * m_viewMatrix);
+	m_shaderProgram->setUniformValue("normal_matrix", m_viewMatrix.normalMatrix());
+
+	QPair<size_t, size_t> visibleLayers = m_visibleLayers;
+	m_visibleLayers = QPair<size_t, size_t>(firstLayer, endLayer);
+
+	// Layers without resident mesh are painted as lines, they aren't streamed in for image.
+	if (!m_overview) {
+		m_meshCache->beginFrame();
+	}
+
+	std::vector<size_t> missingLayers;
+	paintModel(false, missingLayers);
+
+	m_visibleLayers = visibleLayers;
+
+	m_imageFBO->release();
+	glViewport(0, 0, width(), height());
+}
+
+QImage GCGLView::endImage()
+{
+	if (!m_imageFBO) {
+		return QImage();
+	}
+
+	makeContextCurrent();
+
+	QImage image = m_imageFBO->toImage();
+
+	delete m_imageFBO;
+	m_imageFBO = 0;
+
+	m_viewMatrix = m_widgetCamera.viewMatrix;
+	m_cameraZoom = m_widgetCamera.zoom;
+	m_viewPortAspectR = m_widgetCamera.aspectRatio;
+	m_nearPlane = m_widgetCamera.nearPlane;
+	m_farPlane = m_widgetCamera.farPlane;
+	updateProjectionMatrix();
+
+	return image;
+}
+
+void GCGLView::makeContextCurrent()
+{
+	makeCurrent();
+
+	// Hidden widget is never painted, GL resources are created on first use instead.
+	if (!m_initialized) {
+		glInit();
+	}
+}
+
+void GCGLView::updateProjectionMatrix()
+{
+	qreal w = m_cameraZoom * m_viewPortAspectR;
+	qreal h = m_cameraZoom;
+
+	m_projectionMatrix.setToIdentity();
+	m_projectionMatrix.ortho(-w / 2, w / 2, -h / 2, h / 2, -m_nearPlane, -m_farPlane);
 }
 
 void GCGLView::updateZPlanes()
@@ -375,14 +1153,197 @@ void GCGLView::updateZPlanes()
 	m_farPlane = far - 0.1;
 }
 
+void GCGLView::fitView(ViewDirection direction, const QVector3D &minCorner, const QVector3D &maxCorner)
+{
+	m_viewMatrix.setToIdentity();
+
+	if (direction == FrontView) {
+		m_viewMatrix.rotate(-90, 1, 0, 0);
+	} else if (direction == IsoView) {
+		m_viewMatrix.rotate(-60, 1, 0, 0);
+		m_viewMatrix.rotate(-45, 0, 0, 1);
+	}
+
+	QVector3D viewMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	QVector3D viewMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	for (int i = 0; i < 8; ++i) {
+		QVector3D corner((i & 1) ? maxCorner.x() : minCorner.x(),
+						 (i & 2) ? maxCorner.y() : minCorner.y(),
+						 (i & 4) ? maxCorner.z() : minCorner.z());
+		QVector3D p = m_viewMatrix.map(corner);
+
+		viewMin = QVector3D(qMin(viewMin.x(), p.x()), qMin(viewMin.y(), p.y()), qMin(viewMin.z(), p.z()));
+		viewMax = QVector3D(qMax(viewMax.x(), p.x()), qMax(viewMax.y(), p.y()), qMax(viewMax.z(), p.z()));
+	}
+
+	QVector3D center = (viewMin + viewMax) / 2;
+	QMatrix4x4 centering;
+	centering.translate(-center.x(), -center.y());
+	m_viewMatrix = centering * m_viewMatrix;
+
+	qreal w = viewMax.x() - viewMin.x();
+	qreal h = viewMax.y() - viewMin.y();
+	m_cameraZoom = qMax(h, w / m_viewPortAspectR) * (1 + 2 * snapshotMargin);
+
+	if (m_cameraZoom <= 0) {
+		m_cameraZoom = 1;
+	}
+
+	// Model may be taller than the box covered by bed planes.
+	updateZPlanes();
+	m_nearPlane = qMax(m_nearPlane, static_cast<qreal>(viewMax.z()) + 1);
+	m_farPlane = qMin(m_farPlane, static_cast<qreal>(viewMin.z()) - 1);
+}
+
 void GCGLView::initializeShaders()
 {
 	setlocale(LC_NUMERIC, "C");
 
 	m_shaderProgram->addShaderFromSourceFile(QGLShader::Vertex, ":/vertex.glsl");
 	m_shaderProgram->addShaderFromSourceFile(QGLShader::Fragment, ":/fragment.glsl");
+	bindAttributeLocations(m_shaderProgram);
 	m_shaderProgram->link();
 	m_shaderProgram->bind();
 
+	m_shaderProgram->setUniformValue("segment_scalars", 0);
+	m_shaderProgram->setUniformValue("transfer_function", 1);
+
+	m_pickProgram->addShaderFromSourceFile(QGLShader::Vertex, ":/pick_vertex.glsl");
+	m_pickProgram->addShaderFromSourceFile(QGLShader::Fragment, ":/pick_fragment.glsl");
+	bindAttributeLocations(m_pickProgram);
+	m_pickProgram->link();
+
+	m_lineProgram->addShaderFromSourceFile(QGLShader::Vertex, ":/line_vertex.glsl");
+	m_lineProgram->addShaderFromSourceFile(QGLShader::Fragment, ":/line_fragment.glsl");
+	bindAttributeLocations(m_lineProgram);
+	m_lineProgram->link();
+
+	m_shaderProgram->bind();
+
 	setlocale(LC_ALL, "");
 }
+
+void GCGLView::bindAttributeLocations(QGLShaderProgram *program)
+{
+	// Same locations in all programs, enabled arrays then never point to unexpected attributes.
+	program->bindAttributeLocation("position", 0);
+	program->bindAttributeLocation("normal", 1);
+	program->bindAttributeLocation("segment", 2);
+	program->bindAttributeLocation("first_segment", 3);
+	program->bindAttributeLocation("line_segment", 3);
+}
+
+void GCGLView::createTransferFunction()
+{
+	// Blue for low values through green to red for high values.
+	const int numTexels = 256;
+	std::vector<GLubyte> texels;
+	texels.reserve(numTexels * 4);
+
+	for (int texelNo = 0; texelNo < numTexels; ++texelNo) {
+		QColor color = QColor::fromHsvF(2.0 / 3.0 * (1.0 - static_cast<qreal>(texelNo) / (numTexels - 1)), 1.0, 1.0);
+
+		texels.push_back(static_cast<GLubyte>(color.red()));
+		texels.push_back(static_cast<GLubyte>(color.green()));
+		texels.push_back(static_cast<GLubyte>(color.blue()));
+		texels.push_back(255);
+	}
+
+	glGenTextures(1, &m_transferFunctionTexture);
+	glBindTexture(GL_TEXTURE_1D, m_transferFunctionTexture);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA8, numTexels, 0, GL_RGBA, GL_UNSIGNED_BYTE, &texels[0]);
+	glBindTexture(GL_TEXTURE_1D, 0);
+}
+
+void GCGLView::beginTimedPass(TimedPass pass)
+{
+	if (m_timerQueriesSupported) {
+		glBeginQuery(GL_TIME_ELAPSED, m_timerQueries[m_frameNumber % 2][pass]);
+	}
+}
+
+void GCGLView::endTimedPass()
+{
+	if (m_timerQueriesSupported) {
+		glEndQuery(GL_TIME_ELAPSED);
+	}
+}
+
+void GCGLView::readTimerQueries()
+{
+	// Queries of this slot were issued two frames ago, results not ready yet are dropped.
+	unsigned slot = m_frameNumber % 2;
+
+	if (!m_timerQueriesIssued[slot]) {
+		return;
+	}
+
+	m_timerQueriesIssued[slot] = false;
+
+	GLuint64 frameTime = 0;
+	bool complete = true;
+
+	for (int pass = 0; pass < numTimedPasses; ++pass) {
+		GLuint available = 0;
+		glGetQueryObjectuiv(m_timerQueries[slot][pass], GL_QUERY_RESULT_AVAILABLE, &available);
+
+		if (!available) {
+			complete = false;
+			continue;
+		}
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(m_timerQueries[slot][pass], GL_QUERY_RESULT, &elapsed);
+		m_gpuPassTime[pass] += (elapsed / 1e6 - m_gpuPassTime[pass]) * statisticsSmoothing;
+		frameTime += elapsed;
+	}
+
+	if (complete && m_timedFullFrame[slot]) {
+		m_fullFrameTime = static_cast<qint64>(frameTime / 1000000);
+	}
+}
+
+void GCGLView::paintStatistics()
+{
+	const double MiB = 1024.0 * 1024.0;
+
+	QStringList lines;
+	lines << tr("CPU frame: %1 ms").arg(m_cpuFrameTime, 0, 'f', 2);
+
+	if (m_timerQueriesSupported) {
+		lines << tr("GPU print bed: %1 ms").arg(m_gpuPassTime[PrintBedPass], 0, 'f', 2);
+		lines << tr("GPU model: %1 ms").arg(m_gpuPassTime[ModelPass], 0, 'f', 2);
+	} else {
+		lines << tr("GPU timer queries not supported");
+	}
+
+	lines << tr("Draw calls: %1").arg(m_lastFrameStats.drawCalls);
+	lines << tr("Triangles: %1").arg(m_lastFrameStats.triangles);
+	lines << tr("Lines: %1").arg(m_lastFrameStats.lines);
+	lines << tr("GPU buffers: %1 MiB").arg((m_meshCache->usedBytes() + m_lineBytes) / MiB, 0, 'f', 1);
+
+	for (QMap<QString, qint64>::const_iterator it = m_memoryCounters.constBegin(); it != m_memoryCounters.constEnd(); ++it) {
+		lines << tr("%1: %2 MiB").arg(it.key()).arg(it.value() / MiB, 0, 'f', 1);
+	}
+
+	// Text is drawn by fixed function pipeline, arrays of thread attributes must not be enabled.
+	for (GLuint location = 0; location < 4; ++location) {
+		glDisableVertexAttribArray(location);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	m_shaderProgram->release();
+
+	qglColor(Qt::white);
+	int lineHeight = fontMetrics().height();
+
+	for (int i = 0; i < lines.size(); ++i) {
+		renderText(10, 10 + lineHeight * (i + 1), lines[i]);
+	}
+
+	m_shaderProgram->bind();
+}
@@ -11,10 +11,17 @@
 #include <QPair>
 #include <QMatrix4x4>
 #include <QColor>
+#include <QImage>
+#include <QVector3D>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QString>
 
 #include <vector>
 
 class QGLShaderProgram;
+class QTimer;
+class GCMeshCache;
 
 class GCGLView : public QGLWidget
 {
@@ -22,43 +29,153 @@ class GCGLView : public QGLWidget
 	Q_DISABLE_COPY(GCGLView)
 
 public:
+	// Values match color_mode in fragment shader.
+	enum ColorMode {GlobalColor, HighlightColor, ScalarColor};
+
+	// Camera directions of rendered snapshots.
+	enum ViewDirection {TopView, FrontView, IsoView};
+
 	struct Vertex {
 		GLfloat position[3];
 		GLfloat normal[3];
+		GLfloat segment;			// Segment number within path, fractional between rings.
+		GLuint firstSegment;		// ID of the first segment of path.
+	};
+
+	// Endpoint of a move drawn as a line.
+	struct LineVertex {
+		GLfloat position[3];
+		GLuint segment;				// Segment ID, travelSegment for travel moves.
 	};
 
+	// Thread mesh of a single layer.
+	struct Mesh {
+		std::vector<Vertex> vertices;
+		std::vector<GLuint> indices;
+		std::vector<GLuint> coarseIndices;	// Same vertices, fewer ring points; drawn during interaction.
+	};
+
+	// Separates triangle strips in the thread index buffer.
+	static const GLuint primitiveRestartIndex = 0xFFFFFFFF;
+	static const GLuint travelSegment = 0xFFFFFFFF;
+
 	explicit GCGLView(QWidget *parent = 0);
+	virtual ~GCGLView();
 
 	void setGridDimensions(const QRectF &dimensions);
 	const QRectF &gridDimensions() const;
 
 	void resetView();
 	void hideUpperLayers(int hide);
-	void bufferGCData(const std::vector<Vertex> &vertices, const std::vector<GLuint> &indices);
-	void changeColorRanges(const std::vector<QPair<size_t, QColor> > &colorRanges);
+	void showTravelMoves(bool show);
+	void setOverview(bool overview);
+	void setMemoryBudget(size_t bytes);
+	size_t memoryBudget() const;
+	void bufferGCData(const std::vector<LineVertex> &lineVertices, const std::vector<size_t> &layerLinesEnd);
+	// Lines of layers changed, their meshes and view settings stay.
+	void bufferLines(const std::vector<LineVertex> &lineVertices, const std::vector<size_t> &layerLinesEnd);
+	void bufferLayer(size_t layer, const Mesh &mesh);
+	bool isLayerCached(size_t layer) const;
+	void setHighlightColors(const QColor &object, const QColor &layer, const QColor &path, const QColor &command);
+	void setTravelColor(const QColor &travel);
+	void changeHighlight(const QPair<GLuint, GLuint> &layerSegments, const QPair<GLuint, GLuint> &pathSegments,
+						 const QPair<GLuint, GLuint> &commandSegments, size_t upperLayersStart);
+	void setVisibleRange(size_t firstLayer, size_t endLayer, GLfloat zMin, GLfloat zMax);
+	// Segments from printedEnd on are faded and the last printed one highlighted, travelSegment shows all as printed.
+	void setPrintProgress(GLuint printedEnd);
+	void setColorMode(ColorMode colorMode);
+	// Scalars of segments from firstSegment on, other segments take min.
+	void setSegmentScalars(const std::vector<GLfloat> &scalars, GLuint firstSegment, GLfloat min, GLfloat max);
+	int pickSegment(const QPoint &pos);
+	void showStatistics(bool show);
+	// Host memory of other parts of viewer, listed in statistics overlay.
+	void setMemoryCounter(const QString &name, qint64 bytes);
+	// Box is fitted into offscreen image, widget camera doesn't change.
+	// Image is painted a few layers at a time, so its meshes needn't fit in GPU memory together.
+	bool beginImage(const QSize &size, ViewDirection direction, const QVector3D &minCorner, const QVector3D &maxCorner);
+	void paintImageLayers(size_t firstLayer, size_t endLayer);
+	QImage endImage();
+
+signals:
+	void segmentPicked(int segment);
+	// Layer mesh is needed, it is expected to be passed to bufferLayer().
+	void layerRequested(int layer);
+
+private slots:
+	void refine();
+	void streamLayers();
 
 protected:
 	virtual void initializeGL();
 	virtual void paintGL();
 	virtual void resizeGL(int w, int h);
 	virtual void mousePressEvent(QMouseEvent *event);
+	virtual void mouseReleaseEvent(QMouseEvent *event);
 	virtual void mouseMoveEvent(QMouseEvent *event);
 	virtual void wheelEvent(QWheelEvent *event);
 
 private:
+	// GPU work timed separately in statistics overlay.
+	enum TimedPass {PrintBedPass, ModelPass, numTimedPasses};
+
+	struct FrameStats {
+		FrameStats()
+			: drawCalls(0), triangles(0), lines(0) {}
+
+		unsigned drawCalls;
+		quint64 triangles;
+		quint64 lines;
+	};
+
+	// Widget camera, kept aside while image is painted.
+	struct Camera {
+		Camera()
+			: viewMatrix(), zoom(1), aspectRatio(1), nearPlane(0), farPlane(0) {}
+
+		QMatrix4x4 viewMatrix;
+		qreal zoom;
+		qreal aspectRatio;
+		qreal nearPlane;
+		qreal farPlane;
+	};
+
 	void createPrintBed();
 
 	void paintPrintBed();
-	void paintThreads();
-
+	void paintModel(bool coarse, std::vector<size_t> &missingLayers);
+	void paintThreads(bool coarse, std::vector<size_t> &missingLayers);
+	void bindThreadAttributes(QGLShaderProgram *program, GLuint verticesVBO);
+	void releaseThreadAttributes(QGLShaderProgram *program);
+	void drawThreads(QGLShaderProgram *program, bool coarse, std::vector<size_t> &missingLayers);
+	void paintLines(const std::vector<size_t> &layers, bool extrusions, bool travels);
+	void bindLineAttributes(QGLShaderProgram *program);
+	void drawLines(const std::vector<size_t> &layers);
+	void setHighlightUniforms(QGLShaderProgram *program);
+	size_t visibleLayersEnd() const;
+	std::vector<size_t> visibleLayers() const;
+
+	void makeContextCurrent();
+	void interact();
+	void updateProjectionMatrix();
 	void updateZPlanes();
+	void fitView(ViewDirection direction, const QVector3D &minCorner, const QVector3D &maxCorner);
 
 	void initializeShaders();
+	static void bindAttributeLocations(QGLShaderProgram *program);
+	void createTransferFunction();
+
+	void beginTimedPass(TimedPass pass);
+	void endTimedPass();
+	void readTimerQueries();
+	void paintStatistics();
+
+	bool m_initialized;					// GL resources exist, widget needn't have been shown.
 
 	QRectF m_bedGrid;
 	QRectF m_bedPlane;
 
 	QPoint m_lastPos;
+	QPoint m_pressPos;
 
 	qreal m_nearPlane;
 	qreal m_farPlane;
@@ -70,17 +187,62 @@ private:
 	QMatrix4x4 m_viewMatrix;
 
 	bool m_hideUpperLayers;
+	bool m_showTravelMoves;
+	bool m_overview;					// Extrusions drawn as lines instead of tubes.
 
 	QGLShaderProgram *m_shaderProgram;
+	QGLShaderProgram *m_pickProgram;
+	QGLShaderProgram *m_lineProgram;
 
 	GLuint m_printBedVBO;
-	GLuint m_threadVerticesVBO;
-	GLuint m_threadIndicesVBO;
-
-	size_t m_indicesSize;
+	GLuint m_lineVerticesVBO;
+	GLuint m_segmentScalarsTexture;
+	GLuint m_transferFunctionTexture;
+
+	GLuint m_pickFBO;
+	GLuint m_pickColorRB;
+	GLuint m_pickDepthRB;
+	QSize m_pickBufferSize;
+
+	GCMeshCache *m_meshCache;
+	std::vector<size_t> m_layerLinesEnd;	// Lines of each layer follow lines of the previous one.
+	std::vector<size_t> m_pendingLayers;	// Visible layers without resident mesh, drawn as lines.
+	QTimer *m_streamTimer;
 	QPair<size_t, size_t> m_thinLinessRange;
 	QPair<size_t, size_t> m_thickLinesRange;
-	std::vector<QPair<size_t, QColor> > m_colorRanges;
+
+	ColorMode m_colorMode;
+	QColor m_highlightColors[4];		// Object, layer, path and command.
+	QColor m_travelColor;
+	QPair<GLuint, GLuint> m_highlightRanges[3];	// Layer, path and command segments.
+	size_t m_upperLayersStart;
+	GLuint m_printedEnd;
+	QPair<size_t, size_t> m_visibleLayers;
+	QPair<GLfloat, GLfloat> m_clipZ;
+	QPair<GLfloat, GLfloat> m_scalarsRange;
+	QPair<GLuint, GLuint> m_scalarSegments;		// Segments held by scalar texture, first and end.
+
+	bool m_interacting;					// Camera is moving, quality may drop.
+	QTimer *m_refineTimer;
+	QElapsedTimer m_frameTimer;
+	qint64 m_fullFrameTime;				// ms, last full quality frame; GPU time when queries are supported.
+
+	bool m_showStatistics;
+	bool m_timerQueriesSupported;
+	GLuint m_timerQueries[2][numTimedPasses];	// Used by every other frame, results are read without waiting for GPU.
+	bool m_timerQueriesIssued[2];
+	bool m_timedFullFrame[2];			// Full quality frame time is taken from its queries.
+	unsigned m_frameNumber;
+	FrameStats m_frameStats;			// Counted while frame is drawn.
+	FrameStats m_lastFrameStats;
+	QElapsedTimer m_cpuTimer;
+	double m_cpuFrameTime;				// ms, smoothed.
+	double m_gpuPassTime[numTimedPasses];	// ms, smoothed.
+	size_t m_lineBytes;
+	QMap<QString, qint64> m_memoryCounters;
+
+	QGLFramebufferObject *m_imageFBO;	// Image between beginImage() and endImage().
+	Camera m_widgetCamera;
 };
 
 #endif // GCGLVIEW_H
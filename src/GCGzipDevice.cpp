@@ -0,0 +1,272 @@
+#include "GCGzipDevice.h"
+#include "GCTrace.h"
+
+#include <QFile>
+#include <QScopedPointer>
+#include <QThread>
+
+#include <cstring>
+#include <zlib.h>
+
+// 16 blocks of 256 KiB keep decompressor at most 4 MiB ahead of parser.
+const int blockSize = 256 * 1024;
+const int maxBlocks = 16;
+
+class GCGzipDevice::Inflater : public QThread
+{
+public:
+	explicit Inflater(GCGzipDevice *device)
+		: QThread(),
+		  m_device(device)
+	{
+	}
+
+protected:
+	virtual void run()
+	{
+		GC_TRACE_SCOPE("inflate");
+
+		gzFile file = gzopen(QFile::encodeName(m_device->m_fileName).constData(), "rb");
+
+		if (!file) {
+			m_device->finish(GCGzipDevice::tr("Unable to open %1.").arg(m_device->m_fileName));
+			return;
+		}
+
+		QString error;
+
+		for (;;) {
+			QByteArray block;
+			block.resize(blockSize);
+
+			int size = gzread(file, block.data(), blockSize);
+
+			// Truncated stream ends like a whole one, only gzerror() tells them apart.
+			if (size <= 0) {
+				int errorNumber = Z_OK;
+				const char *message = gzerror(file, &errorNumber);
+
+				if (size < 0 || errorNumber != Z_OK) {
+					error = QString::fromLocal8Bit(message);
+				}
+
+				break;
+			}
+
+			block.resize(size);
+			GC_TRACE_COUNTER("bytes inflated", gzoffset(file));
+
+			if (!m_device->pushBlock(block)) {
+				// Device closed before end of file.
+				break;
+			}
+		}
+
+		gzclose(file);
+		m_device->finish(error);
+	}
+
+private:
+	GCGzipDevice *m_device;
+};
+
+GCGzipDevice::GCGzipDevice(const QString &fileName, QObject *parent)
+	: QIODevice(parent),
+	  m_fileName(fileName),
+	  m_inflater(0),
+	  m_mutex(),
+	  m_blockReady(),
+	  m_spaceReady(),
+	  m_blocks(),
+	  m_blockOffset(0),
+	  m_queuedBytes(0),
+	  m_finished(false),
+	  m_error(),
+	  m_closing(false)
+{
+	m_inflater = new Inflater(this);
+	m_inflater->setObjectName("Inflater");
+}
+
+GCGzipDevice::~GCGzipDevice()
+{
+	close();
+	delete m_inflater;
+}
+
+bool GCGzipDevice::isGzip(const QString &fileName)
+{
+	QFile file(fileName);
+
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+
+	QByteArray magic = file.read(2);
+
+	return magic.size() == 2 && static_cast<unsigned char>(magic[0]) == 0x1f
+			&& static_cast<unsigned char>(magic[1]) == 0x8b;
+}
+
+QIODevice *GCGzipDevice::openGCode(const QString &fileName)
+{
+	QScopedPointer<QIODevice> gcFile;
+
+	if (isGzip(fileName)) {
+		gcFile.reset(new GCGzipDevice(fileName));
+	} else {
+		gcFile.reset(new QFile(fileName));
+	}
+
+	if (!gcFile->open(QIODevice::ReadOnly | QIODevice::Text)) {
+		return 0;
+	}
+
+	return gcFile.take();
+}
+
+bool GCGzipDevice::open(QIODevice::OpenMode mode)
+{
+	if (isOpen() || (mode & QIODevice::WriteOnly) || !QFile::exists(m_fileName)) {
+		return false;
+	}
+
+	m_blocks.clear();
+	m_blockOffset = 0;
+	m_queuedBytes = 0;
+	m_finished = false;
+	m_error.clear();
+	m_closing = false;
+
+	m_inflater->start();
+
+	return QIODevice::open(mode);
+}
+
+void GCGzipDevice::close()
+{
+	if (!isOpen()) {
+		return;
+	}
+
+	m_mutex.lock();
+	m_closing = true;
+	m_spaceReady.wakeAll();
+	m_mutex.unlock();
+
+	m_inflater->wait();
+
+	m_blocks.clear();
+	m_queuedBytes = 0;
+
+	QIODevice::close();
+}
+
+bool GCGzipDevice::isSequential() const
+{
+	return true;
+}
+
+bool GCGzipDevice::atEnd() const
+{
+	// Without data in queue end is known only once decompression finishes.
+	bool empty = !waitForBlock();
+
+	return empty && QIODevice::atEnd();
+}
+
+qint64 GCGzipDevice::bytesAvailable() const
+{
+	QMutexLocker locker(&m_mutex);
+	qint64 queued = m_queuedBytes;
+	locker.unlock();
+
+	return queued + QIODevice::bytesAvailable();
+}
+
+qint64 GCGzipDevice::readData(char *data, qint64 maxSize)
+{
+	if (!waitForBlock()) {
+		QMutexLocker locker(&m_mutex);
+
+		if (m_error.isEmpty()) {
+			return 0;
+		}
+
+		setErrorString(m_error);
+		return -1;
+	}
+
+	QMutexLocker locker(&m_mutex);
+	qint64 read = 0;
+
+	while (read < maxSize && !m_blocks.isEmpty()) {
+		const QByteArray &block = m_blocks.head();
+		qint64 size = qMin(maxSize - read, static_cast<qint64>(block.size() - m_blockOffset));
+
+		std::memcpy(data + read, block.constData() + m_blockOffset, size);
+		read += size;
+		m_blockOffset += static_cast<int>(size);
+
+		if (m_blockOffset == block.size()) {
+			m_blocks.dequeue();
+			m_blockOffset = 0;
+			m_spaceReady.wakeAll();
+		}
+	}
+
+	m_queuedBytes -= read;
+
+	return read;
+}
+
+qint64 GCGzipDevice::writeData(const char *, qint64)
+{
+	return -1;
+}
+
+bool GCGzipDevice::pushBlock(const QByteArray &block)
+{
+	QMutexLocker locker(&m_mutex);
+
+	while (m_blocks.size() >= maxBlocks && !m_closing) {
+		m_spaceReady.wait(&m_mutex);
+	}
+
+	if (m_closing) {
+		return false;
+	}
+
+	m_blocks.enqueue(block);
+	m_queuedBytes += block.size();
+	m_blockReady.wakeAll();
+
+	return true;
+}
+
+QString GCGzipDevice::inflateError() const
+{
+	QMutexLocker locker(&m_mutex);
+
+	return m_error;
+}
+
+void GCGzipDevice::finish(const QString &error)
+{
+	QMutexLocker locker(&m_mutex);
+
+	m_finished = true;
+	m_error = error;
+	m_blockReady.wakeAll();
+}
+
+bool GCGzipDevice::waitForBlock() const
+{
+	QMutexLocker locker(&m_mutex);
+
+	while (m_blocks.isEmpty() && !m_finished) {
+		m_blockReady.wait(&m_mutex);
+	}
+
+	return !m_blocks.isEmpty();
+}
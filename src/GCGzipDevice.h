@@ -0,0 +1,59 @@
+#ifndef GCGZIPDEVICE_H
+#define GCGZIPDEVICE_H
+
+#include <QIODevice>
+#include <QMutex>
+#include <QQueue>
+#include <QWaitCondition>
+
+// Read-only sequential device decompressing gzip file on its own thread.
+// Decompressed blocks are passed to reader through bounded queue, so parsing runs alongside decompression
+// and only few blocks are held in memory.
+class GCGzipDevice : public QIODevice
+{
+	Q_DISABLE_COPY(GCGzipDevice)
+
+public:
+	explicit GCGzipDevice(const QString &fileName, QObject *parent = 0);
+	~GCGzipDevice();
+
+	static bool isGzip(const QString &fileName);
+	// Plain or compressed G-code opened for reading, recognized by content. Null when it can't be opened.
+	static QIODevice *openGCode(const QString &fileName);
+
+	virtual bool open(OpenMode mode);
+	virtual void close();
+	virtual bool isSequential() const;
+	virtual bool atEnd() const;
+	virtual qint64 bytesAvailable() const;
+	// Message of failed decompression, e.g. of truncated file. Empty while the stream reads fine.
+	QString inflateError() const;
+
+protected:
+	virtual qint64 readData(char *data, qint64 maxSize);
+	virtual qint64 writeData(const char *data, qint64 maxSize);
+
+private:
+	class Inflater;
+	friend class Inflater;
+
+	bool pushBlock(const QByteArray &block);
+	void finish(const QString &error);
+	bool waitForBlock() const;
+
+	QString m_fileName;
+	Inflater *m_inflater;
+
+	mutable QMutex m_mutex;
+	mutable QWaitCondition m_blockReady;
+	QWaitCondition m_spaceReady;
+
+	QQueue<QByteArray> m_blocks;
+	int m_blockOffset;					// Bytes of first block already read.
+	qint64 m_queuedBytes;
+	bool m_finished;
+	QString m_error;					// Reads past the data fail with it, empty for clean end.
+	bool m_closing;
+};
+
+#endif // GCGZIPDEVICE_H
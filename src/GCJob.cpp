@@ -0,0 +1,101 @@
+#include "GCJob.h"
+#include "GCJobScheduler.h"
+
+GCJob::GCJob(QObject *parent)
+	: QObject(parent),
+	  m_scheduler(0),
+	  m_priority(Visible),
+	  m_queuedTimer(),
+	  m_canceled(0),
+	  m_started(0),
+	  m_progress(0),
+	  m_mutex(),
+	  m_finishedCondition(),
+	  m_finished(false)
+{
+}
+
+GCJob::~GCJob()
+{
+}
+
+GCJob::Priority GCJob::priority() const
+{
+	return m_priority;
+}
+
+void GCJob::cancel()
+{
+	m_canceled = 1;
+}
+
+bool GCJob::isCanceled() const
+{
+	return m_canceled != 0;
+}
+
+bool GCJob::isStarted() const
+{
+	return m_started != 0;
+}
+
+bool GCJob::isFinished() const
+{
+	QMutexLocker locker(&m_mutex);
+
+	return m_finished;
+}
+
+int GCJob::progress() const
+{
+	return m_progress;
+}
+
+void GCJob::wait()
+{
+	if (!m_scheduler) {
+		// Never submitted.
+		return;
+	}
+
+	// Job still in queue runs on the waiting thread instead of waiting for a free worker.
+	if (m_scheduler->take(this)) {
+		execute();
+		return;
+	}
+
+	QMutexLocker locker(&m_mutex);
+
+	while (!m_finished) {
+		m_finishedCondition.wait(&m_mutex);
+	}
+}
+
+void GCJob::setProgress(int percent)
+{
+	if (m_progress.fetchAndStoreRelaxed(percent) != percent) {
+		emit progressChanged(percent);
+	}
+}
+
+void GCJob::execute()
+{
+	m_started = 1;
+	qint64 latency = m_queuedTimer.elapsed();
+
+	QElapsedTimer runTimer;
+	runTimer.start();
+
+	if (!isCanceled()) {
+		run();
+	}
+
+	m_scheduler->recordJob(m_priority, latency, runTimer.elapsed());
+
+	m_mutex.lock();
+	m_finished = true;
+	m_finishedCondition.wakeAll();
+	m_mutex.unlock();
+
+	emit finished();
+}
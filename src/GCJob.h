@@ -0,0 +1,61 @@
+#ifndef GCJOB_H
+#define GCJOB_H
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QObject>
+#include <QWaitCondition>
+
+class GCJobScheduler;
+
+// Unit of work run by GCJobScheduler. Job is its own cancellation token, run() polls isCanceled().
+// Signals are emitted from the thread running the job, connections to GUI objects should be queued.
+class GCJob : public QObject
+{
+	Q_OBJECT
+	Q_DISABLE_COPY(GCJob)
+
+public:
+	// Lower value runs first.
+	enum Priority {Visible, Prefetch, Background};
+	static const int numPriorities = 3;
+
+	explicit GCJob(QObject *parent = 0);
+	virtual ~GCJob();
+
+	Priority priority() const;
+	void cancel();
+	bool isCanceled() const;
+	bool isStarted() const;
+	bool isFinished() const;
+	int progress() const;
+	void setProgress(int percent);
+	void wait();
+
+signals:
+	void progressChanged(int percent);
+	void finished();
+
+protected:
+	virtual void run() = 0;
+
+private:
+	friend class GCJobScheduler;
+
+	void execute();
+
+	GCJobScheduler *m_scheduler;
+	Priority m_priority;
+	QElapsedTimer m_queuedTimer;
+
+	QAtomicInt m_canceled;
+	QAtomicInt m_started;
+	QAtomicInt m_progress;
+
+	mutable QMutex m_mutex;
+	QWaitCondition m_finishedCondition;
+	bool m_finished;
+};
+
+#endif // GCJOB_H
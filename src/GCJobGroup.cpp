@@ -0,0 +1,72 @@
+#include "GCJobGroup.h"
+#include "GCJobScheduler.h"
+
+GCJobGroup::GCJobGroup(QObject *parent)
+	: QObject(parent),
+	  m_jobs(),
+	  m_numFinished(0)
+{
+}
+
+GCJobGroup::~GCJobGroup()
+{
+	cancel();
+}
+
+void GCJobGroup::submit(const QSharedPointer<GCJob> &job, GCJob::Priority priority)
+{
+	connect(job.data(), SIGNAL(finished()), this, SLOT(jobFinished()), Qt::QueuedConnection);
+	m_jobs.push_back(job);
+	GCJobScheduler::globalInstance()->submit(job, priority);
+}
+
+int GCJobGroup::size() const
+{
+	return static_cast<int>(m_jobs.size());
+}
+
+GCJob *GCJobGroup::job(int n) const
+{
+	return m_jobs[n].data();
+}
+
+bool GCJobGroup::isRunning() const
+{
+	return m_numFinished < size();
+}
+
+void GCJobGroup::cancel()
+{
+	for (size_t i = 0; i < m_jobs.size(); ++i) {
+		m_jobs[i]->cancel();
+	}
+
+	for (size_t i = 0; i < m_jobs.size(); ++i) {
+		m_jobs[i]->wait();
+	}
+
+	m_jobs.clear();
+	m_numFinished = 0;
+}
+
+void GCJobGroup::jobFinished()
+{
+	// Signals of canceled jobs may still arrive, finished jobs are counted instead.
+	int numFinished = 0;
+
+	for (size_t i = 0; i < m_jobs.size(); ++i) {
+		numFinished += m_jobs[i]->isFinished() ? 1 : 0;
+	}
+
+	if (numFinished == m_numFinished) {
+		return;
+	}
+
+	m_numFinished = numFinished;
+
+	if (m_numFinished < size()) {
+		emit progressChanged(m_numFinished * 100 / size());
+	} else {
+		emit finished();
+	}
+}
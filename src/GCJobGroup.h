@@ -0,0 +1,43 @@
+#ifndef GCJOBGROUP_H
+#define GCJOBGROUP_H
+
+#include "GCJob.h"
+
+#include <QObject>
+#include <QSharedPointer>
+
+#include <vector>
+
+// Jobs of one task, e.g. a job per layer, followed together on GUI thread.
+// Jobs are kept until cancel(), their results are read once the group has finished.
+class GCJobGroup : public QObject
+{
+	Q_OBJECT
+	Q_DISABLE_COPY(GCJobGroup)
+
+public:
+	explicit GCJobGroup(QObject *parent = 0);
+	virtual ~GCJobGroup();
+
+	void submit(const QSharedPointer<GCJob> &job, GCJob::Priority priority = GCJob::Background);
+	int size() const;
+	GCJob *job(int n) const;
+	bool isRunning() const;
+
+public slots:
+	// Jobs are waited for and released.
+	void cancel();
+
+signals:
+	void progressChanged(int percent);
+	void finished();
+
+private slots:
+	void jobFinished();
+
+private:
+	std::vector<QSharedPointer<GCJob> > m_jobs;
+	int m_numFinished;
+};
+
+#endif // GCJOBGROUP_H
@@ -0,0 +1,238 @@
+#include "GCJobScheduler.h"
+
+#include <QThread>
+
+// Weight of a new sample in mean latency and run time.
+const double statsWeight = 1.0 / 16;
+
+class GCJobScheduler::Worker : public QThread
+{
+public:
+	Worker(GCJobScheduler *scheduler, size_t index)
+		: QThread(),
+		  m_scheduler(scheduler),
+		  m_index(index)
+	{
+	}
+
+protected:
+	virtual void run()
+	{
+		for (;;) {
+			QSharedPointer<GCJob> job = m_scheduler->nextJob(m_index);
+
+			if (job) {
+				m_scheduler->execute(job.data());
+				continue;
+			}
+
+			QMutexLocker locker(&m_scheduler->m_sleepMutex);
+
+			while (m_scheduler->m_pending == 0 && !m_scheduler->m_quit) {
+				m_scheduler->m_workAvailable.wait(&m_scheduler->m_sleepMutex);
+			}
+
+			if (m_scheduler->m_quit) {
+				return;
+			}
+		}
+	}
+
+private:
+	GCJobScheduler *m_scheduler;
+	size_t m_index;
+};
+
+GCJobScheduler::Stats::Stats()
+{
+	for (int priority = 0; priority < GCJob::numPriorities; ++priority) {
+		queued[priority] = 0;
+		completed[priority] = 0;
+		meanLatency[priority] = 0.0;
+		meanRunTime[priority] = 0.0;
+	}
+}
+
+GCJobScheduler::GCJobScheduler(int numWorkers)
+	: m_workers(),
+	  m_queues(),
+	  m_sleepMutex(),
+	  m_workAvailable(),
+	  m_pending(0),
+	  m_quit(false),
+	  m_statsMutex(),
+	  m_stats()
+{
+	numWorkers = qMax(numWorkers, 1);
+
+	for (int worker = 0; worker <= numWorkers; ++worker) {
+		m_queues.push_back(new Queue());
+	}
+
+	for (int worker = 0; worker < numWorkers; ++worker) {
+		m_workers.push_back(new Worker(this, static_cast<size_t>(worker)));
+		m_workers.back()->setObjectName(QString("Worker %1").arg(worker));
+		m_workers.back()->start();
+	}
+}
+
+GCJobScheduler::~GCJobScheduler()
+{
+	m_sleepMutex.lock();
+	m_quit = true;
+	m_workAvailable.wakeAll();
+	m_sleepMutex.unlock();
+
+	for (size_t worker = 0; worker < m_workers.size(); ++worker) {
+		m_workers[worker]->wait();
+		delete m_workers[worker];
+	}
+
+	for (size_t queue = 0; queue < m_queues.size(); ++queue) {
+		delete m_queues[queue];
+	}
+}
+
+GCJobScheduler *GCJobScheduler::globalInstance()
+{
+	// One core is left to GUI thread.
+	static GCJobScheduler scheduler(QThread::idealThreadCount() - 1);
+
+	return &scheduler;
+}
+
+void GCJobScheduler::submit(const QSharedPointer<GCJob> &job, GCJob::Priority priority)
+{
+	job->m_scheduler = this;
+	job->m_priority = priority;
+	job->m_queuedTimer.start();
+
+	Queue *queue = m_queues[currentQueue()];
+
+	queue->mutex.lock();
+	queue->jobs[priority].push_back(job);
+	queue->mutex.unlock();
+
+	QMutexLocker locker(&m_sleepMutex);
+	++m_pending;
+	m_workAvailable.wakeOne();
+}
+
+int GCJobScheduler::numWorkers() const
+{
+	return static_cast<int>(m_workers.size());
+}
+
+GCJobScheduler::Stats GCJobScheduler::stats() const
+{
+	m_statsMutex.lock();
+	Stats stats = m_stats;
+	m_statsMutex.unlock();
+
+	for (size_t queue = 0; queue < m_queues.size(); ++queue) {
+		QMutexLocker locker(&m_queues[queue]->mutex);
+
+		for (int priority = 0; priority < GCJob::numPriorities; ++priority) {
+			stats.queued[priority] += static_cast<int>(m_queues[queue]->jobs[priority].size());
+		}
+	}
+
+	return stats;
+}
+
+QSharedPointer<GCJob> GCJobScheduler::nextJob(size_t worker)
+{
+	for (int priority = 0; priority < GCJob::numPriorities; ++priority) {
+		// Own newest job first, its data is likely still in cache.
+		QSharedPointer<GCJob> job = pop(m_queues[worker], priority, true);
+
+		for (size_t i = 1; !job && i < m_queues.size(); ++i) {
+			job = pop(m_queues[(worker + i) % m_queues.size()], priority, false);
+		}
+
+		if (job) {
+			return job;
+		}
+	}
+
+	return QSharedPointer<GCJob>();
+}
+
+QSharedPointer<GCJob> GCJobScheduler::pop(Queue *queue, int priority, bool newest)
+{
+	QSharedPointer<GCJob> job;
+
+	queue->mutex.lock();
+
+	std::deque<QSharedPointer<GCJob> > &jobs = queue->jobs[priority];
+
+	if (!jobs.empty()) {
+		if (newest) {
+			job = jobs.back();
+			jobs.pop_back();
+		} else {
+			job = jobs.front();
+			jobs.pop_front();
+		}
+	}
+
+	queue->mutex.unlock();
+
+	if (job) {
+		QMutexLocker locker(&m_sleepMutex);
+		--m_pending;
+	}
+
+	return job;
+}
+
+void GCJobScheduler::execute(GCJob *job)
+{
+	job->execute();
+}
+
+bool GCJobScheduler::take(GCJob *job)
+{
+	for (size_t queue = 0; queue < m_queues.size(); ++queue) {
+		QMutexLocker locker(&m_queues[queue]->mutex);
+		std::deque<QSharedPointer<GCJob> > &jobs = m_queues[queue]->jobs[job->m_priority];
+
+		for (std::deque<QSharedPointer<GCJob> >::iterator it = jobs.begin(); it != jobs.end(); ++it) {
+			if (it->data() == job) {
+				jobs.erase(it);
+				locker.unlock();
+
+				QMutexLocker sleepLocker(&m_sleepMutex);
+				--m_pending;
+
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+void GCJobScheduler::recordJob(GCJob::Priority priority, qint64 latency, qint64 runTime)
+{
+	QMutexLocker locker(&m_statsMutex);
+
+	double weight = m_stats.completed[priority] == 0 ? 1.0 : statsWeight;
+
+	m_stats.meanLatency[priority] += (latency - m_stats.meanLatency[priority]) * weight;
+	m_stats.meanRunTime[priority] += (runTime - m_stats.meanRunTime[priority]) * weight;
+	++m_stats.completed[priority];
+}
+
+size_t GCJobScheduler::currentQueue() const
+{
+	QThread *thread = QThread::currentThread();
+
+	for (size_t worker = 0; worker < m_workers.size(); ++worker) {
+		if (m_workers[worker] == thread) {
+			return worker;
+		}
+	}
+
+	return m_workers.size();
+}
@@ -0,0 +1,68 @@
+#ifndef GCJOBSCHEDULER_H
+#define GCJOBSCHEDULER_H
+
+#include "GCJob.h"
+
+#include <QMutex>
+#include <QSharedPointer>
+#include <QWaitCondition>
+
+#include <deque>
+#include <vector>
+
+// Thread pool running jobs by priority. Every worker has own queues, jobs submitted by a job stay
+// with its worker, idle workers steal oldest jobs of others. Higher priority is always taken first,
+// stolen or not.
+class GCJobScheduler
+{
+	Q_DISABLE_COPY(GCJobScheduler)
+
+public:
+	struct Stats {
+		Stats();
+
+		int queued[GCJob::numPriorities];
+		quint64 completed[GCJob::numPriorities];
+		double meanLatency[GCJob::numPriorities];	// ms from submission to start, recent jobs weigh more.
+		double meanRunTime[GCJob::numPriorities];	// ms.
+	};
+
+	explicit GCJobScheduler(int numWorkers);
+	~GCJobScheduler();
+
+	static GCJobScheduler *globalInstance();
+
+	void submit(const QSharedPointer<GCJob> &job, GCJob::Priority priority);
+	int numWorkers() const;
+	Stats stats() const;
+
+private:
+	class Worker;
+	friend class Worker;
+	friend class GCJob;
+
+	struct Queue {
+		QMutex mutex;
+		std::deque<QSharedPointer<GCJob> > jobs[GCJob::numPriorities];
+	};
+
+	QSharedPointer<GCJob> nextJob(size_t worker);
+	QSharedPointer<GCJob> pop(Queue *queue, int priority, bool newest);
+	void execute(GCJob *job);
+	bool take(GCJob *job);
+	void recordJob(GCJob::Priority priority, qint64 latency, qint64 runTime);
+	size_t currentQueue() const;
+
+	std::vector<Worker *> m_workers;
+	std::vector<Queue *> m_queues;		// One per worker and last one for jobs submitted by other threads.
+
+	QMutex m_sleepMutex;
+	QWaitCondition m_workAvailable;
+	int m_pending;						// Queued jobs, guarded by m_sleepMutex.
+	bool m_quit;
+
+	mutable QMutex m_statsMutex;
+	Stats m_stats;
+};
+
+#endif // GCJOBSCHEDULER_H
@@ -0,0 +1,216 @@
+#include "GCLayerExporter.h"
+
+#include "GCModel.h"
+#include "GCJobGroup.h"
+#include "GCPathSimplifier.h"
+#include "GCTreeWalker.h"
+#include "GCThreadItem.h"
+#include "GCArcItem.h"
+#include "GCTrace.h"
+#include "GCColors.h"
+#include "GCTree/GCCommand.h"
+#include "GCTree/GCArcCommand.h"
+
+#include <QtSvg/QSvgGenerator>
+#include <QFileInfo>
+#include <QDir>
+#include <QImage>
+#include <QPainter>
+
+// Paints the walked tree item like 2D view draws it colored by layer.
+class GCLayerPainter : public GCTreeWalker
+{
+public:
+	explicit GCLayerPainter(QPainter &painter)
+		: GCTreeWalker(),
+		  m_painter(painter),
+		  m_simplifier()
+	{
+	}
+
+protected:
+	virtual void visitRun(const std::vector<const GCCommand *> &commands, const std::vector<int> &rows)
+	{
+		Q_UNUSED(rows);
+
+		std::vector<GCPathSimplifier::Thread> threads;
+		m_simplifier.simplify(commands, threads);
+
+		for (size_t threadNo = 0; threadNo < threads.size(); ++threadNo) {
+			m_painter.setPen(GCThreadItem::threadPen(threads[threadNo].width, layerColor));
+			m_painter.drawLine(threads[threadNo].line);
+		}
+	}
+
+	virtual void visitCommand(const GCCommand *gcCommand, int row)
+	{
+		Q_UNUSED(row);
+
+		if (!gcCommand->isMove()) {
+			return;
+		}
+
+		m_painter.setPen(GCThreadItem::threadPen(gcCommand->threadWidth, layerColor));
+
+		if (gcCommand->isArc()) {
+			m_painter.drawPath(GCArcItem::arcPath(*static_cast<const GCArcCommand *>(gcCommand)));
+		} else {
+			m_painter.drawLine(gcCommand->thread);
+		}
+	}
+
+private:
+	QPainter &m_painter;
+	GCPathSimplifier m_simplifier;
+};
+
+// Reads one layer, paints it and writes it, layer and image are released as soon as it is written.
+class GCLayerExportJob : public GCJob
+{
+public:
+	GCLayerExportJob(const GCModel *model, int layer, const QString &fileName, const QRectF &area, double pixelsPerMm)
+		: GCJob(),
+		  written(false),
+		  m_model(model),
+		  m_layer(layer),
+		  m_fileName(fileName),
+		  m_area(area),
+		  m_pixelsPerMm(pixelsPerMm)
+	{
+	}
+
+	bool written;
+
+protected:
+	virtual void run()
+	{
+		GC_TRACE_SCOPE("export layer");
+
+		QScopedPointer<GCLayer> copy;
+		const GCTreeItem *layer = m_model->readLayer(m_layer, copy);
+
+		if (!layer || isCanceled()) {
+			return;
+		}
+
+		QSize size(qMax(1, qRound(m_area.width() * m_pixelsPerMm)), qMax(1, qRound(m_area.height() * m_pixelsPerMm)));
+
+		if (QFileInfo(m_fileName).suffix().compare("svg", Qt::CaseInsensitive) == 0) {
+			QSvgGenerator generator;
+			generator.setFileName(m_fileName);
+			generator.setSize(size);
+			generator.setViewBox(QRect(QPoint(0, 0), size));
+
+			QPainter painter(&generator);
+			paint(painter, size, layer);
+			written = painter.end();
+		} else {
+			QImage image(size, QImage::Format_RGB32);
+
+			QPainter painter(&image);
+			paint(painter, size, layer);
+			painter.end();
+
+			written = !isCanceled() && image.save(m_fileName, "PNG");
+		}
+	}
+
+private:
+	void paint(QPainter &painter, const QSize &size, const GCTreeItem *layer)
+	{
+		if (!painter.isActive()) {
+			return;
+		}
+
+		painter.fillRect(QRect(QPoint(0, 0), size), Qt::white);
+		painter.setRenderHint(QPainter::Antialiasing);
+
+		// Y axis points up like in 2D view.
+		painter.translate(0, size.height());
+		painter.scale(m_pixelsPerMm, -m_pixelsPerMm);
+		painter.translate(-m_area.left(), -m_area.top());
+
+		GCLayerExporter::paintLayer(painter, layer);
+	}
+
+	const GCModel *m_model;
+	int m_layer;
+	QString m_fileName;
+	QRectF m_area;
+	double m_pixelsPerMm;
+};
+
+GCLayerExporter::GCLayerExporter(GCModel *model, QObject *parent)
+	: QObject(parent),
+	  m_model(model),
+	  m_jobs(0)
+{
+	m_jobs = new GCJobGroup(this);
+	connect(m_jobs, SIGNAL(progressChanged(int)), this, SIGNAL(progressChanged(int)));
+	connect(m_jobs, SIGNAL(finished()), this, SLOT(jobsFinished()));
+
+	// Jobs read the tree, it must not change under them.
+	connect(m_model, SIGNAL(modelAboutToBeReset()), this, SLOT(cancel()));
+}
+
+GCLayerExporter::~GCLayerExporter()
+{
+	cancel();
+}
+
+void GCLayerExporter::start(const QString &fileName, int firstLayer, int lastLayer, const QRectF &area, double pixelsPerMm)
+{
+	cancel();
+
+	firstLayer = qMax(firstLayer, 0);
+	lastLayer = qMin(lastLayer, m_model->rowCount() - 1);
+
+	// Jobs read their own layers, loaded layers of model aren't touched.
+	for (int layer = firstLayer; layer <= lastLayer; ++layer) {
+		m_jobs->submit(QSharedPointer<GCJob>(new GCLayerExportJob(m_model, layer, layerFileName(fileName, layer), area, pixelsPerMm)));
+	}
+
+	if (!m_jobs->size()) {
+		emit finished(0, 0);
+	}
+}
+
+void GCLayerExporter::cancel()
+{
+	m_jobs->cancel();
+}
+
+bool GCLayerExporter::isRunning() const
+{
+	return m_jobs->isRunning();
+}
+
+QString GCLayerExporter::layerFileName(const QString &fileName, int layer)
+{
+	QFileInfo fileInfo(fileName);
+	QString suffix = fileInfo.suffix().isEmpty() ? QString("png") : fileInfo.suffix();
+	QString layerName = QString("%1_%2.%3").arg(fileInfo.completeBaseName()).arg(layer + 1, 4, 10, QChar('0')).arg(suffix);
+
+	return fileInfo.dir().filePath(layerName);
+}
+
+void GCLayerExporter::paintLayer(QPainter &painter, const GCTreeItem *layer)
+{
+	GCLayerPainter layerPainter(painter);
+
+	layerPainter.walk(layer);
+}
+
+void GCLayerExporter::jobsFinished()
+{
+	int numFailed = 0;
+
+	for (int i = 0; i < m_jobs->size(); ++i) {
+		numFailed += static_cast<GCLayerExportJob *>(m_jobs->job(i))->written ? 0 : 1;
+	}
+
+	int numWritten = m_jobs->size() - numFailed;
+
+	cancel();
+	emit finished(numWritten, numFailed);
+}
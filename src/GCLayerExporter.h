@@ -0,0 +1,47 @@
+#ifndef GCLAYEREXPORTER_H
+#define GCLAYEREXPORTER_H
+
+#include <QObject>
+#include <QRectF>
+#include <QString>
+
+class GCModel;
+class GCTreeItem;
+class GCJobGroup;
+class QPainter;
+
+// Writes images of model layers drawn like in 2D view, PNG or SVG by suffix of file name.
+// Every layer is read, painted and written by its own job, only layers and images being painted are held in memory.
+class GCLayerExporter : public QObject
+{
+	Q_OBJECT
+	Q_DISABLE_COPY(GCLayerExporter)
+
+public:
+	explicit GCLayerExporter(GCModel *model, QObject *parent = 0);
+	virtual ~GCLayerExporter();
+
+	// Layers are numbered from 1 in file names, fileName "layer.png" gives "layer_0001.png".
+	void start(const QString &fileName, int firstLayer, int lastLayer, const QRectF &area, double pixelsPerMm);
+	bool isRunning() const;
+
+	static QString layerFileName(const QString &fileName, int layer);
+	// Painter is expected to be set up in millimetres.
+	static void paintLayer(QPainter &painter, const GCTreeItem *layer);
+
+public slots:
+	void cancel();
+
+signals:
+	void progressChanged(int percent);
+	void finished(int numWritten, int numFailed);
+
+private slots:
+	void jobsFinished();
+
+private:
+	GCModel *m_model;
+	GCJobGroup *m_jobs;
+};
+
+#endif // GCLAYEREXPORTER_H
@@ -0,0 +1,209 @@
+#include "GCLayerExtractor.h"
+
+#include "GCModel.h"
+#include "GCJobScheduler.h"
+#include "GCTrace.h"
+
+#include <QFile>
+#include <QFileInfo>
+
+#include <vector>
+
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif // Q_OS_LINUX
+
+// Bytes copied between checks of cancellation and progress.
+const qint64 extractBlockSize = 64 * 1024 * 1024;
+
+class GCLayerExtractJob : public GCJob
+{
+public:
+	GCLayerExtractJob(const QString &fileName, const QString &sourceName, const char *data, qint64 begin, qint64 end,
+					  const QByteArray &preamble)
+		: GCJob(),
+		  bytesWritten(0),
+		  error(),
+		  m_fileName(fileName),
+		  m_sourceName(sourceName),
+		  m_data(data),
+		  m_begin(begin),
+		  m_end(end),
+		  m_preamble(preamble)
+	{
+	}
+
+	qint64 bytesWritten;
+	QString error;
+
+protected:
+	virtual void run()
+	{
+		GC_TRACE_SCOPE("extract layers");
+
+		// Truncating the mapped source would pull data from under the copy. File not created yet has no canonical path.
+		QString canonicalName = QFileInfo(m_fileName).canonicalFilePath();
+
+		if (!canonicalName.isEmpty() && canonicalName == QFileInfo(m_sourceName).canonicalFilePath()) {
+			error = GCLayerExtractor::tr("Layers can't be extracted into the file they are read from.");
+			return;
+		}
+
+		QFile file(m_fileName);
+
+		if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered)) {
+			error = file.errorString();
+			return;
+		}
+
+		if (file.write(m_preamble) != m_preamble.size()) {
+			fail(file);
+			return;
+		}
+
+		bytesWritten = m_preamble.size();
+		qint64 offset = copyRange(file, m_begin);
+
+		// Rest is written from mapped file, also when kernel copy is not supported. Copies moved only the
+		// descriptor, QFile is told the position.
+		if (!file.seek(bytesWritten)) {
+			fail(file);
+			return;
+		}
+
+		while (offset < m_end && !isCanceled()) {
+			qint64 written = file.write(m_data + offset, qMin(extractBlockSize, m_end - offset));
+
+			if (written <= 0) {
+				fail(file);
+				return;
+			}
+
+			offset += written;
+			bytesWritten += written;
+			setProgress(static_cast<int>((offset - m_begin) * 100 / (m_end - m_begin)));
+		}
+
+		if (isCanceled()) {
+			file.remove();
+		}
+	}
+
+private:
+	// Returns offset in source file where copying stopped.
+	qint64 copyRange(QFile &file, qint64 offset)
+	{
+#if defined(Q_OS_LINUX) && defined(SYS_copy_file_range)
+		QFile source(m_sourceName);
+
+		if (!source.open(QIODevice::ReadOnly)) {
+			return offset;
+		}
+
+		loff_t sourceOffset = offset;
+
+		while (sourceOffset < m_end && !isCanceled()) {
+			size_t length = static_cast<size_t>(qMin(extractBlockSize, m_end - sourceOffset));
+			long copied = syscall(SYS_copy_file_range, source.handle(), &sourceOffset, file.handle(), 0, length, 0);
+
+			// Older kernels and some file systems can't copy, or the source ended early.
+			if (copied <= 0) {
+				break;
+			}
+
+			bytesWritten += copied;
+			setProgress(static_cast<int>((sourceOffset - m_begin) * 100 / (m_end - m_begin)));
+		}
+
+		return sourceOffset;
+#else
+		Q_UNUSED(file)
+
+		return offset;
+#endif // Q_OS_LINUX && SYS_copy_file_range
+	}
+
+	void fail(QFile &file)
+	{
+		error = file.errorString();
+		file.remove();
+	}
+
+	QString m_fileName;
+	QString m_sourceName;
+	const char *m_data;
+	qint64 m_begin;
+	qint64 m_end;
+	QByteArray m_preamble;
+};
+
+GCLayerExtractor::GCLayerExtractor(GCModel *model, QObject *parent)
+	: QObject(parent),
+	  m_model(model),
+	  m_job()
+{
+	// Job reads mapped file, it must not be unmapped under it.
+	connect(m_model, SIGNAL(modelAboutToBeReset()), this, SLOT(cancel()));
+}
+
+GCLayerExtractor::~GCLayerExtractor()
+{
+	cancel();
+}
+
+QString GCLayerExtractor::start(const QString &fileName, int firstLayer, int lastLayer, const QByteArray &preamble)
+{
+	cancel();
+
+	// Compressed files have no source bytes to copy.
+	if (!m_model->mappedData()) {
+		return tr("Layers can be extracted from uncompressed files only.");
+	}
+
+	std::vector<qint64> offsets = m_model->layerOffsets();
+
+	if (firstLayer < 0 || lastLayer < firstLayer || static_cast<size_t>(lastLayer) >= offsets.size()) {
+		return tr("Invalid layer range.");
+	}
+
+	qint64 begin = offsets[firstLayer];
+	qint64 end = static_cast<size_t>(lastLayer) + 1 < offsets.size() ? offsets[lastLayer + 1] : m_model->mappedSize();
+
+	m_job = QSharedPointer<GCLayerExtractJob>(new GCLayerExtractJob(fileName, m_model->mappedFileName(),
+																	 m_model->mappedData(), begin, end,
+																	 preamble + m_model->layerPreamble(firstLayer)));
+	connect(m_job.data(), SIGNAL(progressChanged(int)), this, SIGNAL(progressChanged(int)));
+	connect(m_job.data(), SIGNAL(finished()), this, SLOT(jobFinished()), Qt::QueuedConnection);
+	GCJobScheduler::globalInstance()->submit(m_job, GCJob::Background);
+
+	return QString();
+}
+
+bool GCLayerExtractor::isRunning() const
+{
+	return !m_job.isNull();
+}
+
+void GCLayerExtractor::cancel()
+{
+	if (m_job) {
+		m_job->cancel();
+		m_job->wait();
+		m_job.clear();
+	}
+}
+
+void GCLayerExtractor::jobFinished()
+{
+	// Signal of canceled job may still arrive.
+	if (!m_job || !m_job->isFinished()) {
+		return;
+	}
+
+	QSharedPointer<GCLayerExtractJob> job = m_job;
+	m_job.clear();
+
+	emit finished(job->bytesWritten, job->error);
+}
@@ -0,0 +1,44 @@
+#ifndef GCLAYEREXTRACTOR_H
+#define GCLAYEREXTRACTOR_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+
+class GCModel;
+class GCLayerExtractJob;
+
+// Writes a range of layers into a new G-code file, preamble first and then source bytes of the layers unchanged.
+// Bytes are copied by the kernel where possible, otherwise written from mapped file in large blocks.
+class GCLayerExtractor : public QObject
+{
+	Q_OBJECT
+	Q_DISABLE_COPY(GCLayerExtractor)
+
+public:
+	explicit GCLayerExtractor(GCModel *model, QObject *parent = 0);
+	virtual ~GCLayerExtractor();
+
+	// Preamble is followed by state of the first layer, see GCModel::layerPreamble().
+	// Returns error, empty string once extraction is started.
+	QString start(const QString &fileName, int firstLayer, int lastLayer, const QByteArray &preamble);
+	bool isRunning() const;
+
+public slots:
+	void cancel();
+
+signals:
+	void progressChanged(int percent);
+	// Error is empty when whole file was written.
+	void finished(qint64 bytesWritten, const QString &error);
+
+private slots:
+	void jobFinished();
+
+private:
+	GCModel *m_model;
+	QSharedPointer<GCLayerExtractJob> m_job;
+};
+
+#endif // GCLAYEREXTRACTOR_H
@@ -0,0 +1,407 @@
+#include "GCLayerMesher.h"
+#include "GCJob.h"
+#include "GCTree/GCCommand.h"
+#include "GCTree/GCArcCommand.h"
+
+#include <cmath>
+
+// Segment number of the end ring is pulled back slightly so no fragment of the last segment rounds past it.
+const GLfloat pathEndOffset = 0.01f;
+
+// Merged commands whose ends lie within this share of a segment from even spacing need no rings of their own.
+const double segmentSpacingTolerance = 0.25;
+
+// Joints turning sharper than this (120 degrees) are not mitred, the tube is ended and restarted instead.
+const double maxMitreScale = 2.0;
+
+static QVector2D sideNormal(const QLineF &thread)
+{
+	QVector2D normal(thread.dy(), -thread.dx());
+	normal.normalize();
+
+	return normal;
+}
+
+GCLayerMesher::GCLayerMesher()
+	: m_halfFacePoints(0),
+	  m_arcTolerance(0.0),
+	  m_sinTable(), m_cosTable(),
+	  m_ringPoints(), m_coarseRingPoints(),
+	  m_simplifier(),
+	  m_job(0),
+	  m_vertices(), m_indices(), m_coarseIndices(),
+	  m_lastRing(0),
+	  m_pathFirstSegment(0),
+	  m_nextSegment(0.0)
+{
+	setLOD(3);
+}
+
+void GCLayerMesher::setLOD(unsigned char LOD)
+{
+	m_halfFacePoints = LOD + 2;
+
+	// Finer tubes get finer arcs.
+	m_arcTolerance = 0.1 / m_halfFacePoints;
+
+	// Recalculate goniometric tables.
+	double angle = 0;
+	double angleStep = M_PI / (m_halfFacePoints - 1);
+
+	m_sinTable = std::vector<double>();
+	m_cosTable = std::vector<double>();
+	for (GLuint i = 0; i < m_halfFacePoints * 2; i++, angle += angleStep) {
+		if (i == m_halfFacePoints) {
+			angle -= angleStep;
+		}
+
+		m_sinTable.push_back(sin(angle));
+		m_cosTable.push_back(cos(angle));
+	}
+
+	m_ringPoints = std::vector<GLuint>();
+	for (GLuint pointNo = 0; pointNo < m_halfFacePoints * 2; pointNo++) {
+		m_ringPoints.push_back(pointNo);
+	}
+
+	// Coarse rings reuse top, side and bottom points of each half, at most hexagon.
+	GLuint sidePoint = m_halfFacePoints / 2;
+	m_coarseRingPoints = std::vector<GLuint>();
+	for (GLuint half = 0; half < 2; half++) {
+		GLuint halfStart = half * m_halfFacePoints;
+
+		m_coarseRingPoints.push_back(halfStart);
+		if (sidePoint != 0 && sidePoint != m_halfFacePoints - 1) {
+			m_coarseRingPoints.push_back(halfStart + sidePoint);
+		}
+		m_coarseRingPoints.push_back(halfStart + m_halfFacePoints - 1);
+	}
+}
+
+unsigned char GCLayerMesher::LOD() const
+{
+	return static_cast<unsigned char>(m_halfFacePoints - 2);
+}
+
+void GCLayerMesher::meshLayer(const GCTreeItem *layer, GLuint firstSegment, GCGLView::Mesh &mesh, const GCJob *job)
+{
+	m_job = job;
+	m_vertices = std::vector<GCGLView::Vertex>();
+	m_indices = std::vector<GLuint>();
+	m_coarseIndices = std::vector<GLuint>();
+	m_nextSegment = firstSegment;
+
+	GCPathSimplifier::Thread previous;
+	meshItem(layer, previous);
+
+	mesh.vertices.swap(m_vertices);
+	mesh.indices.swap(m_indices);
+	mesh.coarseIndices.swap(m_coarseIndices);
+	m_job = 0;
+}
+
+GLuint GCLayerMesher::addRing(const QPointF &center, const QVector2D &side, double sideScale,
+						 double width, double height, double z, GLfloat segment)
+{
+	GLuint ringStart = static_cast<GLuint>(m_vertices.size());
+
+	if (width < height) {
+		width = height;
+	}
+
+	double radius = height / 2;
+	double centerOffset = width / 2 - radius;
+
+	if (m_halfFacePoints % 2 == 0) {
+		double missingHalfWidth = radius - radius * m_sinTable[m_halfFacePoints / 2];
+		centerOffset += missingHalfWidth;
+	}
+
+	double centerZ = z - radius;
+
+	GCGLView::Vertex vertex;
+	vertex.segment = segment;
+	vertex.firstSegment = m_pathFirstSegment;
+
+	for (GLuint pointNo = 0; pointNo < m_halfFacePoints * 2; pointNo++) {
+
+		if (pointNo == m_halfFacePoints) {
+			centerOffset *= -1;
+		}
+
+		// Mitred rings are stretched sideways so the tube keeps its width across the joint.
+		double sideOffset = (m_sinTable[pointNo] * radius + centerOffset) * sideScale;
+
+		vertex.position[0] = static_cast<GLfloat>(side.x() * sideOffset + center.x());
+		vertex.position[1] = static_cast<GLfloat>(side.y() * sideOffset + center.y());
+		vertex.position[2] = static_cast<GLfloat>(centerZ + m_cosTable[pointNo] * radius);
+
+		vertex.normal[0] = static_cast<GLfloat>(m_sinTable[pointNo] * side.x());
+		vertex.normal[1] = static_cast<GLfloat>(m_sinTable[pointNo] * side.y());
+		vertex.normal[2] = static_cast<GLfloat>(m_cosTable[pointNo]);
+
+		m_vertices.push_back(vertex);
+	}
+
+	return ringStart;
+}
+
+GLuint GCLayerMesher::addCapRing(GLuint ring, const QLineF &thread, bool start)
+{
+	GLuint capStart = static_cast<GLuint>(m_vertices.size());
+
+	QLineF normal = thread.unitVector();
+	GLfloat normalX = static_cast<GLfloat>(start ? -normal.dx() : normal.dx());
+	GLfloat normalY = static_cast<GLfloat>(start ? -normal.dy() : normal.dy());
+
+	GCGLView::Vertex vertex;
+
+	for (GLuint pointNo = 0; pointNo < m_halfFacePoints * 2; pointNo++) {
+		vertex = m_vertices[ring + pointNo];
+		vertex.normal[0] = normalX;
+		vertex.normal[1] = normalY;
+		vertex.normal[2] = 0;
+
+		m_vertices.push_back(vertex);
+	}
+
+	return capStart;
+}
+
+void GCLayerMesher::addTubeIndices(GLuint startRing, GLuint endRing)
+{
+	GLuint numFacePoints = m_halfFacePoints * 2;
+
+	// One strip zig-zagging between both rings, closed by repeating the first pair.
+	for (GLuint pointNo = 0; pointNo <= numFacePoints; pointNo++) {
+		m_indices.push_back(endRing + pointNo % numFacePoints);
+		m_indices.push_back(startRing + pointNo % numFacePoints);
+	}
+
+	m_indices.push_back(GCGLView::primitiveRestartIndex);
+
+	// Coarse tube skips most ring points, vertices stay shared with full one.
+	GLuint numCoarsePoints = static_cast<GLuint>(m_coarseRingPoints.size());
+
+	for (GLuint pointNo = 0; pointNo <= numCoarsePoints; pointNo++) {
+		m_coarseIndices.push_back(endRing + m_coarseRingPoints[pointNo % numCoarsePoints]);
+		m_coarseIndices.push_back(startRing + m_coarseRingPoints[pointNo % numCoarsePoints]);
+	}
+
+	m_coarseIndices.push_back(GCGLView::primitiveRestartIndex);
+}
+
+void GCLayerMesher::addCapIndices(GLuint ring, bool start)
+{
+	addCapIndices(ring, start, m_ringPoints, m_indices);
+	addCapIndices(ring, start, m_coarseRingPoints, m_coarseIndices);
+}
+
+void GCLayerMesher::addCapIndices(GLuint ring, bool start, const std::vector<GLuint> &points, std::vector<GLuint> &indices)
+{
+	// Ring is convex, so it can be covered by a strip alternating between its two sides.
+	size_t low = 1;
+	size_t high = points.size() - 1;
+	bool takeLow = !start;
+
+	indices.push_back(ring + points[0]);
+
+	while (low <= high) {
+		if (takeLow) {
+			indices.push_back(ring + points[low++]);
+		} else {
+			indices.push_back(ring + points[high--]);
+		}
+
+		takeLow = !takeLow;
+	}
+
+	indices.push_back(GCGLView::primitiveRestartIndex);
+}
+
+void GCLayerMesher::terminatePath(const GCPathSimplifier::Thread &path)
+{
+	if (path.isNull() || m_vertices.size() < m_halfFacePoints * 2) {
+		return;
+	}
+
+	GLfloat pathSegments = static_cast<GLfloat>(m_nextSegment - m_pathFirstSegment);
+
+	GLuint endRing = addRing(path.line.p2(), sideNormal(path.line), 1.0,
+							 path.width, path.height, path.z, pathSegments - pathEndOffset);
+	addTubeIndices(m_lastRing, endRing);
+
+	GLuint capRing = addCapRing(endRing, path.line, false);
+	addCapIndices(capRing, false);
+
+	m_lastRing = endRing;
+}
+
+void GCLayerMesher::addThread(const GCPathSimplifier::Thread &thread, const GCPathSimplifier::Thread &prevThread)
+{
+	double segment = m_nextSegment;
+
+	if (prevThread.isNull()) {
+		m_pathFirstSegment = static_cast<GLuint>(segment);
+
+		GLuint startRing = addRing(thread.line.p1(), sideNormal(thread.line), 1.0,
+								   thread.width, thread.height, thread.z,
+								   static_cast<GLfloat>(segment - m_pathFirstSegment));
+
+		GLuint capRing = addCapRing(startRing, thread.line, true);
+		addCapIndices(capRing, true);
+
+		m_lastRing = startRing;
+	} else if (m_vertices.size() >= m_halfFacePoints * 2) {
+		// Both segments share one ring laying in the plane bisecting the joint.
+		QVector2D side = sideNormal(thread.line);
+		QVector2D mitre = (sideNormal(prevThread.line) + side).normalized();
+
+		GLuint jointRing = addRing(thread.line.p1(), mitre, mitreScale(prevThread, thread),
+								   (thread.width + prevThread.width) / 2,
+								   (thread.height + prevThread.height) / 2, thread.z,
+								   static_cast<GLfloat>(segment - m_pathFirstSegment));
+		addTubeIndices(m_lastRing, jointRing);
+
+		m_lastRing = jointRing;
+	}
+}
+
+double GCLayerMesher::mitreScale(const GCPathSimplifier::Thread &prevThread, const GCPathSimplifier::Thread &thread)
+{
+	QVector2D side = sideNormal(thread.line);
+	QVector2D mitre = sideNormal(prevThread.line) + side;
+
+	double cosHalfAngle = QVector2D::dotProduct(mitre.normalized(), side);
+
+	if (cosHalfAngle < 1.0 / maxMitreScale) {
+		return maxMitreScale + 1.0;
+	}
+
+	return 1.0 / cosHalfAngle;
+}
+
+void GCLayerMesher::meshItem(const GCTreeItem *item, GCPathSimplifier::Thread &previous)
+{
+	// Walks items in the same order as GC3DView::indexItem(), so segments get the same IDs.
+	std::vector<const GCCommand *> extrusions;
+	int numItems = item->childCount();
+
+	for (int itemNo = 0; itemNo < numItems && !(m_job && m_job->isCanceled()); ++itemNo) {
+		const GCTreeItem *childItem = item->child(itemNo);
+		const GCCommand *gcCommand = dynamic_cast<const GCCommand *>(childItem);
+
+		if (gcCommand && !gcCommand->isMove()) {
+			continue;
+		}
+
+		if (gcCommand && gcCommand->threadWidth != 0.0 && !gcCommand->isArc()) {
+			extrusions.push_back(gcCommand);
+			continue;
+		}
+
+		meshThreads(extrusions, previous);
+		extrusions.clear();
+
+		if (gcCommand && gcCommand->threadWidth != 0.0) {
+			meshArc(static_cast<const GCArcCommand *>(gcCommand), previous);
+		} else if (gcCommand) {
+			// Travel move, break path.
+			terminatePath(previous);
+			previous = GCPathSimplifier::Thread();
+		} else {
+			meshItem(childItem, previous);
+		}
+	}
+
+	meshThreads(extrusions, previous);
+
+	terminatePath(previous);
+	previous = GCPathSimplifier::Thread();
+}
+
+void GCLayerMesher::meshThreads(const std::vector<const GCCommand *> &commands, GCPathSimplifier::Thread &previous)
+{
+	// Merged commands share one tube, their IDs follow lengths of the commands along it.
+	std::vector<GCPathSimplifier::Thread> threads;
+	m_simplifier.simplify(commands, threads);
+
+	for (size_t threadNo = 0; threadNo < threads.size(); ++threadNo) {
+		meshThread(threads[threadNo], previous);
+		addSegmentRings(commands, threads[threadNo]);
+	}
+}
+
+void GCLayerMesher::addSegmentRings(const std::vector<const GCCommand *> &commands, const GCPathSimplifier::Thread &thread)
+{
+	if (thread.numCommands < 2) {
+		return;
+	}
+
+	std::vector<double> commandEnds;
+	double length = 0.0;
+
+	for (size_t commandNo = thread.firstCommand; commandNo < thread.firstCommand + thread.numCommands; ++commandNo) {
+		length += commands[commandNo]->thread.length();
+		commandEnds.push_back(length);
+	}
+
+	// Segment number grows linearly between rings, evenly long commands are covered by the thread ends alone.
+	bool even = true;
+
+	for (size_t endNo = 0; endNo + 1 < commandEnds.size() && even; ++endNo) {
+		even = std::fabs(commandEnds[endNo] / length * thread.numCommands - (endNo + 1)) <= segmentSpacingTolerance;
+	}
+
+	if (even) {
+		return;
+	}
+
+	double segment = m_nextSegment - thread.segments - m_pathFirstSegment;
+	QVector2D side = sideNormal(thread.line);
+
+	for (size_t endNo = 0; endNo + 1 < commandEnds.size(); ++endNo) {
+		GLuint ring = addRing(thread.line.pointAt(commandEnds[endNo] / length), side, 1.0,
+							  thread.width, thread.height, thread.z, static_cast<GLfloat>(segment + endNo + 1));
+		addTubeIndices(m_lastRing, ring);
+
+		m_lastRing = ring;
+	}
+}
+
+void GCLayerMesher::meshArc(const GCArcCommand *arc, GCPathSimplifier::Thread &previous)
+{
+	std::vector<QPointF> points;
+	arc->arcPolyline(m_arcTolerance, points);
+
+	double firstSegment = m_nextSegment;
+	size_t numPieces = points.size() - 1;
+
+	for (size_t pieceNo = 0; pieceNo < numPieces; ++pieceNo) {
+		GCPathSimplifier::Thread piece;
+		piece.line = QLineF(points[pieceNo], points[pieceNo + 1]);
+		piece.width = arc->threadWidth;
+		piece.height = arc->threadHeight;
+		piece.z = arc->z;
+		piece.numCommands = 1;
+		piece.segments = 1.0 / numPieces;
+
+		meshThread(piece, previous);
+	}
+
+	// Pieces share one segment ID, rounding must not leak into following segments.
+	m_nextSegment = firstSegment + 1;
+}
+
+void GCLayerMesher::meshThread(const GCPathSimplifier::Thread &thread, GCPathSimplifier::Thread &previous)
+{
+	if (!previous.isNull() && mitreScale(previous, thread) > maxMitreScale) {
+		// Sharp turn, break path.
+		terminatePath(previous);
+		previous = GCPathSimplifier::Thread();
+	}
+
+	addThread(thread, previous);
+	m_nextSegment += thread.segments;
+	previous = thread;
+}
@@ -0,0 +1,61 @@
+#ifndef GCLAYERMESHER_H
+#define GCLAYERMESHER_H
+
+#include "GCGLView.h"
+#include "GCPathSimplifier.h"
+
+#include <QVector2D>
+#include <vector>
+
+class GCJob;
+class GCTreeItem;
+class GCArcCommand;
+
+// Builds tube mesh of one layer. Reads only the G-code tree, so copies can mesh layers on worker threads.
+class GCLayerMesher
+{
+public:
+	GCLayerMesher();
+
+	void setLOD(unsigned char LOD);
+	unsigned char LOD() const;
+
+	// Stops early when job gets canceled.
+	void meshLayer(const GCTreeItem *layer, GLuint firstSegment, GCGLView::Mesh &mesh, const GCJob *job = 0);
+
+private:
+	GLuint addRing(const QPointF &center, const QVector2D &side, double sideScale,
+				   double width, double height, double z, GLfloat segment);
+	GLuint addCapRing(GLuint ring, const QLineF &thread, bool start);
+	void addTubeIndices(GLuint startRing, GLuint endRing);
+	void addCapIndices(GLuint ring, bool start);
+	static void addCapIndices(GLuint ring, bool start, const std::vector<GLuint> &points, std::vector<GLuint> &indices);
+	void terminatePath(const GCPathSimplifier::Thread &path);
+	void addThread(const GCPathSimplifier::Thread &thread, const GCPathSimplifier::Thread &prevThread);
+	static double mitreScale(const GCPathSimplifier::Thread &prevThread, const GCPathSimplifier::Thread &thread);
+	void meshItem(const GCTreeItem *item, GCPathSimplifier::Thread &previous);
+	void meshThreads(const std::vector<const GCCommand *> &commands, GCPathSimplifier::Thread &previous);
+	// Rings at ends of merged commands, placed where the commands end along the thread.
+	void addSegmentRings(const std::vector<const GCCommand *> &commands, const GCPathSimplifier::Thread &thread);
+	void meshArc(const GCArcCommand *arc, GCPathSimplifier::Thread &previous);
+	void meshThread(const GCPathSimplifier::Thread &thread, GCPathSimplifier::Thread &previous);
+
+	GLuint m_halfFacePoints;
+	double m_arcTolerance;				// Largest distance of tessellated arcs from real ones, mm.
+	std::vector<double> m_sinTable;
+	std::vector<double> m_cosTable;
+	std::vector<GLuint> m_ringPoints;
+	std::vector<GLuint> m_coarseRingPoints;
+	GCPathSimplifier m_simplifier;
+
+	// State of the layer being meshed.
+	const GCJob *m_job;
+	std::vector<GCGLView::Vertex> m_vertices;
+	std::vector<GLuint> m_indices;
+	std::vector<GLuint> m_coarseIndices;		// Same vertices, fewer ring points; drawn during interaction.
+	GLuint m_lastRing;					// First vertex of the ring the next segment starts from.
+	GLuint m_pathFirstSegment;
+	double m_nextSegment;				// Segment ID at the next ring, fractional inside arcs.
+};
+
+#endif // GCLAYERMESHER_H
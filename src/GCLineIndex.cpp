@@ -0,0 +1,104 @@
+#include "GCLineIndex.h"
+
+#include <algorithm>
+
+GCLineIndex::GCLineIndex()
+	: m_layers(),
+	  m_gaps(),
+	  m_lastLine(0)
+{
+}
+
+void GCLineIndex::clear()
+{
+	std::vector<Layer>().swap(m_layers);
+	std::vector<unsigned char>().swap(m_gaps);
+	m_lastLine = 0;
+}
+
+void GCLineIndex::swap(GCLineIndex &other)
+{
+	m_layers.swap(other.m_layers);
+	m_gaps.swap(other.m_gaps);
+	std::swap(m_lastLine, other.m_lastLine);
+}
+
+void GCLineIndex::addLayer(qint64 firstLine)
+{
+	m_layers.push_back(Layer(firstLine, m_gaps.size()));
+	m_lastLine = firstLine;
+}
+
+void GCLineIndex::addCommand(qint64 line)
+{
+	// Seven bits per byte, high bit marks more bytes to follow.
+	quint64 gap = static_cast<quint64>(line - m_lastLine);
+
+	while (gap >= 0x80) {
+		m_gaps.push_back(static_cast<unsigned char>(gap | 0x80));
+		gap >>= 7;
+	}
+
+	m_gaps.push_back(static_cast<unsigned char>(gap));
+	m_lastLine = line;
+}
+
+int GCLineIndex::numLayers() const
+{
+	return static_cast<int>(m_layers.size());
+}
+
+int GCLineIndex::layerAt(qint64 line) const
+{
+	int low = 0;
+	int high = static_cast<int>(m_layers.size());
+
+	// Last layer starting at or before line.
+	while (low < high) {
+		int middle = (low + high) / 2;
+
+		if (line < m_layers[middle].firstLine) {
+			high = middle;
+		} else {
+			low = middle + 1;
+		}
+	}
+
+	return low - 1;
+}
+
+int GCLineIndex::commandAt(int layer, qint64 line) const
+{
+	if (layer < 0 || static_cast<size_t>(layer) >= m_layers.size()) {
+		return -1;
+	}
+
+	size_t end = static_cast<size_t>(layer) + 1 < m_layers.size() ? m_layers[layer + 1].firstGap : m_gaps.size();
+	qint64 commandLine = m_layers[layer].firstLine;
+	int command = -1;
+
+	for (size_t i = m_layers[layer].firstGap; i < end;) {
+		quint64 gap = 0;
+		int shift = 0;
+
+		do {
+			gap |= static_cast<quint64>(m_gaps[i] & 0x7F) << shift;
+			shift += 7;
+		} while (m_gaps[i++] & 0x80);
+
+		commandLine += static_cast<qint64>(gap);
+
+		if (commandLine > line) {
+			break;
+		}
+
+		++command;
+	}
+
+	return command;
+}
+
+qint64 GCLineIndex::memoryUsage() const
+{
+	return static_cast<qint64>(m_layers.capacity() * sizeof(Layer) + m_gaps.capacity());
+}
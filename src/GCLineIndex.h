@@ -0,0 +1,43 @@
+#ifndef GCLINEINDEX_H
+#define GCLINEINDEX_H
+
+#include <QtGlobal>
+
+#include <vector>
+
+// Maps lines of the source file to commands of the tree. Lines of commands are stored as gaps to the previous
+// one in variable length bytes, a command on the next line takes a single byte.
+class GCLineIndex
+{
+public:
+	GCLineIndex();
+
+	void clear();
+	void swap(GCLineIndex &other);
+
+	// Layers and their commands are added in file order, lines are counted from 1.
+	void addLayer(qint64 firstLine);
+	void addCommand(qint64 line);
+
+	int numLayers() const;
+	// Layer the line belongs to, -1 for lines before the first layer.
+	int layerAt(qint64 line) const;
+	// Number of last command of layer at or before line, -1 when there is none.
+	int commandAt(int layer, qint64 line) const;
+	qint64 memoryUsage() const;
+
+private:
+	struct Layer {
+		Layer(qint64 firstLine, size_t firstGap)
+			: firstLine(firstLine), firstGap(firstGap) {}
+
+		qint64 firstLine;
+		size_t firstGap;				// Position of gap of its first command.
+	};
+
+	std::vector<Layer> m_layers;
+	std::vector<unsigned char> m_gaps;
+	qint64 m_lastLine;					// Line gap of next command is counted from.
+};
+
+#endif // GCLINEINDEX_H
@@ -0,0 +1,262 @@
+#include "GCMeshCache.h"
+
+template <typename T>
+static bool writeArray(QIODevice &device, const std::vector<T> &array)
+{
+	qint64 bytes = static_cast<qint64>(array.size() * sizeof(T));
+
+	return !bytes || device.write(reinterpret_cast<const char *>(&array[0]), bytes) == bytes;
+}
+
+template <typename T>
+static bool readArray(QIODevice &device, std::vector<T> &array, size_t size)
+{
+	array.resize(size);
+	qint64 bytes = static_cast<qint64>(size * sizeof(T));
+
+	return !bytes || device.read(reinterpret_cast<char *>(&array[0]), bytes) == bytes;
+}
+
+template <typename T>
+static void bufferArray(GLenum target, GLuint buffer, const std::vector<T> &array)
+{
+	glBindBuffer(target, buffer);
+	glBufferData(target, array.size() * sizeof(T), array.empty() ? 0 : &array[0], GL_STATIC_DRAW);
+	glBindBuffer(target, 0);
+}
+
+GCMeshCache::GCMeshCache(size_t budget)
+	: m_budget(budget),
+	  m_usedBytes(0),
+	  m_frame(0),
+	  m_chunks(),
+	  m_lru(),
+	  m_diskCache()
+{
+}
+
+GCMeshCache::~GCMeshCache()
+{
+	reset(0);
+}
+
+void GCMeshCache::reset(size_t numLayers)
+{
+	while (!m_lru.empty()) {
+		evict(m_lru.back());
+	}
+
+	m_chunks = std::vector<Chunk>(numLayers);
+
+	if (m_diskCache.isOpen()) {
+		m_diskCache.resize(0);
+	}
+}
+
+void GCMeshCache::setBudget(size_t bytes)
+{
+	m_budget = bytes;
+
+	// Smaller budget applies immediately, even to visible layers.
+	while (m_usedBytes > m_budget && !m_lru.empty()) {
+		evict(m_lru.back());
+	}
+}
+
+size_t GCMeshCache::budget() const
+{
+	return m_budget;
+}
+
+size_t GCMeshCache::usedBytes() const
+{
+	return m_usedBytes;
+}
+
+void GCMeshCache::beginFrame()
+{
+	++m_frame;
+}
+
+const GCMeshCache::Chunk *GCMeshCache::use(size_t layer)
+{
+	if (layer >= m_chunks.size() || !m_chunks[layer].resident) {
+		return 0;
+	}
+
+	Chunk &chunk = m_chunks[layer];
+	chunk.lastUsedFrame = m_frame;
+	m_lru.splice(m_lru.begin(), m_lru, chunk.lruPosition);
+
+	return &chunk;
+}
+
+bool GCMeshCache::isResident(size_t layer) const
+{
+	return layer < m_chunks.size() && m_chunks[layer].resident;
+}
+
+bool GCMeshCache::isStored(size_t layer) const
+{
+	return layer < m_chunks.size() && m_chunks[layer].stored;
+}
+
+bool GCMeshCache::load(size_t layer)
+{
+	if (!isStored(layer)) {
+		return false;
+	}
+
+	if (isResident(layer)) {
+		return true;
+	}
+
+	Chunk &chunk = m_chunks[layer];
+
+	if (!makeRoom(chunkBytes(chunk))) {
+		return false;
+	}
+
+	GCGLView::Mesh mesh;
+
+	if (!m_diskCache.seek(chunk.storedOffset)
+			|| !readArray(m_diskCache, mesh.vertices, chunk.numVertices)
+			|| !readArray(m_diskCache, mesh.indices, chunk.numIndices)
+			|| !readArray(m_diskCache, mesh.coarseIndices, chunk.numCoarseIndices)) {
+		chunk.stored = false;
+		return false;
+	}
+
+	return bufferChunk(layer, mesh);
+}
+
+bool GCMeshCache::upload(size_t layer, const GCGLView::Mesh &mesh)
+{
+	if (layer >= m_chunks.size()) {
+		return false;
+	}
+
+	if (isResident(layer)) {
+		return true;
+	}
+
+	Chunk &chunk = m_chunks[layer];
+	chunk.numVertices = mesh.vertices.size();
+	chunk.numIndices = mesh.indices.size();
+	chunk.numCoarseIndices = mesh.coarseIndices.size();
+
+	if (!chunk.stored) {
+		store(layer, mesh);
+	}
+
+	if (!makeRoom(chunkBytes(chunk))) {
+		return false;
+	}
+
+	return bufferChunk(layer, mesh);
+}
+
+size_t GCMeshCache::chunkBytes(const Chunk &chunk)
+{
+	return chunk.numVertices * sizeof(GCGLView::Vertex) + (chunk.numIndices + chunk.numCoarseIndices) * sizeof(GLuint);
+}
+
+size_t GCMeshCache::stripTriangles(const std::vector<GLuint> &indices)
+{
+	size_t triangles = 0;
+	size_t stripLength = 0;
+
+	for (size_t i = 0; i <= indices.size(); ++i) {
+		if (i == indices.size() || indices[i] == GCGLView::primitiveRestartIndex) {
+			triangles += stripLength > 2 ? stripLength - 2 : 0;
+			stripLength = 0;
+		} else {
+			++stripLength;
+		}
+	}
+
+	return triangles;
+}
+
+bool GCMeshCache::makeRoom(size_t bytes)
+{
+	while (m_usedBytes + bytes > m_budget && !m_lru.empty()) {
+		size_t layer = m_lru.back();
+
+		// Chunks used in current frame are kept, visible layers would only push each other out.
+		if (m_chunks[layer].lastUsedFrame == m_frame) {
+			return false;
+		}
+
+		evict(layer);
+	}
+
+	return m_usedBytes + bytes <= m_budget;
+}
+
+void GCMeshCache::evict(size_t layer)
+{
+	Chunk &chunk = m_chunks[layer];
+
+	GLuint buffers[3] = {chunk.verticesVBO, chunk.indicesVBO, chunk.coarseIndicesVBO};
+	glDeleteBuffers(3, buffers);
+
+	chunk.verticesVBO = chunk.indicesVBO = chunk.coarseIndicesVBO = 0;
+	chunk.resident = false;
+
+	m_usedBytes -= chunkBytes(chunk);
+	m_lru.erase(chunk.lruPosition);
+}
+
+void GCMeshCache::store(size_t layer, const GCGLView::Mesh &mesh)
+{
+	// Disk cache is an optimization only, mesh is generated again when it can't be stored.
+	if (!m_diskCache.isOpen() && !m_diskCache.open()) {
+		return;
+	}
+
+	qint64 offset = m_diskCache.size();
+
+	if (m_diskCache.seek(offset)
+			&& writeArray(m_diskCache, mesh.vertices)
+			&& writeArray(m_diskCache, mesh.indices)
+			&& writeArray(m_diskCache, mesh.coarseIndices)) {
+		m_chunks[layer].stored = true;
+		m_chunks[layer].storedOffset = offset;
+	}
+}
+
+bool GCMeshCache::bufferChunk(size_t layer, const GCGLView::Mesh &mesh)
+{
+	Chunk &chunk = m_chunks[layer];
+	chunk.numTriangles = stripTriangles(mesh.indices);
+	chunk.numCoarseTriangles = stripTriangles(mesh.coarseIndices);
+
+	// Drop errors of earlier calls, only allocation failure is of interest.
+	for (int i = 0; i < 8 && glGetError() != GL_NO_ERROR; ++i) {
+	}
+
+	GLuint buffers[3];
+	glGenBuffers(3, buffers);
+	chunk.verticesVBO = buffers[0];
+	chunk.indicesVBO = buffers[1];
+	chunk.coarseIndicesVBO = buffers[2];
+
+	bufferArray(GL_ARRAY_BUFFER, chunk.verticesVBO, mesh.vertices);
+	bufferArray(GL_ELEMENT_ARRAY_BUFFER, chunk.indicesVBO, mesh.indices);
+	bufferArray(GL_ELEMENT_ARRAY_BUFFER, chunk.coarseIndicesVBO, mesh.coarseIndices);
+
+	m_usedBytes += chunkBytes(chunk);
+	m_lru.push_front(layer);
+	chunk.lruPosition = m_lru.begin();
+	chunk.resident = true;
+	chunk.lastUsedFrame = m_frame;
+
+	if (glGetError() == GL_OUT_OF_MEMORY) {
+		// Budget is larger than what driver can give, layer stays drawn as lines.
+		evict(layer);
+		return false;
+	}
+
+	return true;
+}
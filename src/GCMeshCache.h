@@ -0,0 +1,78 @@
+#ifndef GCMESHCACHE_H
+#define GCMESHCACHE_H
+
+#include "GCGLView.h"
+
+#include <QTemporaryFile>
+
+#include <list>
+#include <vector>
+
+// Layer meshes kept in GPU buffers within a memory budget, least recently used are evicted first.
+// Every uploaded mesh is also written to a temporary file, so evicted layers load without being generated again.
+// All methods except constructor and budget() expect current GL context.
+class GCMeshCache
+{
+	Q_DISABLE_COPY(GCMeshCache)
+
+public:
+	struct Chunk {
+		Chunk()
+			: verticesVBO(0), indicesVBO(0), coarseIndicesVBO(0),
+			  numVertices(0), numIndices(0), numCoarseIndices(0),
+			  numTriangles(0), numCoarseTriangles(0),
+			  resident(false), stored(false), storedOffset(0),
+			  lastUsedFrame(0), lruPosition() {}
+
+		GLuint verticesVBO;
+		GLuint indicesVBO;
+		GLuint coarseIndicesVBO;
+
+		size_t numVertices;
+		size_t numIndices;
+		size_t numCoarseIndices;
+		size_t numTriangles;
+		size_t numCoarseTriangles;
+
+		bool resident;
+		bool stored;
+		qint64 storedOffset;				// Position of mesh in disk cache.
+
+		unsigned lastUsedFrame;
+		std::list<size_t>::iterator lruPosition;
+	};
+
+	explicit GCMeshCache(size_t budget);
+	~GCMeshCache();
+
+	void reset(size_t numLayers);
+	void setBudget(size_t bytes);
+	size_t budget() const;
+	size_t usedBytes() const;
+
+	void beginFrame();
+	const Chunk *use(size_t layer);
+	bool isResident(size_t layer) const;
+	bool isStored(size_t layer) const;
+	bool load(size_t layer);
+	bool upload(size_t layer, const GCGLView::Mesh &mesh);
+
+private:
+	static size_t chunkBytes(const Chunk &chunk);
+	static size_t stripTriangles(const std::vector<GLuint> &indices);
+	bool makeRoom(size_t bytes);
+	void evict(size_t layer);
+	void store(size_t layer, const GCGLView::Mesh &mesh);
+	bool bufferChunk(size_t layer, const GCGLView::Mesh &mesh);
+
+	size_t m_budget;
+	size_t m_usedBytes;
+	unsigned m_frame;
+
+	std::vector<Chunk> m_chunks;
+	std::list<size_t> m_lru;				// Resident layers, most recently used first.
+
+	QTemporaryFile m_diskCache;
+};
+
+#endif // GCMESHCACHE_H
@@ -1,23 +1,202 @@
 #include "GCModel.h"
 
+#include "GCJobScheduler.h"
+#include "GCGzipDevice.h"
+#include "GCTrace.h"
 #include "GCTree/GCFile.h"
 #include "GCTree/GCLayer.h"
 #include "GCTree/GCPath.h"
 #include "GCTree/GCCommand.h"
+#include "GCTree/GCArcCommand.h"
 
+#include <QFile>
+#include <QIODevice>
+#include <QScopedPointer>
 #include <QString>
 #include <QTextStream>
 
 #include <cmath>
+#include <climits>
+#include <cstring>
+#include <deque>
+
+// Lines parsed between checks for cancellation and progress updates.
+const int parseCheckLines = 4096;
+
+// Parsed layers of mapped file kept in memory, least recently used are unloaded beyond this.
+const qint64 loadedLayersBudget = 256 * 1024 * 1024;
+
+// Tree of a layer not parsed yet is estimated from its size in file.
+const qint64 treeBytesPerFileByte = 8;
+
+// Bookkeeping of a heap block, added to every allocation in memory estimates.
+const qint64 allocationOverhead = 16;
+
+// Estimated heap memory of subtree, text of commands included.
+static qint64 treeMemoryUsage(GCTreeItem *item)
+{
+	if (item->type() == GCTreeItem::GC_COMMAND) {
+		const GCCommand *command = static_cast<const GCCommand *>(item);
+
+		return (dynamic_cast<const GCArcCommand *>(command) ? sizeof(GCArcCommand) : sizeof(GCCommand)) + allocationOverhead
+				+ command->commandText.capacity() * sizeof(QChar) + allocationOverhead;
+	}
+
+	// Layers are the largest nodes, children are held as vector of pointers.
+	qint64 bytes = sizeof(GCLayer) + allocationOverhead + item->childCount() * sizeof(GCTreeItem *);
+
+	for (int i = 0; i < item->childCount(); ++i) {
+		bytes += treeMemoryUsage(item->child(i));
+	}
+
+	return bytes;
+}
+
+class GCParseJob : public GCJob
+{
+public:
+	GCParseJob(const GCModel *model, QIODevice *gcode, double filamentXsectionArea)
+		: GCJob(),
+		  gcFile(new GCFile()),
+		  memoryUsage(0),
+		  stats(),
+		  lineIndex(),
+		  error(),
+		  m_model(model),
+		  m_gcode(gcode),
+		  m_filamentXsectionArea(filamentXsectionArea)
+	{
+	}
+
+	~GCParseJob()
+	{
+		delete gcFile;
+	}
+
+	GCFile *gcFile;					// Parsed tree, taken by model.
+	qint64 memoryUsage;
+	std::vector<GCLayerStats> stats;
+	GCLineIndex lineIndex;
+	QString error;					// Reading failed, tree holds what was read before.
+
+protected:
+	virtual void run()
+	{
+		GC_TRACE_SCOPE("parse");
+
+		QTextStream stream(m_gcode.data());
+		m_model->parseGCode(stream, m_filamentXsectionArea, gcFile, stats, lineIndex, this);
+
+		// Stream takes failed read for end of file.
+		GCGzipDevice *gzip = dynamic_cast<GCGzipDevice *>(m_gcode.data());
+
+		if (gzip) {
+			error = gzip->inflateError();
+		}
+
+		m_gcode->close();
+
+		if (!isCanceled()) {
+			memoryUsage = treeMemoryUsage(gcFile);
+		}
+	}
+
+private:
+	const GCModel *m_model;
+	QScopedPointer<QIODevice> m_gcode;
+	double m_filamentXsectionArea;
+};
+
+class GCScanJob : public GCJob
+{
+public:
+	GCScanJob(const GCModel *model, QFile *file, const char *data, double filamentXsectionArea)
+		: GCJob(),
+		  file(file),
+		  data(data),
+		  size(file->size()),
+		  layers(),
+		  stats(),
+		  lineIndex(),
+		  m_model(model),
+		  m_filamentXsectionArea(filamentXsectionArea)
+	{
+	}
+
+	QScopedPointer<QFile> file;		// Mapped file, taken by model.
+	const char *data;
+	qint64 size;
+	std::vector<GCModel::LazyLayer> layers;
+	std::vector<GCLayerStats> stats;
+	GCLineIndex lineIndex;
+
+protected:
+	virtual void run()
+	{
+		GC_TRACE_SCOPE("scan layers");
+
+		m_model->scanLayers(data, size, m_filamentXsectionArea, layers, stats, lineIndex, this);
+	}
+
+private:
+	const GCModel *m_model;
+	double m_filamentXsectionArea;
+};
+
+class GCLayerParseJob : public GCJob
+{
+public:
+	GCLayerParseJob(const GCModel *model, int layer, double z)
+		: GCJob(),
+		  parsed(z),
+		  m_model(model),
+		  m_layer(layer)
+	{
+	}
+
+	GCLayer parsed;					// Children are moved to model.
+
+protected:
+	virtual void run()
+	{
+		GC_TRACE_SCOPE("parse layer");
+
+		m_model->parseLazyLayer(m_layer, &parsed);
+	}
+
+private:
+	const GCModel *m_model;
+	int m_layer;
+};
 
 GCModel::GCModel(QObject *parent)
 	: QAbstractItemModel(parent),
-	  m_filamentXsectionArea(0.0),
-	  gcFile(0)
+	  gcFile(0),
+	  m_memoryUsage(0),
+	  m_parseJob(),
+	  m_scanJob(),
+	  m_mappedFile(),
+	  m_mappedData(0),
+	  m_mappedSize(0),
+	  m_lazyLayers(),
+	  m_lru(),
+	  m_loadedMemory(0),
+	  m_prefetchJobs(),
+	  m_layerStats(),
+	  m_totalStats(),
+	  m_lineIndex(),
+	  m_loadError()
 {
 
 }
 
+GCModel::~GCModel()
+{
+	cancelLoad();
+	cancelPrefetches();
+	delete gcFile;
+}
+
 QVariant GCModel::data(const QModelIndex &index, int role) const
 {
 	GCTreeItem *item = getItem(index);
@@ -48,6 +227,24 @@ int GCModel::rowCount(const QModelIndex &parent) const
 	return item->childCount();
 }
 
+bool GCModel::hasChildren(const QModelIndex &parent) const
+{
+	// Layers not loaded yet are expandable, their rows are fetched on demand.
+	return canFetchMore(parent) || QAbstractItemModel::hasChildren(parent);
+}
+
+bool GCModel::canFetchMore(const QModelIndex &parent) const
+{
+	int layer = lazyLayerRow(parent);
+
+	return layer >= 0 && !m_lazyLayers[layer].loaded;
+}
+
+void GCModel::fetchMore(const QModelIndex &parent)
+{
+	fetchLayer(lazyLayerRow(parent));
+}
+
 int GCModel::columnCount(const QModelIndex &parent) const
 {
 	Q_UNUSED(parent)
@@ -94,24 +291,536 @@ QModelIndex GCModel::parent(const QModelIndex &index) const
 
 }
 
-bool GCModel::loadGCode(QTextStream &gcode, double filamentDiameter, double packingDensity)
+void GCModel::loadGCode(QIODevice *gcode, double filamentDiameter, double packingDensity)
+{
+	cancelLoad();
+
+	// Layers of the loaded file may still be parsed, filament settings of the new one go with its parse state.
+	double filamentXsectionArea = std::fabs((M_PI * filamentDiameter * filamentDiameter / 4) * packingDensity);
+
+	// Compressed streams and files which can't be mapped are parsed whole.
+	QFile *file = qobject_cast<QFile *>(gcode);
+	uchar *data = (file && file->size() > 0) ? file->map(0, file->size()) : 0;
+
+	if (data) {
+		m_scanJob = QSharedPointer<GCScanJob>(new GCScanJob(this, file, reinterpret_cast<const char *>(data), filamentXsectionArea));
+		connect(m_scanJob.data(), SIGNAL(progressChanged(int)), this, SIGNAL(loadProgress(int)));
+		connect(m_scanJob.data(), SIGNAL(finished()), this, SLOT(scanFinished()), Qt::QueuedConnection);
+
+		GCJobScheduler::globalInstance()->submit(m_scanJob, GCJob::Visible);
+		return;
+	}
+
+	m_parseJob = QSharedPointer<GCParseJob>(new GCParseJob(this, gcode, filamentXsectionArea));
+	connect(m_parseJob.data(), SIGNAL(progressChanged(int)), this, SIGNAL(loadProgress(int)));
+	connect(m_parseJob.data(), SIGNAL(finished()), this, SLOT(parseFinished()), Qt::QueuedConnection);
+
+	GCJobScheduler::globalInstance()->submit(m_parseJob, GCJob::Visible);
+}
+
+bool GCModel::isLoading() const
+{
+	return !m_parseJob.isNull() || !m_scanJob.isNull();
+}
+
+QString GCModel::loadError() const
+{
+	return m_loadError;
+}
+
+void GCModel::fetchLayer(int layer)
+{
+	if (layer < 0 || static_cast<size_t>(layer) >= m_lazyLayers.size()) {
+		return;
+	}
+
+	LazyLayer &lazyLayer = m_lazyLayers[layer];
+
+	if (lazyLayer.loaded) {
+		if (!lazyLayer.pins) {
+			m_lru.splice(m_lru.begin(), m_lru, lazyLayer.lruPosition);
+		}
+
+		return;
+	}
+
+	// Prefetch still in queue is run right here, running one is waited for.
+	QSharedPointer<GCLayerParseJob> job = m_prefetchJobs.take(layer);
+
+	if (job) {
+		job->wait();
+		insertLayer(layer, &job->parsed);
+	} else {
+		GCLayer parsed(lazyLayer.z);
+		parseLazyLayer(layer, &parsed);
+		insertLayer(layer, &parsed);
+	}
+
+	trimLayers();
+}
+
+void GCModel::prefetchLayer(int layer, GCJob::Priority priority)
+{
+	if (layer < 0 || static_cast<size_t>(layer) >= m_lazyLayers.size() || m_lazyLayers[layer].loaded) {
+		return;
+	}
+
+	QSharedPointer<GCLayerParseJob> job = m_prefetchJobs.value(layer);
+
+	if (job) {
+		if (job->priority() <= priority || job->isStarted()) {
+			return;
+		}
+
+		// Background prefetch became urgent, it mustn't wait behind other background jobs.
+		job->cancel();
+		job->wait();
+	}
+
+	job = QSharedPointer<GCLayerParseJob>(new GCLayerParseJob(this, layer, m_lazyLayers[layer].z));
+	connect(job.data(), SIGNAL(finished()), this, SLOT(prefetchFinished()), Qt::QueuedConnection);
+
+	m_prefetchJobs.insert(layer, job);
+	GCJobScheduler::globalInstance()->submit(job, priority);
+}
+
+void GCModel::pinLayers(const std::vector<int> &layers)
+{
+	if (m_lazyLayers.empty()) {
+		return;
+	}
+
+	GC_TRACE_SCOPE("pin layers");
+
+	// Layers parse independently of each other, every worker takes part.
+	std::vector<QSharedPointer<GCLayerParseJob> > jobs(layers.size());
+
+	for (size_t i = 0; i < layers.size(); ++i) {
+		int layer = layers[i];
+
+		if (layer < 0 || static_cast<size_t>(layer) >= m_lazyLayers.size()) {
+			continue;
+		}
+
+		LazyLayer &lazyLayer = m_lazyLayers[layer];
+
+		// Unloaded layer with pins is listed twice, it is parsed once.
+		if (lazyLayer.loaded && !lazyLayer.pins) {
+			m_lru.erase(lazyLayer.lruPosition);
+		} else if (!lazyLayer.loaded && !lazyLayer.pins) {
+			jobs[i] = m_prefetchJobs.take(layer);
+
+			if (!jobs[i]) {
+				jobs[i] = QSharedPointer<GCLayerParseJob>(new GCLayerParseJob(this, layer, lazyLayer.z));
+				GCJobScheduler::globalInstance()->submit(jobs[i], GCJob::Visible);
+			}
+		}
+
+		++lazyLayer.pins;
+	}
+
+	for (size_t i = 0; i < jobs.size(); ++i) {
+		if (jobs[i]) {
+			jobs[i]->wait();
+			insertLayer(layers[i], &jobs[i]->parsed);
+			jobs[i].clear();
+		}
+	}
+}
+
+void GCModel::unpinLayers(const std::vector<int> &layers)
 {
+	for (size_t i = 0; i < layers.size(); ++i) {
+		int layer = layers[i];
+
+		if (layer < 0 || static_cast<size_t>(layer) >= m_lazyLayers.size() || !m_lazyLayers[layer].pins) {
+			continue;
+		}
+
+		LazyLayer &lazyLayer = m_lazyLayers[layer];
+
+		// Released layers are the first ones unloaded.
+		if (!--lazyLayer.pins && lazyLayer.loaded) {
+			m_lru.push_back(layer);
+			lazyLayer.lruPosition = --m_lru.end();
+		}
+	}
+
+	trimLayers();
+}
+
+GCTreeItem *GCModel::readLayer(int layer, QScopedPointer<GCLayer> &copy) const
+{
+	// Whole parsed tree never changes until reset.
+	if (m_lazyLayers.empty()) {
+		return gcFile && layer >= 0 && layer < gcFile->childCount() ? gcFile->child(layer) : 0;
+	}
+
+	if (layer < 0 || static_cast<size_t>(layer) >= m_lazyLayers.size()) {
+		return 0;
+	}
+
+	copy.reset(new GCLayer(m_lazyLayers[layer].z));
+	parseLazyLayer(layer, copy.data());
+
+	return copy.data();
+}
+
+int GCModel::layersWithinBudget(int firstLayer) const
+{
+	firstLayer = qMax(firstLayer, 0);
+
+	if (m_lazyLayers.empty()) {
+		return qMax(rowCount() - firstLayer, 0);
+	}
+
+	int numLayers = static_cast<int>(m_lazyLayers.size());
+	qint64 memory = 0;
+	int layer;
+
+	for (layer = firstLayer; layer < numLayers; ++layer) {
+		const LazyLayer &lazyLayer = m_lazyLayers[layer];
+		qint64 end = layer + 1 < numLayers ? m_lazyLayers[layer + 1].offset : m_mappedSize;
+
+		memory += lazyLayer.loaded ? lazyLayer.memoryUsage : (end - lazyLayer.offset) * treeBytesPerFileByte;
+
+		if (memory > loadedLayersBudget && layer > firstLayer) {
+			break;
+		}
+	}
+
+	return layer - firstLayer;
+}
+
+qint64 GCModel::memoryUsage() const
+{
+	return m_memoryUsage;
+}
+
+const GCLayerStats &GCModel::layerStats(int layer) const
+{
+	static const GCLayerStats empty;
+
+	if (layer < 0 || static_cast<size_t>(layer) >= m_layerStats.size()) {
+		return empty;
+	}
+
+	return m_layerStats[layer];
+}
+
+const GCLayerStats &GCModel::totalStats() const
+{
+	return m_totalStats;
+}
+
+const char *GCModel::mappedData() const
+{
+	return m_mappedData;
+}
+
+qint64 GCModel::mappedSize() const
+{
+	return m_mappedSize;
+}
+
+QString GCModel::mappedFileName() const
+{
+	return m_mappedFile ? m_mappedFile->fileName() : QString();
+}
+
+std::vector<qint64> GCModel::layerOffsets() const
+{
+	std::vector<qint64> offsets;
+	offsets.reserve(m_lazyLayers.size());
+
+	for (size_t layer = 0; layer < m_lazyLayers.size(); ++layer) {
+		offsets.push_back(m_lazyLayers[layer].offset);
+	}
+
+	return offsets;
+}
+
+QByteArray GCModel::layerPreamble(int layer) const
+{
+	if (layer < 0 || static_cast<size_t>(layer) >= m_lazyLayers.size()) {
+		return QByteArray();
+	}
+
+	const ParseState &state = m_lazyLayers[layer].state;
+	QString preamble = QString("; Start of layer %1 at Z%2\n").arg(layer + 1).arg(m_lazyLayers[layer].z, 0, 'f', 3);
+
+	// Lines retracting, travelling to the layer and priming again end the previous layer, they are replayed.
+	// E is reset before both feeds, so they are the same in either extrusion mode.
+	QString feed = QString("G92 E0\nG1 E%1 F%2\n");
+	bool primed = state.primed > 0.0;
+
+	// Height is reached first, so nozzle moves over printed part of the model.
+	preamble += "G90\n";
+
+	if (primed) {
+		preamble += feed.arg(-state.primed, 0, 'f', 5).arg(state.primeFeedRate, 0, 'f', 0);
+	}
+
+	preamble += QString("G0 Z%1\n").arg(state.z, 0, 'f', 3);
+	preamble += QString("G0 X%1 Y%2\n").arg(state.pos.x(), 0, 'f', 3).arg(state.pos.y(), 0, 'f', 3);
+
+	if (primed) {
+		preamble += feed.arg(state.primed, 0, 'f', 5).arg(state.primeFeedRate, 0, 'f', 0);
+	}
+
+	preamble += QString("G1 F%1\n").arg(state.feedRate, 0, 'f', 0);
+
+	if (state.relativePositioning) {
+		preamble += "G91\n";
+	}
+
+	// Without M82 or M83 in the file, E mode follows G90 and G91 above.
+	if (state.extrusionModeSet) {
+		preamble += state.relativeExtrusion ? "M83\n" : "M82\n";
+	}
+
+	preamble += QString("G92 E%1\n").arg(state.relativeExtrusion ? 0.0 : state.e, 0, 'f', 5);
+
+	return preamble.toLatin1();
+}
+
+QModelIndex GCModel::commandIndex(int layer, int command)
+{
+	fetchLayer(layer);
+
+	QModelIndex layerIndex = index(layer, 0);
+
+	if (!layerIndex.isValid() || command < 0) {
+		return layerIndex;
+	}
+
+	// Commands are grouped to paths in file order.
+	int numPaths = rowCount(layerIndex);
+
+	for (int path = 0; path < numPaths; ++path) {
+		QModelIndex pathIndex = index(path, 0, layerIndex);
+		int numCommands = rowCount(pathIndex);
+
+		if (command < numCommands) {
+			return index(command, 0, pathIndex);
+		}
+
+		command -= numCommands;
+	}
+
+	return layerIndex;
+}
+
+QModelIndex GCModel::commandAtLine(qint64 line)
+{
+	int layer = m_lineIndex.layerAt(line);
+	int command = m_lineIndex.commandAt(layer, line);
+
+	// Lines before the first command of a layer belong to the last command of the previous one.
+	while (command < 0 && layer > 0) {
+		command = m_lineIndex.commandAt(--layer, line);
+	}
+
+	if (command < 0) {
+		return QModelIndex();
+	}
+
+	return commandIndex(layer, command);
+}
+
+void GCModel::setLayerStats(const std::vector<GCLayerStats> &stats)
+{
+	m_layerStats = stats;
+	m_totalStats = GCLayerStats();
+
+	for (size_t layer = 0; layer < m_layerStats.size(); ++layer) {
+		m_totalStats.add(m_layerStats[layer]);
+	}
+}
+
+void GCModel::parseFinished()
+{
+	if (!m_parseJob || !m_parseJob->isFinished()) {
+		// Finished job of canceled load.
+		return;
+	}
+
+	GC_TRACE_SCOPE("model reset");
+
 	beginResetModel();
 
-	if (gcFile) {
-		delete gcFile;
-		gcFile = 0;
+	delete gcFile;
+	clearLazyLayers();
+	gcFile = m_parseJob->gcFile;
+	m_parseJob->gcFile = 0;
+	setLayerStats(m_parseJob->stats);
+	m_lineIndex.swap(m_parseJob->lineIndex);
+	m_memoryUsage = m_parseJob->memoryUsage + m_lineIndex.memoryUsage();
+	m_loadError = m_parseJob->error;
+	m_parseJob.clear();
+
+	endResetModel();
+	emit layersNumChanged(rowCount());
+}
+
+void GCModel::scanFinished()
+{
+	if (!m_scanJob || !m_scanJob->isFinished()) {
+		// Finished job of canceled load.
+		return;
 	}
+
+	GC_TRACE_SCOPE("model reset");
+
+	beginResetModel();
+
+	delete gcFile;
+	clearLazyLayers();
+	m_lazyLayers.swap(m_scanJob->layers);
+	m_mappedFile.reset(m_scanJob->file.take());
+	m_mappedData = m_scanJob->data;
+	m_mappedSize = m_scanJob->size;
+	setLayerStats(m_scanJob->stats);
+	m_lineIndex.swap(m_scanJob->lineIndex);
+	m_loadError.clear();
+	m_scanJob.clear();
+
+	// Layers are empty until fetched.
 	gcFile = new GCFile();
 
-	m_filamentXsectionArea =  std::fabs((M_PI * filamentDiameter * filamentDiameter / 4) * packingDensity);
+	for (size_t layer = 0; layer < m_lazyLayers.size(); ++layer) {
+		GCLayer *layerItem = new GCLayer(m_lazyLayers[layer].z);
+		layerItem->setStats(m_layerStats[layer]);
+		gcFile->addChild(layerItem);
+	}
 
-	parseGCode(gcode);
+	m_memoryUsage = treeMemoryUsage(gcFile) + static_cast<qint64>(m_lazyLayers.size() * sizeof(LazyLayer))
+					+ m_lineIndex.memoryUsage();
 
 	endResetModel();
 	emit layersNumChanged(rowCount());
+}
 
-	return true;
+void GCModel::prefetchFinished()
+{
+	// Jobs finish in any order, all finished are collected. Fetched layers took their jobs over.
+	QMap<int, QSharedPointer<GCLayerParseJob> >::iterator it = m_prefetchJobs.begin();
+	bool inserted = false;
+
+	while (it != m_prefetchJobs.end()) {
+		if (!it.value()->isFinished()) {
+			++it;
+			continue;
+		}
+
+		if (!it.value()->isCanceled()) {
+			insertLayer(it.key(), &it.value()->parsed);
+			inserted = true;
+		}
+
+		it = m_prefetchJobs.erase(it);
+	}
+
+	if (inserted) {
+		trimLayers();
+	}
+}
+
+void GCModel::cancelLoad()
+{
+	if (m_parseJob) {
+		m_parseJob->cancel();
+		m_parseJob->wait();
+		m_parseJob.clear();
+	}
+
+	if (m_scanJob) {
+		m_scanJob->cancel();
+		m_scanJob->wait();
+		m_scanJob.clear();
+	}
+}
+
+void GCModel::clearLazyLayers()
+{
+	// Jobs read the mapped file, it must not be unmapped under them.
+	cancelPrefetches();
+
+	m_lazyLayers = std::vector<LazyLayer>();
+	m_lru.clear();
+	m_loadedMemory = 0;
+
+	m_mappedData = 0;
+	m_mappedSize = 0;
+	m_mappedFile.reset();
+}
+
+int GCModel::lazyLayerRow(const QModelIndex &index) const
+{
+	if (type(index) != GCTreeItem::GC_LAYER || static_cast<size_t>(index.row()) >= m_lazyLayers.size()) {
+		return -1;
+	}
+
+	return index.row();
+}
+
+void GCModel::insertLayer(int layer, GCLayer *parsed)
+{
+	LazyLayer &lazyLayer = m_lazyLayers[layer];
+	GCLayer *item = static_cast<GCLayer *>(gcFile->child(layer));
+
+	beginInsertRows(index(layer, 0), 0, parsed->childCount() - 1);
+	item->takeChildren(parsed);
+	lazyLayer.loaded = true;
+	endInsertRows();
+
+	lazyLayer.memoryUsage = treeMemoryUsage(item) - treeMemoryUsage(parsed);
+	m_loadedMemory += lazyLayer.memoryUsage;
+	m_memoryUsage += lazyLayer.memoryUsage;
+
+	if (!lazyLayer.pins) {
+		m_lru.push_front(layer);
+		lazyLayer.lruPosition = m_lru.begin();
+	}
+}
+
+void GCModel::unloadLayer(int layer)
+{
+	LazyLayer &lazyLayer = m_lazyLayers[layer];
+	GCLayer *item = static_cast<GCLayer *>(gcFile->child(layer));
+
+	beginRemoveRows(index(layer, 0), 0, item->childCount() - 1);
+	item->deleteChildren();
+	lazyLayer.loaded = false;
+	endRemoveRows();
+
+	m_loadedMemory -= lazyLayer.memoryUsage;
+	m_memoryUsage -= lazyLayer.memoryUsage;
+
+	m_lru.erase(lazyLayer.lruPosition);
+}
+
+void GCModel::trimLayers()
+{
+	// Most recently used layer stays even when it alone exceeds budget.
+	while (m_loadedMemory > loadedLayersBudget && m_lru.size() > 1) {
+		unloadLayer(m_lru.back());
+	}
+}
+
+void GCModel::cancelPrefetches()
+{
+	QMap<int, QSharedPointer<GCLayerParseJob> >::iterator it;
+
+	for (it = m_prefetchJobs.begin(); it != m_prefetchJobs.end(); ++it) {
+		it.value()->cancel();
+	}
+
+	for (it = m_prefetchJobs.begin(); it != m_prefetchJobs.end(); ++it) {
+		it.value()->wait();
+	}
+
+	m_prefetchJobs.clear();
 }
 
 QModelIndex GCModel::getLayerIndex(QModelIndex index)
@@ -198,102 +907,704 @@ bool getGCParam(const QString &line, const QString &param, int &value)
 	return true;
 }
 
-void GCModel::parseGCode(QTextStream &gcodeStream)
+// Byte level counterparts of getGCParam() for layer scan. Values end at blank, invalid ones read as zero.
+static inline bool isBlank(char c)
 {
-	// Parses only G1.
+	return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
 
-	QString line;
-	QPointF currPos;
-	QPointF newPos;
-	double currZ = 0.0;
-	double newZ = 0.0;
-	double zRise = 0.0;
-	double e;
-	double param;
+static inline char toUpper(char c)
+{
+	return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+}
 
-	GCLayer *layer = new GCLayer(currZ);
-	GCPath *path = new GCPath(true);
-	bool pathTravel = true;
+static const char *valueEnd(const char *value, const char *end)
+{
+	while (value < end && !isBlank(*value)) {
+		++value;
+	}
 
-	while (!gcodeStream.atEnd()) {
-		line = gcodeStream.readLine();
+	return value;
+}
 
-		parsedGCData data;
-		data.z = currZ;
-		data.commandText = line;
+static int scanInt(const char *begin, const char *end)
+{
+	const char *p = begin;
+	bool negative = p < end && *p == '-';
+
+	if (p < end && (*p == '-' || *p == '+')) {
+		++p;
+	}
+
+	if (p == end) {
+		return 0;
+	}
+
+	qint64 value = 0;
+
+	for (; p < end; ++p) {
+		if (*p < '0' || *p > '9' || value > INT_MAX) {
+			return 0;
+		}
+
+		value = value * 10 + (*p - '0');
+	}
+
+	return static_cast<int>(negative ? -value : value);
+}
+
+static double scanDouble(const char *begin, const char *end)
+{
+	static const double powersOf10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+										1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+	const char *p = begin;
+	bool negative = p < end && *p == '-';
+
+	if (p < end && (*p == '-' || *p == '+')) {
+		++p;
+	}
+
+	quint64 mantissa = 0;
+	int numDigits = 0;
+	int exponent = 0;
+	bool hasDigits = false;
+
+	for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+		if (numDigits < 19) {
+			mantissa = mantissa * 10 + static_cast<quint64>(*p - '0');
+			numDigits += mantissa != 0;
+		} else {
+			++exponent;
+		}
+
+		hasDigits = true;
+	}
+
+	if (p < end && *p == '.') {
+		for (++p; p < end && *p >= '0' && *p <= '9'; ++p) {
+			if (numDigits < 19) {
+				mantissa = mantissa * 10 + static_cast<quint64>(*p - '0');
+				numDigits += mantissa != 0;
+				--exponent;
+			}
+
+			hasDigits = true;
+		}
+	}
+
+	if (!hasDigits) {
+		return 0.0;
+	}
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		const char *digits = p + 1;
+
+		if (digits < end && (*digits == '-' || *digits == '+')) {
+			++digits;
+		}
+
+		if (digits == end) {
+			return 0.0;
+		}
+
+		for (const char *digit = digits; digit < end; ++digit) {
+			if (*digit < '0' || *digit > '9') {
+				return 0.0;
+			}
+		}
+
+		exponent += scanInt(p + 1, end);
+		p = end;
+	}
+
+	if (p != end) {
+		return 0.0;
+	}
+
+	// Single rounding of exact operands gives the same result as Qt, other cases are left to it.
+	if (mantissa < (Q_UINT64_C(1) << 53) && exponent >= -22 && exponent <= 22) {
+		double value = static_cast<double>(mantissa);
+		value = exponent < 0 ? value / powersOf10[-exponent] : value * powersOf10[exponent];
+
+		return negative ? -value : value;
+	}
+
+	return QByteArray(begin, static_cast<int>(end - begin)).toDouble();
+}
+
+// Commands are grouped into alternating travel and extrusion paths.
+static void addCommand(GCCommand *command, GCLayer *layer, GCPath *&path, bool &pathTravel)
+{
+	if ((pathTravel && command->threadWidth > 0.001) || (!pathTravel && command->threadWidth < 0.001)) {
+		layer->addChild(path);
+		pathTravel = !pathTravel;
+		path = new GCPath(pathTravel);
+	}
+
+	path->addChild(command);
+}
 
-		GCCommand *gcCommand = new GCCommand();
-		gcCommand->z = currZ;
-		gcCommand->commandText = line;
+bool GCModel::isCommandLine(const char *line, const char *end)
+{
+	while (line < end && isBlank(*line)) {
+		++line;
+	}
+
+	return line < end && toUpper(*line) == 'G';
+}
+
+bool GCModel::scanParam(const char *line, const char *end, char letter, double &value)
+{
+	const char *textEnd = static_cast<const char *>(std::memchr(line, ';', end - line));
+	textEnd = textEnd ? textEnd : end;
+	letter = toUpper(letter);
+
+	for (const char *c = line; c < textEnd; ++c) {
+		if (toUpper(*c) == letter) {
+			value = scanDouble(c + 1, valueEnd(c + 1, textEnd));
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void GCModel::scanLayers(const char *data, qint64 size, double filamentXsectionArea, std::vector<LazyLayer> &layers,
+						 std::vector<GCLayerStats> &stats, GCLineIndex &lineIndex, GCJob *job) const
+{
+	// Follows state changes of parseCommand() on raw bytes, only layer starts, statistics and lines are recorded.
+	ParseState state;
+	state.filamentXsectionArea = filamentXsectionArea;
+	layers.push_back(LazyLayer(0, state.layerZ, state));
+	stats.push_back(GCLayerStats());
+	lineIndex.addLayer(1);
+
+	// Moves of a layer are planned together with the next ones, its time is known after they leave the planner.
+	// So is the entry speed of its first move, lazy layers are planned from it.
+	GCMotionPlanner planner;
+	std::deque<double> layerTimes(1, 0.0);
+	std::deque<double> entrySpeeds(1, 0.0);
+
+	const char *end = data + size;
+	const char *line = data;
+	qint64 lineNo = 0;
+
+	while (line < end) {
+		if (++lineNo % parseCheckLines == 0 && job) {
+			if (job->isCanceled()) {
+				return;
+			}
+
+			GC_TRACE_COUNTER("bytes scanned", line - data);
+			job->setProgress(static_cast<int>((line - data) * 100 / size));
+		}
+
+		const char *lineEnd = static_cast<const char *>(std::memchr(line, '\n', end - line));
+		const char *nextLine = lineEnd ? lineEnd + 1 : end;
+		lineEnd = lineEnd ? lineEnd : end;
 
-		line = line.simplified().toUpper();
+		const char *textEnd = static_cast<const char *>(std::memchr(line, ';', lineEnd - line));
+		textEnd = textEnd ? textEnd : lineEnd;
 
-		int gNum;
-		if (line.startsWith("G") && getGCParam(line, "G", gNum)) {
+		const char *text = line;
+		while (text < textEnd && isBlank(*text)) {
+			++text;
+		}
+
+		char letter = text < textEnd ? toUpper(*text) : 0;
+		int number = (letter == 'G' || letter == 'M') ? scanInt(text + 1, valueEnd(text + 1, textEnd)) : -1;
+
+		if (letter == 'M') {
+			if (number == 82 || number == 83) {
+				state.relativeExtrusion = (number == 83);
+				state.extrusionModeSet = true;
+			}
+		} else if (letter == 'G' && (number == 2 || number == 3)) {
+			// Arcs are rare, their length is left to full parser.
+			ParseState lineState = state;
+			bool layerStart;
+			GCMotionPlanner::Move move;
+			QScopedPointer<GCCommand> gcCommand(parseCommand(QString::fromLatin1(line, static_cast<int>(lineEnd - line)),
+															 state, layerStart, move));
+
+			if (layerStart) {
+				layers.push_back(LazyLayer(line - data, state.layerZ, lineState));
+				stats.push_back(GCLayerStats());
+				layerTimes.push_back(0.0);
+				entrySpeeds.push_back(0.0);
+				lineIndex.addLayer(lineNo);
+				move.entrySpeed = &entrySpeeds.back();
+			}
+
+			if (gcCommand) {
+				stats.back().addMove(gcCommand.data(), move.delta[3], state.filamentXsectionArea);
+				move.layerTime = &layerTimes.back();
+				planner.addMove(move);
+			}
+		} else if (letter == 'G' && (number <= 1 || number == 92)) {
+			// First occurrence of each parameter letter, as found by getGCParam().
+			const char *values[5] = {0, 0, 0, 0, 0};		// X, Y, Z, E, F.
+
+			for (const char *c = text; c < textEnd; ++c) {
+				const char *names = "XYZEF";
+				const char *name = std::strchr(names, toUpper(*c));
 
-			if (gNum == 1) {
-				if (getGCParam(line, "X", param)) {
-					newPos.setX(param);
+				if (*c && name && !values[name - names]) {
+					values[name - names] = c + 1;
 				}
+			}
+
+			double params[5];
+			for (int i = 0; i < 5; ++i) {
+				params[i] = values[i] ? scanDouble(values[i], valueEnd(values[i], textEnd)) : 0.0;
+			}
+
+			if (number == 92) {
+				// No axis given resets all of them.
+				bool all = !values[0] && !values[1] && !values[2] && !values[3];
 
-				if (getGCParam(line, "Y", param)) {
-					newPos.setY(param);
+				if (values[0] || all) {
+					state.pos.setX(params[0]);
 				}
 
-				if (getGCParam(line, "Z", param)) {
-					newZ = param;
+				if (values[1] || all) {
+					state.pos.setY(params[1]);
 				}
 
-				if (!getGCParam(line, "E", e)) {
-					e = 0.0;
+				if (values[2] || all) {
+					state.z = params[2];
 				}
 
+				if (values[3] || all) {
+					state.e = params[3];
+				}
+			} else if (number >= 0) {
+				QPointF newPos = state.relativePositioning ? state.pos : QPointF();
 
-				if (currZ != newZ) {
-					// Inter layers travel move.
-					zRise = newZ - currZ;
-					currZ = newZ;
+				if (values[0]) {
+					newPos.setX(state.relativePositioning ? newPos.x() + params[0] : params[0]);
+				} else if (!state.relativePositioning) {
+					newPos.setX(state.pos.x());
+				}
 
-					layer->addChild(path);
-					path = new GCPath(true);
-					pathTravel = true;
+				if (values[1]) {
+					newPos.setY(state.relativePositioning ? newPos.y() + params[1] : params[1]);
+				} else if (!state.relativePositioning) {
+					newPos.setY(state.pos.y());
+				}
 
-					gcFile->addChild(layer);
-					layer = new GCLayer(newZ);
+				double newZ = values[2] ? (state.relativePositioning ? state.z + params[2] : params[2]) : state.z;
+				double e = 0.0;
+				double newE = state.e;
 
-				} else {
-					createThread(currPos, newPos, e, zRise, data);
-					gcCommand->thread = data.thread;
-					gcCommand->threadHeight = data.threadHeight;
-					gcCommand->threadWidth = data.threadWidth;
+				if (values[3]) {
+					e = state.relativeExtrusion ? params[3] : params[3] - state.e;
+					newE = state.relativeExtrusion ? state.e + params[3] : params[3];
 				}
 
-				currPos = newPos;
+				if (values[4] && params[4] > 0.0) {
+					state.feedRate = params[4];
+				}
+
+				double length = QLineF(state.pos, newPos).length();
+				GCMotionPlanner::Move move;
+
+				if (e > 0.0 && length > 0.0 && newZ != state.layerZ) {
+					layers.push_back(LazyLayer(line - data, newZ, state));
+					stats.push_back(GCLayerStats());
+					layerTimes.push_back(0.0);
+					entrySpeeds.push_back(0.0);
+					move.entrySpeed = &entrySpeeds.back();
+					lineIndex.addLayer(lineNo);
+					state.zRise = std::fabs(newZ - state.layerZ);
+					state.layerZ = newZ;
+				}
+
+				stats.back().addMove(state.pos, newPos, newZ, length, e, state.filamentXsectionArea);
+
+				move.delta[0] = newPos.x() - state.pos.x();
+				move.delta[1] = newPos.y() - state.pos.y();
+				move.delta[2] = newZ - state.z;
+				move.delta[3] = e;
+				move.length = length;
+				move.feedRate = state.feedRate;
+				move.layerTime = &layerTimes.back();
+				planner.addMove(move);
+
+				feedFilament(state, e, length);
+				state.pos = newPos;
+				state.z = newZ;
+				state.e = newE;
+			}
+		} else if (letter == 'G' && (number == 90 || number == 91)) {
+			setPositioning(state, number == 91);
+		}
+
+		// Every line starting with G gives a command, see parseCommand().
+		if (letter == 'G') {
+			lineIndex.addCommand(lineNo);
+		}
+
+		line = nextLine;
+	}
+
+	planner.flush();
+
+	for (size_t layer = 0; layer < stats.size(); ++layer) {
+		stats[layer].printTime = layerTimes[layer];
+		layers[layer].entrySpeed = entrySpeeds[layer];
+	}
+
+	GC_TRACE_COUNTER("bytes scanned", size);
+}
+
+void GCModel::parseLazyLayer(int layer, GCLayer *target) const
+{
+	const LazyLayer &lazyLayer = m_lazyLayers[layer];
+	bool last = static_cast<size_t>(layer) + 1 == m_lazyLayers.size();
+	qint64 end = last ? m_mappedSize : m_lazyLayers[layer + 1].offset;
+	double exitSpeed = last ? 0.0 : m_lazyLayers[layer + 1].entrySpeed;
+
+	// Mapped bytes are read in place.
+	QByteArray bytes = QByteArray::fromRawData(m_mappedData + lazyLayer.offset, static_cast<int>(end - lazyLayer.offset));
+	QTextStream stream(bytes, QIODevice::ReadOnly);
+
+	parseLayer(stream, lazyLayer.state, lazyLayer.entrySpeed, exitSpeed, target);
+}
+
+void GCModel::parseGCode(QTextStream &gcodeStream, double filamentXsectionArea, GCFile *file,
+						 std::vector<GCLayerStats> &stats, GCLineIndex &lineIndex, GCJob *job) const
+{
+	ParseState state;
+	state.filamentXsectionArea = filamentXsectionArea;
+	GCLayerStats layerStats;
+
+	// Times of moves are known after they leave the planner, layer times are set at the end.
+	GCMotionPlanner planner;
+	std::deque<double> layerTimes(1, 0.0);
+
+	GCLayer *layer = new GCLayer(state.layerZ);
+	GCPath *path = new GCPath(true);
+	bool pathTravel = true;
+
+	QIODevice *device = gcodeStream.device();
+	qint64 lineNo = 0;
+	qint64 bytesParsed = 0;
+	qint64 numCommands = 0;
+
+	lineIndex.addLayer(1);
+
+	while (!gcodeStream.atEnd()) {
+		if (++lineNo % parseCheckLines == 0 && job) {
+			if (job->isCanceled()) {
+				break;
 			}
 
-			if ((pathTravel && data.threadWidth > 0.001) || (!pathTravel && data.threadWidth < 0.001)) {
-				layer->addChild(path);
-				pathTravel = !pathTravel;
-				path = new GCPath(pathTravel);
+			GC_TRACE_COUNTER("bytes parsed", bytesParsed);
+			GC_TRACE_COUNTER("commands", numCommands);
 
+			// Position of compressed stream is unknown.
+			if (device && !device->isSequential() && device->size() > 0) {
+				job->setProgress(static_cast<int>(device->pos() * 100 / device->size()));
 			}
-			path->addChild(gcCommand);
+		}
+
+		QString line = gcodeStream.readLine();
+		bytesParsed += line.size() + 1;
+
+		bool layerStart;
+		GCMotionPlanner::Move move;
+		GCCommand *gcCommand = parseCommand(line, state, layerStart, move);
+
+		if (!gcCommand) {
+			continue;
+		}
+
+		++numCommands;
+
+		if (layerStart) {
+			layer->addChild(path);
+			path = new GCPath(true);
+			pathTravel = true;
+
+			stats.push_back(layerStats);
+			layerStats = GCLayerStats();
+			layerTimes.push_back(0.0);
+
+			file->addChild(layer);
+			layer = new GCLayer(state.layerZ);
+			lineIndex.addLayer(lineNo);
+		}
+
+		lineIndex.addCommand(lineNo);
+		layerStats.addMove(gcCommand, move.delta[3], state.filamentXsectionArea);
+		addCommand(gcCommand, layer, path, pathTravel);
+
+		move.time = &gcCommand->time;
+		move.layerTime = &layerTimes.back();
+		planner.addMove(move);
+	}
+	layer->addChild(path);
+	stats.push_back(layerStats);
+	file->addChild(layer);
+
+	planner.flush();
+
+	for (size_t layerNo = 0; layerNo < stats.size(); ++layerNo) {
+		stats[layerNo].printTime = layerTimes[layerNo];
+		static_cast<GCLayer *>(file->child(static_cast<int>(layerNo)))->setStats(stats[layerNo]);
+	}
+
+	GC_TRACE_COUNTER("bytes parsed", bytesParsed);
+	GC_TRACE_COUNTER("commands", numCommands);
+
+}
+
+void GCModel::parseLayer(QTextStream &gcodeStream, ParseState state, double entrySpeed, double exitSpeed, GCLayer *layer) const
+{
+	// Lines come from layer start to next one, the start reported for the first command is expected.
+	GCPath *path = new GCPath(true);
+	bool pathTravel = true;
+	bool layerStart;
+
+	// Boundary speeds were planned by scan over neighbouring layers. Layer time comes from scan.
+	GCMotionPlanner planner;
+	planner.start(entrySpeed);
+
+	while (!gcodeStream.atEnd()) {
+		GCMotionPlanner::Move move;
+		GCCommand *gcCommand = parseCommand(gcodeStream.readLine(), state, layerStart, move);
+
+		if (gcCommand) {
+			addCommand(gcCommand, layer, path, pathTravel);
+
+			move.time = &gcCommand->time;
+			planner.addMove(move);
 		}
 	}
+
+	planner.flush(exitSpeed);
 	layer->addChild(path);
-	gcFile->addChild(layer);
+}
+
+GCCommand *GCModel::parseCommand(const QString &text, ParseState &state, bool &layerStart, GCMotionPlanner::Move &move) const
+{
+	// Parses moves (G0-G3) with positioning (G90, G91), extrusion (M82, M83) modes and position resets (G92).
+
+	layerStart = false;
+	move = GCMotionPlanner::Move();
+
+	// Letters in comments would be taken for parameters.
+	QString line = text.left(text.indexOf(';')).simplified().toUpper();
+	double param;
+
+	int mNum;
+	if (line.startsWith("M") && getGCParam(line, "M", mNum)) {
+		if (mNum == 82 || mNum == 83) {
+			state.relativeExtrusion = (mNum == 83);
+			state.extrusionModeSet = true;
+		}
+
+		return 0;
+	}
+
+	int gNum;
+	if (!line.startsWith("G") || !getGCParam(line, "G", gNum)) {
+		return 0;
+	}
+
+	// Arc parameters are kept only for G2/G3.
+	GCArcCommand *arcCommand = (gNum == 2 || gNum == 3) ? new GCArcCommand() : 0;
+	GCCommand *gcCommand = arcCommand ? arcCommand : new GCCommand();
+	gcCommand->z = state.z;
+	gcCommand->commandText = text;
+
+	if (gNum >= 0 && gNum <= 3) {
+		QPointF newPos = state.relativePositioning ? state.pos : QPointF();
+		double newZ = state.z;
+
+		if (getGCParam(line, "X", param)) {
+			newPos.setX(state.relativePositioning ? newPos.x() + param : param);
+		} else if (!state.relativePositioning) {
+			newPos.setX(state.pos.x());
+		}
+
+		if (getGCParam(line, "Y", param)) {
+			newPos.setY(state.relativePositioning ? newPos.y() + param : param);
+		} else if (!state.relativePositioning) {
+			newPos.setY(state.pos.y());
+		}
+
+		if (getGCParam(line, "Z", param)) {
+			newZ = state.relativePositioning ? state.z + param : param;
+		}
+
+		double e = 0.0;
+		if (getGCParam(line, "E", param)) {
+			e = state.relativeExtrusion ? param : param - state.e;
+			state.e = state.relativeExtrusion ? state.e + param : param;
+		}
+
+		// Feed rate is modal, shared by all moves.
+		if (getGCParam(line, "F", param) && param > 0.0) {
+			state.feedRate = param;
+		}
+
+		bool arc = arcCommand && setArc(line, gNum == 2, state.pos, newPos, arcCommand);
+		double length = arc ? gcCommand->length() : QLineF(state.pos, newPos).length();
+
+		// Layer starts with first extrusion at new height. Moves elsewhere without extrusion
+		// (z-hops, lifts before travel) stay in current layer.
+		if (e > 0.0 && length > 0.0 && newZ != state.layerZ) {
+			state.zRise = std::fabs(newZ - state.layerZ);
+			state.layerZ = newZ;
+			layerStart = true;
+		}
+
+		move.delta[0] = newPos.x() - state.pos.x();
+		move.delta[1] = newPos.y() - state.pos.y();
+		move.delta[2] = newZ - state.z;
+		move.delta[3] = e;
+		move.length = length;
+		move.feedRate = state.feedRate;
+
+		state.z = newZ;
+		gcCommand->z = newZ;
+
+		parsedGCData data;
+		data.z = newZ;
+		data.commandText = text;
+
+		createThread(state.pos, newPos, length, e, state.zRise, state.filamentXsectionArea, data);
+		gcCommand->thread = data.thread;
+		gcCommand->threadHeight = data.threadHeight;
+		gcCommand->threadWidth = data.threadWidth;
+
+		feedFilament(state, e, length);
+		state.pos = newPos;
+	} else if (gNum == 90 || gNum == 91) {
+		setPositioning(state, gNum == 91);
+	} else if (gNum == 92) {
+		// Given axes are reset, or all of them when none is given. Position is not changed physically.
+		bool all = true;
+
+		if (getGCParam(line, "X", param)) {
+			state.pos.setX(param);
+			all = false;
+		}
+
+		if (getGCParam(line, "Y", param)) {
+			state.pos.setY(param);
+			all = false;
+		}
+
+		if (getGCParam(line, "Z", param)) {
+			state.z = param;
+			all = false;
+		}
+
+		if (getGCParam(line, "E", param)) {
+			state.e = param;
+			all = false;
+		}
+
+		if (all) {
+			state.pos = QPointF();
+			state.z = 0.0;
+			state.e = 0.0;
+		}
+	}
+
+	return gcCommand;
+}
+
+void GCModel::setPositioning(ParseState &state, bool relative)
+{
+	state.relativePositioning = relative;
+
+	if (!state.extrusionModeSet) {
+		state.relativeExtrusion = relative;
+	}
+}
+
+void GCModel::feedFilament(ParseState &state, double e, double length)
+{
+	if (e > 0.0 && length > 0.0) {
+		state.primed = 0.0;
+	} else if (e > 0.0) {
+		state.primed += e;
+		state.primeFeedRate = state.feedRate;
+	} else if (e < 0.0) {
+		// Retraction takes back priming first, wipes retract while moving.
+		state.primed = qMax(0.0, state.primed + e);
+	}
+}
+
+bool GCModel::setArc(const QString &line, bool clockwise, const QPointF &begin, const QPointF &end, GCArcCommand *gcCommand)
+{
+	double i = 0.0;
+	double j = 0.0;
+	double r = 0.0;
+	QPointF center;
+
+	bool hasI = getGCParam(line, "I", i);
+	bool hasJ = getGCParam(line, "J", j);
+
+	if (hasI || hasJ) {
+		// Offsets are relative to start point in both positioning modes.
+		center = begin + QPointF(i, j);
+	} else if (getGCParam(line, "R", r)) {
+		// Center lies on the chord bisector, negative radius selects the longer arc.
+		QLineF chord(begin, end);
+		double halfChord = chord.length() / 2;
+
+		if (halfChord == 0.0 || std::fabs(r) < halfChord) {
+			return false;
+		}
+
+		double offset = std::sqrt(r * r - halfChord * halfChord);
+		QPointF normal(-chord.dy() / chord.length(), chord.dx() / chord.length());
+
+		if (clockwise == (r > 0)) {
+			offset = -offset;
+		}
+
+		center = (begin + end) / 2 + normal * offset;
+	} else {
+		return false;
+	}
+
+	double startAngle = std::atan2(begin.y() - center.y(), begin.x() - center.x());
+	double endAngle = std::atan2(end.y() - center.y(), end.x() - center.x());
+	double sweep = endAngle - startAngle;
+
+	// Equal start and end is full circle.
+	if (clockwise && sweep >= 0) {
+		sweep -= 2 * M_PI;
+	} else if (!clockwise && sweep <= 0) {
+		sweep += 2 * M_PI;
+	}
+
+	gcCommand->arcCenter = center;
+	gcCommand->arcRadius = QLineF(center, begin).length();
+	gcCommand->arcStartAngle = startAngle;
+	gcCommand->arcSweep = gcCommand->arcRadius > 0 ? sweep : 0.0;
 
+	return gcCommand->isArc();
 }
 
-void GCModel::createThread(const QPointF &begin, const QPointF &end, double e, double zRise, parsedGCData &data) const
+void GCModel::createThread(const QPointF &begin, const QPointF &end, double length, double e, double zRise,
+						   double filamentXsectionArea, parsedGCData &data)
 {
 	data.thread =  QLineF(begin, end);
 
-	if (e == 0.0 || data.thread.isNull()) {
+	// Retractions and moves without extrusion are travel moves.
+	if (e <= 0.0 || length == 0.0) {
 		data.threadWidth = 0;
 		data.threadHeight = 0;
 	} else {
-		double threadXsectioArea = m_filamentXsectionArea * e / data.thread.length();
+		double threadXsectioArea = filamentXsectionArea * e / length;
 
 		// http://hydraraptor.blogspot.com/2011/03/spot-on-flow-rate.html
 		data.threadWidth = (threadXsectioArea / zRise) - (M_PI * zRise / 4) + zRise;
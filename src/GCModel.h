@@ -3,13 +3,30 @@
 
 #include "GCTree/GCLayer.h"
 #include "GCTree/GCCommand.h"
+#include "GCTree/GCLayerStats.h"
+#include "GCJob.h"
+#include "GCMotionPlanner.h"
+#include "GCLineIndex.h"
 
 #include <QAbstractItemModel>
+#include <QByteArray>
+#include <QMap>
+#include <QScopedPointer>
+#include <QSharedPointer>
 #include <QVector>
 #include <QLineF>
 
+#include <list>
+#include <vector>
+
+class QFile;
+class QIODevice;
 class QTextStream;
 class GCFile;
+class GCArcCommand;
+class GCParseJob;
+class GCScanJob;
+class GCLayerParseJob;
 
 struct parsedGCData {
 	parsedGCData() : z(0.0), commandText(), threadWidth(0.0),
@@ -31,32 +48,157 @@ class GCModel : public QAbstractItemModel
 
 public:
 	GCModel(QObject *parent = 0);
+	virtual ~GCModel();
 
 	virtual QVariant data(const QModelIndex &index, int role) const;
 	Qt::ItemFlags flags(const QModelIndex &index) const;
 	virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
+	virtual bool hasChildren(const QModelIndex &parent = QModelIndex()) const;
+	virtual bool canFetchMore(const QModelIndex &parent) const;
+	virtual void fetchMore(const QModelIndex &parent);
 	int columnCount(const QModelIndex &parent = QModelIndex()) const;
 	QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
 	QModelIndex parent(const QModelIndex &index) const;
 
-	bool loadGCode(QTextStream &gcode, double filamentDiameter, double packingDensity);
+	// Parses on worker thread, model is reset once done. Takes ownership of opened device.
+	// Plain files are only scanned for layer starts, contents of a layer are parsed once fetched.
+	void loadGCode(QIODevice *gcode, double filamentDiameter, double packingDensity);
+	bool isLoading() const;
+	// Reading of last loaded file failed, e.g. it was truncated; model holds what was read before. Empty otherwise.
+	QString loadError() const;
+	// Parses layer if needed and marks it as recently used.
+	void fetchLayer(int layer);
+	// Parses layer on worker thread, it is inserted once done. Fetching it meanwhile takes the job over.
+	void prefetchLayer(int layer, GCJob::Priority priority = GCJob::Prefetch);
+	// Distinct layers are parsed in parallel, they stay loaded until each pin is released by unpinLayers().
+	void pinLayers(const std::vector<int> &layers);
+	void unpinLayers(const std::vector<int> &layers);
+	// Layer for jobs on any thread, valid until model is reset. Layer of mapped file is parsed into a copy
+	// owned by caller, loaded layers of model are left alone. Null when there is no such layer.
+	GCTreeItem *readLayer(int layer, QScopedPointer<GCLayer> &copy) const;
+	// Layers from first one on whose trees are estimated to fit the loaded layers budget together, at least one.
+	int layersWithinBudget(int firstLayer) const;
+	// Estimated heap memory of parsed tree, in bytes.
+	qint64 memoryUsage() const;
+	// Known for every layer once loaded, unloaded layers included.
+	const GCLayerStats &layerStats(int layer) const;
+	const GCLayerStats &totalStats() const;
+	// Contents of mapped plain file, null when the file was parsed whole.
+	const char *mappedData() const;
+	qint64 mappedSize() const;
+	QString mappedFileName() const;
+	// First byte of every layer in mapped file.
+	std::vector<qint64> layerOffsets() const;
+	// Commands setting machine state of the start of mapped layer, for files beginning with that layer.
+	QByteArray layerPreamble(int layer) const;
+	// Command of layer in file order, layer itself when there is no such command. Layer is fetched.
+	QModelIndex commandIndex(int layer, int command);
+	// Last command at or before line of the file counted from 1, invalid before the first one. Layer is fetched.
+	QModelIndex commandAtLine(qint64 line);
 
 	// GCModelIndex
 	static QModelIndex getLayerIndex(QModelIndex index);
 	static QModelIndex getCommandIndex(const QModelIndex &index);
 	static GCTreeItem::TYPE type(const QModelIndex &index);
 
+	// Byte level views of a line as parser sees it. Command lines give a command of the tree.
+	static bool isCommandLine(const char *line, const char *end);
+	// First value of parameter before comment, like getGCParam().
+	static bool scanParam(const char *line, const char *end, char letter, double &value);
+
 signals:
 	void layersNumChanged(int);
+	void loadProgress(int percent);
+
+private slots:
+	void parseFinished();
+	void scanFinished();
+	void prefetchFinished();
 
 private:
-	GCTreeItem *getItem(const QModelIndex &index) const;
-	void parseGCode(QTextStream &gcodeStream);
-	void createThread(const QPointF &begin, const QPointF &end, double e, double zRise, parsedGCData &data) const;
+	friend class GCParseJob;
+	friend class GCScanJob;
+	friend class GCLayerParseJob;
+
+	// Machine state carried from line to line.
+	struct ParseState {
+		ParseState()
+			: pos(), z(0.0), e(0.0), feedRate(1500.0), layerZ(0.0), zRise(0.0), primed(0.0), primeFeedRate(0.0),
+			  filamentXsectionArea(0.0), relativePositioning(false), relativeExtrusion(false), extrusionModeSet(false) {}
+
+		QPointF pos;
+		double z;
+		double e;						// Absolute extruder position.
+		double feedRate;				// mm/min, firmware default until first F.
+		double layerZ;
+		double zRise;					// Height of current layer above previous one.
+		double primed;					// mm of filament fed back in place since retraction, before next extrusion.
+		double primeFeedRate;			// mm/min of last such feed.
+		double filamentXsectionArea;	// mm^2 times packing density, as set when the file was loaded.
+		bool relativePositioning;
+		bool relativeExtrusion;
+		bool extrusionModeSet;			// M82 or M83 was given, otherwise E follows G90 and G91.
+	};
+
+	// Layer of mapped file, parsed when its contents are asked for.
+	struct LazyLayer {
+		LazyLayer(qint64 offset, double z, const ParseState &state)
+			: offset(offset), z(z), state(state), entrySpeed(0.0), loaded(false), pins(0), memoryUsage(0), lruPosition() {}
+
+		qint64 offset;					// First byte of layer in file.
+		double z;
+		ParseState state;				// State before first line of layer.
+		double entrySpeed;				// mm/s of first move, as planned over layer boundary by scan.
+		bool loaded;
+		int pins;						// Pinned layer is left out of LRU, it is never unloaded.
+		qint64 memoryUsage;
+		std::list<int>::iterator lruPosition;
+	};
 
-	double m_filamentXsectionArea;
+	GCTreeItem *getItem(const QModelIndex &index) const;
+	void cancelLoad();
+	void clearLazyLayers();
+	int lazyLayerRow(const QModelIndex &index) const;
+	void insertLayer(int layer, GCLayer *parsed);
+	void unloadLayer(int layer);
+	// Least recently used layers are unloaded until loaded ones fit the budget.
+	void trimLayers();
+	void cancelPrefetches();
+	void setLayerStats(const std::vector<GCLayerStats> &stats);
+	void scanLayers(const char *data, qint64 size, double filamentXsectionArea, std::vector<LazyLayer> &layers,
+					std::vector<GCLayerStats> &stats, GCLineIndex &lineIndex, GCJob *job) const;
+	void parseLazyLayer(int layer, GCLayer *target) const;
+	void parseGCode(QTextStream &gcodeStream, double filamentXsectionArea, GCFile *gcFile, std::vector<GCLayerStats> &stats,
+					GCLineIndex &lineIndex, GCJob *job) const;
+	// Speeds at layer boundaries come from scan, moves of layer are planned between them.
+	void parseLayer(QTextStream &gcodeStream, ParseState state, double entrySpeed, double exitSpeed, GCLayer *layer) const;
+	// Move is filled for G0-G3, filament fed is its E delta, negative for retraction. Other commands leave it empty.
+	GCCommand *parseCommand(const QString &text, ParseState &state, bool &layerStart, GCMotionPlanner::Move &move) const;
+	static void createThread(const QPointF &begin, const QPointF &end, double length, double e, double zRise,
+							 double filamentXsectionArea, parsedGCData &data);
+	static bool setArc(const QString &line, bool clockwise, const QPointF &begin, const QPointF &end, GCArcCommand *gcCommand);
+	// G90 and G91, E follows them unless M82 or M83 was given (as in Marlin).
+	static void setPositioning(ParseState &state, bool relative);
+	// Follows retraction and priming between extrusions, e is filament fed by move of given length.
+	static void feedFilament(ParseState &state, double e, double length);
 
 	GCFile *gcFile;
+	qint64 m_memoryUsage;
+	QSharedPointer<GCParseJob> m_parseJob;
+	QSharedPointer<GCScanJob> m_scanJob;
+
+	QScopedPointer<QFile> m_mappedFile;	// Source of lazy layers, null when whole file was parsed at once.
+	const char *m_mappedData;
+	qint64 m_mappedSize;
+	std::vector<LazyLayer> m_lazyLayers;
+	std::list<int> m_lru;				// Loaded layers which aren't pinned, most recently used first.
+	qint64 m_loadedMemory;				// Estimated memory of loaded layers, pinned included.
+	QMap<int, QSharedPointer<GCLayerParseJob> > m_prefetchJobs;
+
+	std::vector<GCLayerStats> m_layerStats;
+	GCLayerStats m_totalStats;
+	GCLineIndex m_lineIndex;
+	QString m_loadError;
 };
 
 #endif // GCLISTVIEW_H
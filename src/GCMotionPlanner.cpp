@@ -0,0 +1,197 @@
+#include "GCMotionPlanner.h"
+
+#include <QtGlobal>
+
+#include <cmath>
+
+GCMotionPlanner::Limits::Limits()
+	: acceleration(3000),
+	  retractAcceleration(3000),
+	  junctionDeviation(0.013),
+	  minimumSpeed(0.05),
+	  bufferSize(16)
+{
+	const double feedRates[4] = {300, 300, 5, 25};
+	const double accelerations[4] = {3000, 3000, 100, 10000};
+
+	for (int axis = 0; axis < 4; ++axis) {
+		maxFeedRate[axis] = feedRates[axis];
+		maxAcceleration[axis] = accelerations[axis];
+	}
+}
+
+GCMotionPlanner::GCMotionPlanner(const Limits &limits)
+	: m_limits(limits),
+	  m_blocks(),
+	  m_committedExitSpeed(0.0),
+	  m_startSpeed(-1.0),
+	  m_previousNominalSpeed(0.0),
+	  m_hasPrevious(false),
+	  m_totalTime(0.0)
+{
+	m_previousUnit[0] = m_previousUnit[1] = m_previousUnit[2] = 0.0;
+}
+
+void GCMotionPlanner::start(double entrySpeed)
+{
+	m_committedExitSpeed = entrySpeed;
+	m_startSpeed = entrySpeed;
+}
+
+void GCMotionPlanner::addMove(const Move &move)
+{
+	double chord = std::sqrt(move.delta[0] * move.delta[0] + move.delta[1] * move.delta[1] + move.delta[2] * move.delta[2]);
+	bool headMove = chord > 0.0;
+
+	Block block;
+	block.length = headMove ? qMax(move.length, chord) : std::fabs(move.delta[3]);
+	block.time = move.time;
+	block.layerTime = move.layerTime;
+	block.plannedEntrySpeed = move.entrySpeed;
+
+	if (block.length == 0.0) {
+		return;
+	}
+
+	for (int axis = 0; axis < 3; ++axis) {
+		block.unit[axis] = headMove ? move.delta[axis] / chord : 0.0;
+	}
+
+	// Axes are limited in proportion to their share of the move.
+	block.nominalSpeed = move.feedRate / 60;
+	block.acceleration = headMove ? m_limits.acceleration : m_limits.retractAcceleration;
+
+	for (int axis = 0; axis < 4; ++axis) {
+		double share = std::fabs(move.delta[axis]) / block.length;
+
+		if (share > 0.0) {
+			block.nominalSpeed = qMin(block.nominalSpeed, m_limits.maxFeedRate[axis] / share);
+			block.acceleration = qMin(block.acceleration, m_limits.maxAcceleration[axis] / share);
+		}
+	}
+
+	if (block.nominalSpeed <= 0.0) {
+		block.nominalSpeed = m_limits.minimumSpeed;
+	}
+
+	// Junction deviation: corner is taken at speed at which centripetal acceleration of an arc
+	// deviating junctionDeviation from the corner stays within acceleration.
+	block.maxEntrySpeed = m_limits.minimumSpeed;
+
+	if (headMove && m_hasPrevious) {
+		double cosTheta = -(m_previousUnit[0] * block.unit[0] + m_previousUnit[1] * block.unit[1]
+							+ m_previousUnit[2] * block.unit[2]);
+
+		if (cosTheta < 0.999999) {
+			cosTheta = qMax(cosTheta, -0.999999);
+			double sinThetaD2 = std::sqrt(0.5 * (1 - cosTheta));
+			double speed = std::sqrt(block.acceleration * m_limits.junctionDeviation * sinThetaD2 / (1 - sinThetaD2));
+
+			block.maxEntrySpeed = qMax(m_limits.minimumSpeed, qMin(speed, qMin(block.nominalSpeed, m_previousNominalSpeed)));
+		}
+	}
+
+	// Junction with moves planned elsewhere was limited there.
+	if (m_startSpeed >= 0.0) {
+		block.maxEntrySpeed = qMax(m_limits.minimumSpeed, m_startSpeed);
+		m_startSpeed = -1.0;
+	}
+
+	block.entrySpeed = block.maxEntrySpeed;
+	m_blocks.push_back(block);
+
+	m_hasPrevious = headMove;
+	m_previousNominalSpeed = block.nominalSpeed;
+
+	for (int axis = 0; axis < 3; ++axis) {
+		m_previousUnit[axis] = block.unit[axis];
+	}
+
+	if (static_cast<int>(m_blocks.size()) >= m_limits.bufferSize) {
+		plan(0.0);
+		commit(0.0);
+	}
+}
+
+void GCMotionPlanner::flush(double exitSpeed)
+{
+	plan(exitSpeed);
+
+	while (!m_blocks.empty()) {
+		commit(exitSpeed);
+	}
+
+	m_committedExitSpeed = 0.0;
+	m_startSpeed = -1.0;
+	m_hasPrevious = false;
+}
+
+double GCMotionPlanner::totalTime() const
+{
+	return m_totalTime;
+}
+
+void GCMotionPlanner::plan(double exitSpeed)
+{
+	if (m_blocks.empty()) {
+		return;
+	}
+
+	// Buffer is planned to leave its last block at exitSpeed, moves which are not queued yet are unknown.
+	for (size_t i = m_blocks.size(); i-- > 0;) {
+		Block &block = m_blocks[i];
+		block.entrySpeed = qMin(block.maxEntrySpeed, std::sqrt(exitSpeed * exitSpeed + 2 * block.acceleration * block.length));
+		exitSpeed = block.entrySpeed;
+	}
+
+	// Oldest block started already.
+	m_blocks[0].entrySpeed = qMin(m_blocks[0].entrySpeed, m_committedExitSpeed);
+
+	for (size_t i = 1; i < m_blocks.size(); ++i) {
+		const Block &previous = m_blocks[i - 1];
+		double reachable = std::sqrt(previous.entrySpeed * previous.entrySpeed + 2 * previous.acceleration * previous.length);
+
+		m_blocks[i].entrySpeed = qMin(m_blocks[i].entrySpeed, reachable);
+	}
+}
+
+void GCMotionPlanner::commit(double exitSpeed)
+{
+	const Block &block = m_blocks.front();
+	exitSpeed = m_blocks.size() > 1 ? m_blocks[1].entrySpeed : exitSpeed;
+	double time = trapezoidTime(block.length, block.entrySpeed, exitSpeed, block.nominalSpeed, block.acceleration);
+
+	if (block.time) {
+		*block.time += time;
+	}
+
+	if (block.layerTime) {
+		*block.layerTime += time;
+	}
+
+	if (block.plannedEntrySpeed) {
+		*block.plannedEntrySpeed = block.entrySpeed;
+	}
+
+	m_totalTime += time;
+	m_committedExitSpeed = exitSpeed;
+	m_blocks.pop_front();
+}
+
+double GCMotionPlanner::trapezoidTime(double length, double entrySpeed, double exitSpeed, double nominalSpeed,
+									 double acceleration)
+{
+	double accelerateDistance = (nominalSpeed * nominalSpeed - entrySpeed * entrySpeed) / (2 * acceleration);
+	double decelerateDistance = (nominalSpeed * nominalSpeed - exitSpeed * exitSpeed) / (2 * acceleration);
+
+	if (accelerateDistance + decelerateDistance <= length) {
+		return (nominalSpeed - entrySpeed) / acceleration + (nominalSpeed - exitSpeed) / acceleration
+				+ (length - accelerateDistance - decelerateDistance) / nominalSpeed;
+	}
+
+	// Nominal speed isn't reached, speed peaks where acceleration meets deceleration.
+	double peakSpeed = std::sqrt((2 * acceleration * length + entrySpeed * entrySpeed + exitSpeed * exitSpeed) / 2);
+	peakSpeed = qMax(peakSpeed, qMax(entrySpeed, exitSpeed));
+
+	return (peakSpeed - entrySpeed) / acceleration + (peakSpeed - exitSpeed) / acceleration;
+}
@@ -0,0 +1,76 @@
+#ifndef GCMOTIONPLANNER_H
+#define GCMOTIONPLANNER_H
+
+#include <deque>
+
+// Estimates time of moves the way firmware plans them: trapezoidal speed profiles limited by acceleration,
+// corner speeds by junction deviation, and speeds planned over a look-ahead buffer of queued moves.
+// Moves stream through, time of a move is known once it leaves the buffer.
+class GCMotionPlanner
+{
+public:
+	// Defaults follow stock Marlin configuration.
+	struct Limits {
+		Limits();
+
+		double maxFeedRate[4];			// mm/s of X, Y, Z and E axis.
+		double maxAcceleration[4];		// mm/s^2 of X, Y, Z and E axis.
+		double acceleration;			// mm/s^2 of moves of the head.
+		double retractAcceleration;		// mm/s^2 of moves of extruder alone.
+		double junctionDeviation;		// mm.
+		double minimumSpeed;			// mm/s, junction speed where direction isn't known.
+		int bufferSize;					// Moves planned together.
+	};
+
+	struct Move {
+		Move()
+			: length(0.0), feedRate(0.0), time(0), layerTime(0), entrySpeed(0) {
+			delta[0] = delta[1] = delta[2] = delta[3] = 0.0;
+		}
+
+		double delta[4];				// mm of X, Y, Z and E axis.
+		double length;					// mm of head path, longer than chord for arcs.
+		double feedRate;				// mm/min, as given by F parameter.
+		double *time;					// Time of move in s is added to both, when not null.
+		double *layerTime;
+		double *entrySpeed;				// Planned entry speed in mm/s is stored, when not null.
+	};
+
+	explicit GCMotionPlanner(const Limits &limits = Limits());
+
+	// Next move is entered at given speed instead of from rest, e.g. as planned over preceding moves elsewhere.
+	void start(double entrySpeed);
+	void addMove(const Move &move);
+	// Remaining moves are planned to leave at given speed, stopping by default.
+	void flush(double exitSpeed = 0.0);
+	double totalTime() const;
+
+private:
+	struct Block {
+		double length;					// mm of head path, or of extruder alone.
+		double unit[3];					// Direction of head, zero for extruder alone.
+		double nominalSpeed;			// mm/s.
+		double acceleration;			// mm/s^2.
+		double maxEntrySpeed;			// mm/s, junction limit with previous block.
+		double entrySpeed;				// mm/s, planned.
+		double *time;
+		double *layerTime;
+		double *plannedEntrySpeed;
+	};
+
+	void plan(double exitSpeed);
+	void commit(double exitSpeed);
+	static double trapezoidTime(double length, double entrySpeed, double exitSpeed, double nominalSpeed,
+								double acceleration);
+
+	Limits m_limits;
+	std::deque<Block> m_blocks;
+	double m_committedExitSpeed;		// Entry speed of oldest block, fixed when the block before it left.
+	double m_startSpeed;				// Entry speed of next block, negative when it follows previous one.
+	double m_previousUnit[3];
+	double m_previousNominalSpeed;
+	bool m_hasPrevious;					// Previous block moved the head.
+	double m_totalTime;
+};
+
+#endif // GCMOTIONPLANNER_H
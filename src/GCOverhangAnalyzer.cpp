@@ -0,0 +1,284 @@
+#include "GCOverhangAnalyzer.h"
+
+#include "GCModel.h"
+#include "GCJobGroup.h"
+#include "GCTreeWalker.h"
+#include "GCTrace.h"
+#include "GCTree/GCCommand.h"
+#include "GCTree/GCArcCommand.h"
+
+#include <QLineF>
+#include <QRectF>
+
+#include <cmath>
+#include <cstring>
+
+// Edge of footprint raster cell, mm.
+const double overhangCellSize = 0.1;
+
+// Score from which an extrusion counts as overhanging.
+const double overhangThreshold = 0.5;
+
+// Straight pieces of the move, arcs are tessellated finer than a cell.
+static void movePoints(const GCCommand *gcCommand, std::vector<QPointF> &points)
+{
+	points.clear();
+
+	if (gcCommand->isArc()) {
+		static_cast<const GCArcCommand *>(gcCommand)->arcPolyline(overhangCellSize / 2, points);
+	} else {
+		points.push_back(gcCommand->thread.p1());
+		points.push_back(gcCommand->thread.p2());
+	}
+}
+
+// Compares one layer with the layer below, scores of the upper layer are kept in the job.
+// Both layers are read by the job itself and released when it ends.
+class GCOverhangJob : public GCJob
+{
+public:
+	GCOverhangJob(const GCModel *model, int layer)
+		: GCJob(),
+		  layer(layer),
+		  overhangs(),
+		  numOverhangs(0),
+		  numExtrusions(0),
+		  m_model(model),
+		  m_bounds(),
+		  m_columns(0),
+		  m_rows(0),
+		  m_footprint()
+	{
+	}
+
+	int layer;						// Layer of upper.
+	std::vector<float> overhangs;	// Scores of extrusions of upper layer, in tree order.
+	int numOverhangs;
+	int numExtrusions;
+
+protected:
+	virtual void run()
+	{
+		GC_TRACE_SCOPE("overhangs");
+
+		QScopedPointer<GCLayer> lowerCopy;
+		QScopedPointer<GCLayer> upperCopy;
+		GCTreeItem *lowerLayer = m_model->readLayer(layer - 1, lowerCopy);
+		GCTreeItem *upperLayer = m_model->readLayer(layer, upperCopy);
+
+		if (!lowerLayer || !upperLayer || isCanceled()) {
+			return;
+		}
+
+		std::vector<GCCommand *> lower;
+		std::vector<GCCommand *> upper;
+		GCTreeWalker::collectExtrusions(lowerLayer, lower);
+		GCTreeWalker::collectExtrusions(upperLayer, upper);
+
+		rasterize(lower);
+
+		std::vector<QPointF> points;
+
+		overhangs.reserve(upper.size());
+
+		for (size_t commandNo = 0; commandNo < upper.size() && !isCanceled(); ++commandNo) {
+			movePoints(upper[commandNo], points);
+
+			overhangs.push_back(static_cast<float>(unsupportedFraction(points)));
+			numOverhangs += overhangs.back() >= overhangThreshold ? 1 : 0;
+		}
+
+		numExtrusions = static_cast<int>(upper.size());
+
+		// Raster of large layers is big, it isn't kept after the job.
+		std::vector<unsigned char>().swap(m_footprint);
+	}
+
+private:
+	void rasterize(const std::vector<GCCommand *> &extrusions)
+	{
+		std::vector<QPointF> points;
+
+		for (size_t commandNo = 0; commandNo < extrusions.size(); ++commandNo) {
+			movePoints(extrusions[commandNo], points);
+			double halfWidth = extrusions[commandNo]->threadWidth / 2;
+
+			for (size_t pointNo = 0; pointNo < points.size(); ++pointNo) {
+				QRectF pointRect(points[pointNo] - QPointF(halfWidth, halfWidth), QSizeF(2 * halfWidth, 2 * halfWidth));
+				m_bounds = m_bounds.isNull() ? pointRect : m_bounds.united(pointRect);
+			}
+		}
+
+		m_columns = static_cast<int>(std::ceil(m_bounds.width() / overhangCellSize)) + 1;
+		m_rows = static_cast<int>(std::ceil(m_bounds.height() / overhangCellSize)) + 1;
+		m_footprint.assign(static_cast<size_t>(m_columns) * m_rows, 0);
+
+		for (size_t commandNo = 0; commandNo < extrusions.size() && !isCanceled(); ++commandNo) {
+			movePoints(extrusions[commandNo], points);
+
+			for (size_t pointNo = 1; pointNo < points.size(); ++pointNo) {
+				stamp(points[pointNo - 1], points[pointNo], extrusions[commandNo]->threadWidth / 2);
+			}
+		}
+	}
+
+	// Cells within half width of the piece are covered, discs are stamped along it a cell apart.
+	void stamp(const QPointF &begin, const QPointF &end, double halfWidth)
+	{
+		int radius = static_cast<int>(halfWidth / overhangCellSize);
+		int numSteps = qMax(1, static_cast<int>(std::ceil(QLineF(begin, end).length() / overhangCellSize)));
+
+		for (int step = 0; step <= numSteps; ++step) {
+			QPointF center = begin + (end - begin) * step / numSteps;
+			int column = cellColumn(center.x());
+			int row = cellRow(center.y());
+
+			for (int dy = -radius; dy <= radius; ++dy) {
+				int dx = static_cast<int>(std::sqrt(static_cast<double>(radius * radius - dy * dy)));
+				int first = qMax(0, column - dx);
+				int last = qMin(m_columns - 1, column + dx);
+
+				if (row + dy < 0 || row + dy >= m_rows || first > last) {
+					continue;
+				}
+
+				std::memset(&m_footprint[static_cast<size_t>(row + dy) * m_columns + first], 1, last - first + 1);
+			}
+		}
+	}
+
+	// Share of the centre line outside the footprint. Thread may hang over the edge by half its width, about 45 degrees.
+	double unsupportedFraction(const std::vector<QPointF> &points) const
+	{
+		int numSamples = 0;
+		int numUnsupported = 0;
+
+		for (size_t pointNo = 1; pointNo < points.size(); ++pointNo) {
+			const QPointF &begin = points[pointNo - 1];
+			const QPointF &end = points[pointNo];
+			int numSteps = qMax(1, static_cast<int>(std::ceil(QLineF(begin, end).length() / overhangCellSize)));
+
+			for (int step = 0; step <= numSteps; ++step) {
+				QPointF sample = begin + (end - begin) * step / numSteps;
+				++numSamples;
+				numUnsupported += isCovered(sample) ? 0 : 1;
+			}
+		}
+
+		return numSamples ? static_cast<double>(numUnsupported) / numSamples : 0.0;
+	}
+
+	bool isCovered(const QPointF &point) const
+	{
+		int column = cellColumn(point.x());
+		int row = cellRow(point.y());
+
+		if (column < 0 || column >= m_columns || row < 0 || row >= m_rows) {
+			return false;
+		}
+
+		return m_footprint[static_cast<size_t>(row) * m_columns + column] != 0;
+	}
+
+	int cellColumn(double x) const
+	{
+		return static_cast<int>(std::floor((x - m_bounds.left()) / overhangCellSize + 0.5));
+	}
+
+	int cellRow(double y) const
+	{
+		return static_cast<int>(std::floor((y - m_bounds.top()) / overhangCellSize + 0.5));
+	}
+
+	const GCModel *m_model;
+	QRectF m_bounds;
+	int m_columns;
+	int m_rows;
+	std::vector<unsigned char> m_footprint;
+};
+
+GCOverhangAnalyzer::GCOverhangAnalyzer(GCModel *model, QObject *parent)
+	: QObject(parent),
+	  m_model(model),
+	  m_jobs(0),
+	  m_overhangs()
+{
+	m_jobs = new GCJobGroup(this);
+	connect(m_jobs, SIGNAL(progressChanged(int)), this, SIGNAL(progressChanged(int)));
+	connect(m_jobs, SIGNAL(finished()), this, SLOT(jobsFinished()));
+
+	// Jobs read the tree, it must not change under them.
+	connect(m_model, SIGNAL(modelAboutToBeReset()), this, SLOT(forget()));
+}
+
+GCOverhangAnalyzer::~GCOverhangAnalyzer()
+{
+	cancel();
+}
+
+void GCOverhangAnalyzer::start()
+{
+	cancel();
+
+	int numLayers = m_model->rowCount();
+	m_overhangs.assign(numLayers, std::vector<float>());
+	int firstLayer = 0;
+
+	// Lowest printed layer lies on the bed.
+	while (firstLayer < numLayers && !m_model->layerStats(firstLayer).numExtrusions) {
+		++firstLayer;
+	}
+
+	// Jobs read their own layer pairs, loaded layers of model aren't touched.
+	for (int layer = firstLayer + 1; layer < numLayers; ++layer) {
+		m_jobs->submit(QSharedPointer<GCJob>(new GCOverhangJob(m_model, layer)));
+	}
+
+	if (!m_jobs->size()) {
+		emit finished(0, 0);
+	}
+}
+
+void GCOverhangAnalyzer::cancel()
+{
+	m_jobs->cancel();
+}
+
+bool GCOverhangAnalyzer::isRunning() const
+{
+	return m_jobs->isRunning();
+}
+
+double GCOverhangAnalyzer::overhang(int layer, int extrusion) const
+{
+	if (layer < 0 || static_cast<size_t>(layer) >= m_overhangs.size()) {
+		return 0.0;
+	}
+
+	const std::vector<float> &overhangs = m_overhangs[layer];
+
+	return extrusion >= 0 && static_cast<size_t>(extrusion) < overhangs.size() ? overhangs[extrusion] : 0.0;
+}
+
+void GCOverhangAnalyzer::forget()
+{
+	cancel();
+	m_overhangs.clear();
+}
+
+void GCOverhangAnalyzer::jobsFinished()
+{
+	int numOverhangs = 0;
+	int numExtrusions = 0;
+
+	for (int i = 0; i < m_jobs->size(); ++i) {
+		GCOverhangJob *job = static_cast<GCOverhangJob *>(m_jobs->job(i));
+
+		m_overhangs[job->layer].swap(job->overhangs);
+		numOverhangs += job->numOverhangs;
+		numExtrusions += job->numExtrusions;
+	}
+
+	cancel();
+	emit finished(numOverhangs, numExtrusions);
+}
@@ -0,0 +1,48 @@
+#ifndef GCOVERHANGANALYZER_H
+#define GCOVERHANGANALYZER_H
+
+#include <QObject>
+
+#include <vector>
+
+class GCModel;
+class GCJobGroup;
+
+// Scores every extrusion by how much of it lies outside material of the layer below.
+// Footprint of the lower layer is rasterized once per layer pair, pairs are compared by jobs in parallel.
+// Scores are kept by layer and extrusion number, jobs read their layers themselves and release them when done.
+class GCOverhangAnalyzer : public QObject
+{
+	Q_OBJECT
+	Q_DISABLE_COPY(GCOverhangAnalyzer)
+
+public:
+	explicit GCOverhangAnalyzer(GCModel *model, QObject *parent = 0);
+	virtual ~GCOverhangAnalyzer();
+
+	void start();
+	bool isRunning() const;
+	// Share of extrusion not over the layer below, 0 when not scored.
+	// Extrusions are numbered within layer in tree order, like GCLayerStats counts them.
+	double overhang(int layer, int extrusion) const;
+
+public slots:
+	void cancel();
+
+signals:
+	void progressChanged(int percent);
+	// Extrusions overhanging at least half of their length.
+	void finished(int numOverhangs, int numExtrusions);
+
+private slots:
+	void jobsFinished();
+	// Scores belong to the file being reset.
+	void forget();
+
+private:
+	GCModel *m_model;
+	GCJobGroup *m_jobs;
+	std::vector<std::vector<float> > m_overhangs;	// Scores by layer and extrusion.
+};
+
+#endif // GCOVERHANGANALYZER_H
@@ -0,0 +1,100 @@
+#include "GCPathSimplifier.h"
+#include "GCTree/GCCommand.h"
+
+#include <QVector2D>
+
+#include <cmath>
+
+// Limits the quadratic tolerance check, runs longer than this are split.
+const size_t maxRunLength = 64;
+
+static double distanceToSegment(const QPointF &point, const QLineF &segment)
+{
+	QVector2D direction(segment.p2() - segment.p1());
+	QVector2D offset(point - segment.p1());
+
+	double lengthSquared = direction.lengthSquared();
+	double t = lengthSquared > 0 ? QVector2D::dotProduct(offset, direction) / lengthSquared : 0;
+	t = qBound(0.0, t, 1.0);
+
+	return (offset - direction * t).length();
+}
+
+static bool fuzzyEqual(double a, double b)
+{
+	return std::fabs(a - b) <= 1e-6 * qMax(1.0, qMax(std::fabs(a), std::fabs(b)));
+}
+
+GCPathSimplifier::GCPathSimplifier(double tolerance)
+	: m_tolerance(tolerance)
+{
+}
+
+void GCPathSimplifier::setTolerance(double tolerance)
+{
+	m_tolerance = tolerance;
+}
+
+double GCPathSimplifier::tolerance() const
+{
+	return m_tolerance;
+}
+
+void GCPathSimplifier::simplify(const std::vector<const GCCommand *> &commands, std::vector<Thread> &threads) const
+{
+	size_t first = 0;
+
+	while (first < commands.size()) {
+		size_t end = first + 1;
+
+		while (end < commands.size() && end - first < maxRunLength && canMerge(commands, first, end)) {
+			++end;
+		}
+
+		Thread thread;
+		thread.line = QLineF(commands[first]->thread.p1(), commands[end - 1]->thread.p2());
+		thread.width = commands[first]->threadWidth;
+		thread.height = commands[first]->threadHeight;
+		thread.z = commands[first]->z;
+		thread.firstCommand = first;
+		thread.numCommands = end - first;
+		thread.segments = static_cast<double>(end - first);
+		threads.push_back(thread);
+
+		first = end;
+	}
+}
+
+bool GCPathSimplifier::canMerge(const std::vector<const GCCommand *> &commands, size_t first, size_t next) const
+{
+	const GCCommand *start = commands[first];
+	const GCCommand *candidate = commands[next];
+
+	if (!fuzzyEqual(start->threadWidth, candidate->threadWidth)
+			|| !fuzzyEqual(start->threadHeight, candidate->threadHeight)
+			|| !fuzzyEqual(start->z, candidate->z)) {
+		return false;
+	}
+
+	if (QLineF(commands[next - 1]->thread.p2(), candidate->thread.p1()).length() > m_tolerance) {
+		return false;
+	}
+
+	QLineF chord(start->thread.p1(), candidate->thread.p2());
+	QVector2D chordDirection(chord.p2() - chord.p1());
+
+	for (size_t i = first; i <= next; ++i) {
+		const QLineF &thread = commands[i]->thread;
+
+		// Merged commands must all go forward, otherwise the chord would hide a reversal.
+		if (QVector2D::dotProduct(QVector2D(thread.p2() - thread.p1()), chordDirection) <= 0) {
+			return false;
+		}
+
+		if (i < next && distanceToSegment(thread.p2(), chord) > m_tolerance) {
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,44 @@
+#ifndef GCPATHSIMPLIFIER_H
+#define GCPATHSIMPLIFIER_H
+
+#include <QLineF>
+
+#include <vector>
+
+class GCCommand;
+
+// Merges runs of nearly collinear extrusions of equal width and height into single threads.
+class GCPathSimplifier
+{
+public:
+	struct Thread {
+		Thread()
+			: line(), width(0.0), height(0.0), z(0.0), firstCommand(0), numCommands(0), segments(0.0) {}
+
+		bool isNull() const {
+			return numCommands == 0;
+		}
+
+		QLineF line;
+		double width;
+		double height;
+		double z;
+		size_t firstCommand;		// Position of first merged command in simplified sequence.
+		size_t numCommands;
+		double segments;			// Segment IDs spanned, a piece of tessellated arc spans only a fraction.
+	};
+
+	explicit GCPathSimplifier(double tolerance = 0.02);
+
+	void setTolerance(double tolerance);
+	double tolerance() const;
+
+	void simplify(const std::vector<const GCCommand *> &commands, std::vector<Thread> &threads) const;
+
+private:
+	bool canMerge(const std::vector<const GCCommand *> &commands, size_t first, size_t next) const;
+
+	double m_tolerance;				// Largest distance of merged command ends from the chord, mm.
+};
+
+#endif // GCPATHSIMPLIFIER_H
@@ -0,0 +1,113 @@
+#include "GCSearchPanel.h"
+
+#include "GCModel.h"
+#include "GCSearcher.h"
+
+#include <QComboBox>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QLineEdit>
+#include <QListWidget>
+#include <QPushButton>
+#include <QVBoxLayout>
+
+// Item data of results.
+const int layerRole = Qt::UserRole;
+const int commandRole = Qt::UserRole + 1;
+
+GCSearchPanel::GCSearchPanel(GCModel *model, QWidget *parent)
+	: QWidget(parent),
+	  m_searcher(0),
+	  m_queryEdit(0),
+	  m_modeCBox(0),
+	  m_resultList(0),
+	  m_statusLabel(0)
+{
+	m_searcher = new GCSearcher(model, this);
+
+	m_queryEdit = new QLineEdit();
+	m_modeCBox = new QComboBox();
+	// Item order follows GCSearcher::Mode.
+	m_modeCBox->addItem(tr("Text"));
+	m_modeCBox->addItem(tr("Regular expression"));
+	m_modeCBox->addItem(tr("Parameter (e.g. F>6000)"));
+	QPushButton *findBtn = new QPushButton(tr("&Find"));
+	m_resultList = new QListWidget();
+	m_resultList->setUniformItemSizes(true);
+	m_statusLabel = new QLabel();
+
+	QHBoxLayout *queryLayout = new QHBoxLayout();
+	queryLayout->addWidget(m_queryEdit);
+	queryLayout->addWidget(findBtn);
+
+	QVBoxLayout *vLayout = new QVBoxLayout();
+	vLayout->addLayout(queryLayout);
+	vLayout->addWidget(m_modeCBox);
+	vLayout->addWidget(m_resultList);
+	vLayout->addWidget(m_statusLabel);
+	setLayout(vLayout);
+
+	connect(m_queryEdit, SIGNAL(returnPressed()), this, SLOT(find()));
+	connect(findBtn, SIGNAL(clicked()), this, SLOT(find()));
+	connect(m_resultList, SIGNAL(itemActivated(QListWidgetItem *)), this, SLOT(itemActivated(QListWidgetItem *)));
+	connect(m_resultList, SIGNAL(itemClicked(QListWidgetItem *)), this, SLOT(itemActivated(QListWidgetItem *)));
+	connect(m_searcher, SIGNAL(resultsAdded(int, int)), this, SLOT(resultsAdded(int, int)));
+	connect(m_searcher, SIGNAL(progressChanged(int)), this, SLOT(searchProgress(int)));
+	connect(m_searcher, SIGNAL(finished(int, bool)), this, SLOT(searchFinished(int, bool)));
+	// Results point to layers and commands of the loaded file.
+	connect(model, SIGNAL(modelReset()), this, SLOT(clear()));
+}
+
+void GCSearchPanel::find()
+{
+	clear();
+
+	QString error = m_searcher->start(m_queryEdit->text(), static_cast<GCSearcher::Mode>(m_modeCBox->currentIndex()));
+
+	if (!error.isEmpty()) {
+		m_statusLabel->setText(error);
+	} else if (m_searcher->isRunning()) {
+		searchProgress(0);
+	}
+}
+
+void GCSearchPanel::clear()
+{
+	m_searcher->cancel();
+	m_resultList->clear();
+	m_statusLabel->clear();
+}
+
+void GCSearchPanel::resultsAdded(int first, int count)
+{
+	const std::vector<GCSearcher::Result> &results = m_searcher->results();
+
+	for (int i = first; i < first + count; ++i) {
+		const GCSearcher::Result &result = results[i];
+		QString text = result.line >= 0 ? tr("Layer %1, line %2: %3").arg(result.layer + 1).arg(result.line).arg(result.text)
+							   : tr("Layer %1: %2").arg(result.layer + 1).arg(result.text);
+
+		QListWidgetItem *item = new QListWidgetItem(text, m_resultList);
+		item->setData(layerRole, result.layer);
+		item->setData(commandRole, result.command);
+	}
+}
+
+void GCSearchPanel::searchProgress(int percent)
+{
+	m_statusLabel->setText(tr("Searching... %1%").arg(percent));
+}
+
+void GCSearchPanel::searchFinished(int numResults, bool truncated)
+{
+	if (truncated) {
+		m_statusLabel->setText(tr("First %1 results").arg(numResults));
+	} else {
+		m_statusLabel->setText(tr("%1 results").arg(numResults));
+	}
+}
+
+void GCSearchPanel::itemActivated(QListWidgetItem *item)
+{
+	emit commandActivated(item->data(layerRole).toInt(), item->data(commandRole).toInt());
+}
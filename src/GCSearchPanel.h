@@ -0,0 +1,42 @@
+#ifndef GCSEARCHPANEL_H
+#define GCSEARCHPANEL_H
+
+#include <QWidget>
+
+class GCModel;
+class GCSearcher;
+class QComboBox;
+class QLabel;
+class QLineEdit;
+class QListWidget;
+class QListWidgetItem;
+
+// Query field and list of results of GCSearcher, activated result is reported to be selected.
+class GCSearchPanel : public QWidget
+{
+	Q_OBJECT
+	Q_DISABLE_COPY(GCSearchPanel)
+
+public:
+	explicit GCSearchPanel(GCModel *model, QWidget *parent = 0);
+
+signals:
+	void commandActivated(int layer, int command);
+
+private slots:
+	void find();
+	void clear();
+	void resultsAdded(int first, int count);
+	void searchProgress(int percent);
+	void searchFinished(int numResults, bool truncated);
+	void itemActivated(QListWidgetItem *item);
+
+private:
+	GCSearcher *m_searcher;
+	QLineEdit *m_queryEdit;
+	QComboBox *m_modeCBox;
+	QListWidget *m_resultList;
+	QLabel *m_statusLabel;
+};
+
+#endif // GCSEARCHPANEL_H
@@ -0,0 +1,482 @@
+#include "GCSearcher.h"
+
+#include "GCModel.h"
+#include "GCJobScheduler.h"
+#include "GCTrace.h"
+#include "GCTree/GCCommand.h"
+
+#include <QByteArray>
+#include <QRegExp>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+// Results kept of one search, further ones are dropped.
+const size_t maxSearchResults = 10000;
+
+// Smallest chunk of mapped file searched by one job.
+const qint64 minSearchChunk = 1024 * 1024;
+
+// Lines searched between checks for cancellation.
+const int searchCheckLines = 4096;
+
+static inline char toLower(char c)
+{
+	return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+static inline char toUpper(char c)
+{
+	return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+}
+
+// Query compiled for matching lines in raw bytes. Jobs hold copies, QRegExp keeps state of last match.
+class GCSearchMatcher
+{
+public:
+	enum Comparison {Less, LessEqual, Equal, NotEqual, GreaterEqual, Greater};
+
+	GCSearchMatcher()
+		: m_mode(GCSearcher::Text), m_text(), m_regExp(), m_letter(0), m_comparison(Equal), m_value(0.0) {}
+
+	QString setQuery(const QString &query, GCSearcher::Mode mode)
+	{
+		m_mode = mode;
+
+		if (query.trimmed().isEmpty()) {
+			return GCSearcher::tr("Nothing to search for.");
+		}
+
+		if (mode == GCSearcher::Text) {
+			m_text = query.toLatin1().toUpper();
+		} else if (mode == GCSearcher::RegExp) {
+			m_regExp = QRegExp(query, Qt::CaseInsensitive);
+
+			if (!m_regExp.isValid()) {
+				return GCSearcher::tr("Invalid regular expression: %1.").arg(m_regExp.errorString());
+			}
+		} else {
+			QRegExp predicate("^\\s*([A-Za-z])\\s*(<=|>=|!=|<|>|=)\\s*(\\S+)\\s*$");
+			bool ok = false;
+
+			if (predicate.indexIn(query) >= 0) {
+				m_value = predicate.cap(3).toDouble(&ok);
+			}
+
+			if (!ok) {
+				return GCSearcher::tr("Expected parameter, comparison and value, e.g. F>6000.");
+			}
+
+			const QString comparisons[] = {"<", "<=", "=", "!=", ">=", ">"};
+			m_letter = predicate.cap(1).toUpper().at(0).toLatin1();
+			m_comparison = static_cast<Comparison>(std::find(comparisons, comparisons + 6, predicate.cap(2)) - comparisons);
+		}
+
+		return QString();
+	}
+
+	bool matches(const char *line, const char *end) const
+	{
+		switch (m_mode) {
+		case GCSearcher::Text:
+			return containsText(line, end);
+		case GCSearcher::RegExp:
+			return m_regExp.indexIn(QString::fromLatin1(line, static_cast<int>(end - line))) >= 0;
+		default:
+			return matchesParameter(line, end);
+		}
+	}
+
+private:
+	// First character is looked for by memchr(), vectorized by C library, rest of query is compared at candidates only.
+	bool containsText(const char *line, const char *end) const
+	{
+		qint64 length = m_text.size();
+		char upper = m_text[0];
+		char lower = toLower(upper);
+
+		while (end - line >= length) {
+			const char *candidate = static_cast<const char *>(std::memchr(line, upper, end - line - length + 1));
+
+			if (lower != upper) {
+				const char *lowerCandidate = static_cast<const char *>(std::memchr(line, lower, (candidate ? candidate : end - length + 1) - line));
+				candidate = lowerCandidate ? lowerCandidate : candidate;
+			}
+
+			if (!candidate) {
+				return false;
+			}
+
+			qint64 i = 1;
+			while (i < length && toUpper(candidate[i]) == m_text[static_cast<int>(i)]) {
+				++i;
+			}
+
+			if (i == length) {
+				return true;
+			}
+
+			line = candidate + 1;
+		}
+
+		return false;
+	}
+
+	bool matchesParameter(const char *line, const char *end) const
+	{
+		// Letter is looked for first, most lines miss most parameters.
+		if (!std::memchr(line, m_letter, end - line) && !std::memchr(line, toLower(m_letter), end - line)) {
+			return false;
+		}
+
+		double value;
+
+		if (!GCModel::scanParam(line, end, m_letter, value)) {
+			return false;
+		}
+
+		switch (m_comparison) {
+		case Less:
+			return value < m_value;
+		case LessEqual:
+			return value <= m_value;
+		case Equal:
+			return value == m_value;
+		case NotEqual:
+			return value != m_value;
+		case GreaterEqual:
+			return value >= m_value;
+		default:
+			return value > m_value;
+		}
+	}
+
+	GCSearcher::Mode m_mode;
+	QByteArray m_text;					// Upper case.
+	QRegExp m_regExp;
+	char m_letter;
+	Comparison m_comparison;
+	double m_value;
+};
+
+// Searches a chunk of the file. Commands of the first layer are counted from the chunk start,
+// GCSearcher adds commands of that layer found by jobs before.
+class GCSearchJob : public GCJob
+{
+public:
+	explicit GCSearchJob(const GCSearchMatcher &matcher)
+		: GCJob(),
+		  results(),
+		  firstLayer(0),
+		  lastLayer(0),
+		  numCommands(0),
+		  numLines(0),
+		  truncated(false),
+		  m_matcher(matcher)
+	{
+	}
+
+	std::vector<GCSearcher::Result> results;
+	int firstLayer;
+	int lastLayer;
+	int numCommands;					// Commands of last layer in the chunk.
+	qint64 numLines;
+	bool truncated;
+
+protected:
+	// Result is added unless there are enough of them already.
+	bool addResult(int layer, int command, qint64 line, const QString &text)
+	{
+		if (results.size() >= maxSearchResults) {
+			truncated = true;
+			return false;
+		}
+
+		results.push_back(GCSearcher::Result());
+		results.back().layer = layer;
+		results.back().command = command;
+		results.back().line = line;
+		results.back().text = text.trimmed();
+
+		return true;
+	}
+
+	GCSearchMatcher m_matcher;
+};
+
+// Lines of mapped file from begin to end, both at line starts.
+class GCMappedSearchJob : public GCSearchJob
+{
+public:
+	GCMappedSearchJob(const GCSearchMatcher &matcher, const char *data, qint64 begin, qint64 end,
+					  const std::vector<qint64> &layerOffsets)
+		: GCSearchJob(matcher),
+		  m_data(data),
+		  m_begin(begin),
+		  m_end(end),
+		  m_layerOffsets(layerOffsets)
+	{
+	}
+
+protected:
+	virtual void run()
+	{
+		GC_TRACE_SCOPE("search chunk");
+
+		int layer = static_cast<int>(std::upper_bound(m_layerOffsets.begin(), m_layerOffsets.end(), m_begin)
+									 - m_layerOffsets.begin()) - 1;
+		qint64 nextLayer = layerEnd(layer);
+		int command = 0;
+
+		firstLayer = layer;
+
+		const char *line = m_data + m_begin;
+		const char *end = m_data + m_end;
+
+		while (line < end) {
+			if (++numLines % searchCheckLines == 0 && isCanceled()) {
+				return;
+			}
+
+			const char *lineEnd = static_cast<const char *>(std::memchr(line, '\n', end - line));
+			const char *nextLine = lineEnd ? lineEnd + 1 : end;
+			lineEnd = lineEnd ? lineEnd : end;
+
+			while (line - m_data >= nextLayer) {
+				nextLayer = layerEnd(++layer);
+				command = 0;
+			}
+
+			if (m_matcher.matches(line, lineEnd)
+					&& !addResult(layer, command, numLines, QString::fromLatin1(line, static_cast<int>(lineEnd - line)))) {
+				// Full chunk has more results than are kept, later lines don't matter.
+				break;
+			}
+
+			command += GCModel::isCommandLine(line, lineEnd) ? 1 : 0;
+			line = nextLine;
+		}
+
+		lastLayer = layer;
+		numCommands = command;
+	}
+
+private:
+	qint64 layerEnd(int layer) const
+	{
+		return static_cast<size_t>(layer) + 1 < m_layerOffsets.size() ? m_layerOffsets[layer + 1]
+																		: std::numeric_limits<qint64>::max();
+	}
+
+	const char *m_data;
+	qint64 m_begin;
+	qint64 m_end;
+	const std::vector<qint64> &m_layerOffsets;
+};
+
+// Commands of layers of the tree, when the file was parsed whole.
+class GCTreeSearchJob : public GCSearchJob
+{
+public:
+	GCTreeSearchJob(const GCSearchMatcher &matcher, const std::vector<const GCTreeItem *> &layers, int firstLayer)
+		: GCSearchJob(matcher),
+		  m_layers(layers),
+		  m_firstLayer(firstLayer),
+		  m_command(0)
+	{
+	}
+
+protected:
+	virtual void run()
+	{
+		GC_TRACE_SCOPE("search layers");
+
+		firstLayer = m_firstLayer;
+		lastLayer = m_firstLayer;
+
+		for (size_t layer = 0; layer < m_layers.size() && !isCanceled() && !truncated; ++layer) {
+			lastLayer = m_firstLayer + static_cast<int>(layer);
+			m_command = 0;
+			searchItem(m_layers[layer]);
+		}
+
+		numCommands = m_command;
+	}
+
+private:
+	void searchItem(const GCTreeItem *item)
+	{
+		int numItems = item->childCount();
+
+		for (int itemNo = 0; itemNo < numItems && !truncated; ++itemNo) {
+			const GCTreeItem *childItem = item->child(itemNo);
+			const GCCommand *gcCommand = dynamic_cast<const GCCommand *>(childItem);
+
+			if (!gcCommand) {
+				searchItem(childItem);
+				continue;
+			}
+
+			QByteArray text = gcCommand->commandText.toLatin1();
+
+			if (m_matcher.matches(text.constData(), text.constData() + text.size())) {
+				addResult(lastLayer, m_command, -1, gcCommand->commandText);
+			}
+
+			++m_command;
+		}
+	}
+
+	std::vector<const GCTreeItem *> m_layers;
+	int m_firstLayer;
+	int m_command;
+};
+
+GCSearcher::GCSearcher(GCModel *model, QObject *parent)
+	: QObject(parent),
+	  m_model(model),
+	  m_layerOffsets(),
+	  m_jobs(),
+	  m_results(),
+	  m_numPublished(0),
+	  m_layer(-1),
+	  m_layerCommands(0),
+	  m_numLines(0),
+	  m_truncated(false)
+{
+	// Jobs read the file and the tree, they must not change under them.
+	connect(m_model, SIGNAL(modelAboutToBeReset()), this, SLOT(cancel()));
+}
+
+GCSearcher::~GCSearcher()
+{
+	cancel();
+}
+
+QString GCSearcher::start(const QString &query, Mode mode)
+{
+	GCSearchMatcher matcher;
+	QString error = matcher.setQuery(query, mode);
+
+	if (!error.isEmpty()) {
+		return error;
+	}
+
+	cancel();
+
+	m_results.clear();
+	m_numPublished = 0;
+	m_layer = -1;
+	m_layerCommands = 0;
+	m_numLines = 0;
+	m_truncated = false;
+
+	// Few chunks per worker balance uneven chunks.
+	int numChunks = qMax(1, GCJobScheduler::globalInstance()->numWorkers() * 4);
+	const char *data = m_model->mappedData();
+
+	if (data) {
+		qint64 size = m_model->mappedSize();
+		qint64 chunkSize = qMax(minSearchChunk, size / numChunks);
+		m_layerOffsets = m_model->layerOffsets();
+
+		for (qint64 begin = 0; begin < size;) {
+			qint64 end = qMin(size, begin + chunkSize);
+			const char *lineEnd = static_cast<const char *>(std::memchr(data + end, '\n', size - end));
+			end = lineEnd ? lineEnd - data + 1 : size;
+
+			m_jobs.push_back(QSharedPointer<GCSearchJob>(new GCMappedSearchJob(matcher, data, begin, end, m_layerOffsets)));
+			begin = end;
+		}
+	} else {
+		int numLayers = m_model->rowCount();
+		int chunkLayers = qMax(1, numLayers / numChunks);
+
+		for (int firstLayer = 0; firstLayer < numLayers; firstLayer += chunkLayers) {
+			std::vector<const GCTreeItem *> layers;
+
+			for (int layer = firstLayer; layer < qMin(numLayers, firstLayer + chunkLayers); ++layer) {
+				layers.push_back(static_cast<const GCTreeItem *>(m_model->index(layer, 0).internalPointer()));
+			}
+
+			m_jobs.push_back(QSharedPointer<GCSearchJob>(new GCTreeSearchJob(matcher, layers, firstLayer)));
+		}
+	}
+
+	for (size_t i = 0; i < m_jobs.size(); ++i) {
+		connect(m_jobs[i].data(), SIGNAL(finished()), this, SLOT(jobFinished()), Qt::QueuedConnection);
+		GCJobScheduler::globalInstance()->submit(m_jobs[i], GCJob::Visible);
+	}
+
+	if (m_jobs.empty()) {
+		emit finished(0, false);
+	}
+
+	return QString();
+}
+
+bool GCSearcher::isRunning() const
+{
+	return !m_jobs.empty();
+}
+
+const std::vector<GCSearcher::Result> &GCSearcher::results() const
+{
+	return m_results;
+}
+
+void GCSearcher::cancel()
+{
+	for (size_t i = 0; i < m_jobs.size(); ++i) {
+		m_jobs[i]->cancel();
+	}
+
+	for (size_t i = 0; i < m_jobs.size(); ++i) {
+		m_jobs[i]->wait();
+	}
+
+	m_jobs.clear();
+}
+
+void GCSearcher::jobFinished()
+{
+	if (m_jobs.empty()) {
+		// Finished job of canceled search.
+		return;
+	}
+
+	// Only finished jobs in file order are published, counts of lines and commands before them are known.
+	size_t first = m_results.size();
+
+	while (m_numPublished < m_jobs.size() && m_jobs[m_numPublished]->isFinished() && !m_truncated) {
+		const GCSearchJob &job = *m_jobs[m_numPublished++];
+		int commandOffset = job.firstLayer == m_layer ? m_layerCommands : 0;
+		size_t i = 0;
+
+		for (; i < job.results.size() && m_results.size() < maxSearchResults; ++i) {
+			m_results.push_back(job.results[i]);
+			Result &result = m_results.back();
+
+			result.command += result.layer == job.firstLayer ? commandOffset : 0;
+			result.line += result.line >= 0 ? m_numLines : 0;
+		}
+
+		m_truncated = job.truncated || i < job.results.size();
+		m_layerCommands = job.firstLayer == job.lastLayer ? commandOffset + job.numCommands : job.numCommands;
+		m_layer = job.lastLayer;
+		m_numLines += job.numLines;
+	}
+
+	if (m_results.size() > first) {
+		emit resultsAdded(static_cast<int>(first), static_cast<int>(m_results.size() - first));
+	}
+
+	if (m_numPublished < m_jobs.size() && !m_truncated) {
+		emit progressChanged(static_cast<int>(m_numPublished * 100 / m_jobs.size()));
+		return;
+	}
+
+	cancel();
+	emit finished(static_cast<int>(m_results.size()), m_truncated);
+}
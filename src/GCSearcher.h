@@ -0,0 +1,65 @@
+#ifndef GCSEARCHER_H
+#define GCSEARCHER_H
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+
+#include <vector>
+
+class GCModel;
+class GCSearchJob;
+
+// Finds lines of the loaded file by text, regular expression or parameter value, e.g. "F>6000".
+// Mapped files are searched in raw bytes, compressed ones in commands of the tree, in chunks by parallel jobs.
+class GCSearcher : public QObject
+{
+	Q_OBJECT
+	Q_DISABLE_COPY(GCSearcher)
+
+public:
+	enum Mode {Text, RegExp, Parameter};
+
+	struct Result {
+		Result()
+			: layer(0), command(0), line(-1), text() {}
+
+		int layer;
+		int command;					// Command of the line in its layer, next one for lines giving no command.
+		qint64 line;					// Counted from 1, -1 when the file was parsed whole.
+		QString text;
+	};
+
+	explicit GCSearcher(GCModel *model, QObject *parent = 0);
+	virtual ~GCSearcher();
+
+	// Returns error of the query, empty string once search is started.
+	QString start(const QString &query, Mode mode);
+	bool isRunning() const;
+	const std::vector<Result> &results() const;
+
+public slots:
+	void cancel();
+
+signals:
+	void progressChanged(int percent);
+	// Results are added in file order as chunks before them are done.
+	void resultsAdded(int first, int count);
+	void finished(int numResults, bool truncated);
+
+private slots:
+	void jobFinished();
+
+private:
+	GCModel *m_model;
+	std::vector<qint64> m_layerOffsets;
+	std::vector<QSharedPointer<GCSearchJob> > m_jobs;
+	std::vector<Result> m_results;
+	size_t m_numPublished;				// Jobs whose results were added.
+	int m_layer;						// Layer of last published line.
+	int m_layerCommands;				// Commands of that layer published so far.
+	qint64 m_numLines;
+	bool m_truncated;
+};
+
+#endif // GCSEARCHER_H
@@ -5,12 +5,20 @@
 
 GCThreadItem::GCThreadItem(const GCCommand &data, QGraphicsItem *parent, QGraphicsScene *scene)
 	: QGraphicsLineItem(data.thread, parent, scene)
+{
+	init(data.threadWidth);
+}
+
+GCThreadItem::GCThreadItem(const QLineF &thread, double width, QGraphicsItem *parent, QGraphicsScene *scene)
+	: QGraphicsLineItem(thread, parent, scene)
+{
+	init(width);
+}
+
+void GCThreadItem::init(double width)
 {
 	setFlag(QGraphicsItem::ItemIsSelectable, true);
-	QPen p = pen();
-	p.setWidthF(data.threadWidth);
-	p.setCapStyle(Qt::RoundCap);
-	setPen(p);
+	setPen(threadPen(width, pen().color()));
 }
 
 void GCThreadItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
@@ -39,3 +47,12 @@ void GCThreadItem::setColor(const QColor &color)
 
 	update();
 }
+
+QPen GCThreadItem::threadPen(double width, const QColor &color)
+{
+	QPen pen(color);
+	pen.setWidthF(width);
+	pen.setCapStyle(Qt::RoundCap);
+
+	return pen;
+}
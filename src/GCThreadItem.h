@@ -4,15 +4,23 @@
 #include "GCTree/GCCommand.h"
 
 #include <QGraphicsLineItem>
+#include <QPen>
 
 class GCThreadItem : public QGraphicsLineItem
 {
 public:
 	GCThreadItem(const GCCommand &data, QGraphicsItem *parent = 0, QGraphicsScene *scene = 0);
+	GCThreadItem(const QLineF &thread, double width, QGraphicsItem *parent = 0, QGraphicsScene *scene = 0);
 
 	virtual void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = 0);
 	virtual QVariant itemChange(GraphicsItemChange change, const QVariant &value);
 	void setColor(const QColor &color);
+
+	// Round capped pen of thread width, shared with GCArcItem and exported layer images.
+	static QPen threadPen(double width, const QColor &color);
+
+private:
+	void init(double width);
 };
 
 #endif // GCTHREADITEM_H
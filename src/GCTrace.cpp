@@ -0,0 +1,160 @@
+#include "GCTrace.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadStorage>
+
+#include <vector>
+
+namespace
+{
+
+struct Event {
+	const char *name;
+	char phase;						// 'X' span, 'C' counter.
+	qint64 timestamp;				// us since start.
+	qint64 value;					// Duration of span, value of counter.
+};
+
+// Every thread writes to its own buffer, lock is contended only while trace is written.
+struct ThreadBuffer {
+	QMutex mutex;
+	QString threadName;
+	std::vector<Event> events;
+};
+
+// Buffers outlive their threads, storage owns only this reference.
+struct BufferRef {
+	ThreadBuffer *buffer;
+};
+
+QMutex buffersMutex;
+std::vector<ThreadBuffer *> buffers;
+QThreadStorage<BufferRef *> threadBuffer;
+QElapsedTimer clock;
+QString traceFileName;
+
+ThreadBuffer *currentBuffer()
+{
+	if (!threadBuffer.hasLocalData()) {
+		BufferRef *ref = new BufferRef();
+		ref->buffer = new ThreadBuffer();
+
+		QThread *thread = QThread::currentThread();
+		if (QCoreApplication::instance() && thread == QCoreApplication::instance()->thread()) {
+			ref->buffer->threadName = "GUI";
+		} else {
+			ref->buffer->threadName = thread->objectName();
+		}
+
+		QMutexLocker locker(&buffersMutex);
+		buffers.push_back(ref->buffer);
+		if (ref->buffer->threadName.isEmpty()) {
+			ref->buffer->threadName = QString("Thread %1").arg(buffers.size() - 1);
+		}
+
+		threadBuffer.setLocalData(ref);
+	}
+
+	return threadBuffer.localData()->buffer;
+}
+
+void record(const char *name, char phase, qint64 timestamp, qint64 value)
+{
+	Event event = {name, phase, timestamp, value};
+	ThreadBuffer *buffer = currentBuffer();
+
+	QMutexLocker locker(&buffer->mutex);
+	buffer->events.push_back(event);
+}
+
+QString escaped(const QString &string)
+{
+	QString result = string;
+	result.replace('\\', "\\\\").replace('"', "\\\"");
+
+	return result;
+}
+
+}
+
+QAtomicInt GCTrace::m_enabled(0);
+
+void GCTrace::start(const QString &fileName)
+{
+	if (fileName.isEmpty()) {
+		return;
+	}
+
+	traceFileName = fileName;
+	clock.start();
+
+	// Probes which see it enabled see the clock started.
+	m_enabled.fetchAndStoreOrdered(1);
+}
+
+bool GCTrace::stop()
+{
+	if (!m_enabled.fetchAndStoreOrdered(0)) {
+		return false;
+	}
+
+	QFile file(traceFileName);
+
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+		return false;
+	}
+
+	QTextStream out(&file);
+	out << "{\"traceEvents\":[\n";
+
+	QMutexLocker locker(&buffersMutex);
+	bool first = true;
+
+	for (size_t tid = 0; tid < buffers.size(); ++tid) {
+		ThreadBuffer *buffer = buffers[tid];
+		QMutexLocker bufferLocker(&buffer->mutex);
+
+		out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+			<< ",\"args\":{\"name\":\"" << escaped(buffer->threadName) << "\"}}";
+		first = false;
+
+		for (size_t eventNo = 0; eventNo < buffer->events.size(); ++eventNo) {
+			const Event &event = buffer->events[eventNo];
+
+			out << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"" << event.phase
+				<< "\",\"pid\":1,\"tid\":" << tid << ",\"ts\":" << event.timestamp;
+
+			if (event.phase == 'X') {
+				out << ",\"dur\":" << event.value << "}";
+			} else {
+				out << ",\"args\":{\"value\":" << event.value << "}}";
+			}
+		}
+
+		buffer->events.clear();
+	}
+
+	out << "\n]}\n";
+
+	return out.status() == QTextStream::Ok;
+}
+
+qint64 GCTrace::now()
+{
+	return clock.nsecsElapsed() / 1000;
+}
+
+void GCTrace::span(const char *name, qint64 begin, qint64 end)
+{
+	record(name, 'X', begin, end - begin);
+}
+
+void GCTrace::counter(const char *name, qint64 value)
+{
+	record(name, 'C', now(), value);
+}
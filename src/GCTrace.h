@@ -0,0 +1,60 @@
+#ifndef GCTRACE_H
+#define GCTRACE_H
+
+#include <QAtomicInt>
+#include <QString>
+#include <QtGlobal>
+
+// Spans and counters written as Chrome trace JSON (chrome://tracing, Perfetto).
+// Enabled by GCVIEWER_TRACE environment variable or --trace command line option, both naming output file.
+// Names must be string literals, they are stored as pointers.
+class GCTrace
+{
+public:
+	static void start(const QString &fileName);
+	static bool stop();
+	static bool isEnabled() {
+		return m_enabled != 0;
+	}
+
+	static qint64 now();
+	static void span(const char *name, qint64 begin, qint64 end);
+	static void counter(const char *name, qint64 value);
+
+private:
+	static QAtomicInt m_enabled;		// Set on GUI thread, tested by every probe on any thread.
+};
+
+// Records span from construction to end of scope.
+class GCTraceScope
+{
+	Q_DISABLE_COPY(GCTraceScope)
+
+public:
+	explicit GCTraceScope(const char *name)
+		: m_name(name),
+		  m_begin(GCTrace::isEnabled() ? GCTrace::now() : 0) {}
+
+	~GCTraceScope() {
+		if (GCTrace::isEnabled()) {
+			GCTrace::span(m_name, m_begin, GCTrace::now());
+		}
+	}
+
+private:
+	const char *m_name;
+	qint64 m_begin;
+};
+
+#define GC_TRACE_CONCAT_(a, b) a##b
+#define GC_TRACE_CONCAT(a, b) GC_TRACE_CONCAT_(a, b)
+#define GC_TRACE_SCOPE(name) GCTraceScope GC_TRACE_CONCAT(gcTraceScope, __LINE__)(name)
+
+#define GC_TRACE_COUNTER(name, value) \
+	do { \
+		if (GCTrace::isEnabled()) { \
+			GCTrace::counter(name, static_cast<qint64>(value)); \
+		} \
+	} while (0)
+
+#endif // GCTRACE_H
@@ -0,0 +1,29 @@
+#include "GCArcCommand.h"
+
+#include <cmath>
+
+double GCArcCommand::length() const
+{
+	return isArc() ? std::fabs(arcSweep) * arcRadius : thread.length();
+}
+
+void GCArcCommand::arcPolyline(double tolerance, std::vector<QPointF> &points) const
+{
+	// Chord of angle a deviates from arc by r * (1 - cos(a / 2)), no piece spans more than quarter of circle.
+	double maxStep = M_PI / 2;
+
+	if (tolerance < arcRadius) {
+		maxStep = qMin(maxStep, 2 * std::acos(1 - tolerance / arcRadius));
+	}
+
+	int numSegments = qMax(1, static_cast<int>(std::ceil(std::fabs(arcSweep) / maxStep)));
+
+	points.push_back(thread.p1());
+
+	for (int segment = 1; segment < numSegments; ++segment) {
+		double angle = arcStartAngle + arcSweep * segment / numSegments;
+		points.push_back(arcCenter + QPointF(std::cos(angle), std::sin(angle)) * arcRadius);
+	}
+
+	points.push_back(thread.p2());
+}
@@ -0,0 +1,29 @@
+#ifndef GCARCCOMMAND_H
+#define GCARCCOMMAND_H
+
+#include "GCCommand.h"
+
+#include <QPointF>
+
+#include <vector>
+
+// G2/G3 move stored as an arc, renderers tessellate it as needed.
+class GCArcCommand : public GCCommand
+{
+public:
+	GCArcCommand(GCTreeNodeItem *parent = 0)
+		: GCCommand(parent), arcCenter(), arcRadius(0.0),
+		  arcStartAngle(0.0), arcSweep(0.0) {}
+
+	virtual bool isArc() const {return arcSweep != 0.0;}
+	virtual double length() const;
+	// Points of polyline deviating at most tolerance from the arc, both ends included.
+	void arcPolyline(double tolerance, std::vector<QPointF> &points) const;
+
+	QPointF arcCenter;
+	double arcRadius;
+	double arcStartAngle;			// Radians, counterclockwise from X axis.
+	double arcSweep;				// Radians, positive counterclockwise (G3), zero for invalid arcs.
+};
+
+#endif // GCARCCOMMAND_H
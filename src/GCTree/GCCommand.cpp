@@ -13,12 +13,18 @@ QVariant GCCommand::data(int role, int column) const
 		break;
 
 	case Qt::ToolTipRole:
-		return QString("Segment length: %1\nSegment width: %2")
-			   .arg(QString::number(thread.length(), 'f', 2))
-			   .arg(QString::number(threadWidth, 'f', 2));
+		return QString("Segment length: %1\nSegment width: %2\nTime: %3 s")
+			   .arg(QString::number(length(), 'f', 2))
+			   .arg(QString::number(threadWidth, 'f', 2))
+			   .arg(QString::number(time, 'f', 3));
 		break;
 
 	default:
 		return QVariant();
 	}
 }
+
+double GCCommand::length() const
+{
+	return thread.length();
+}
@@ -11,17 +11,24 @@ class GCCommand : public GCTreeItem
 public:
 	GCCommand(GCTreeNodeItem *parent = 0)
 		: GCTreeItem(parent), z(0.0), commandText(), threadWidth(0.0),
-		  threadHeight(0.0), thread() {}
+		  threadHeight(0.0), thread(), time(0.0) {}
 
 	virtual TYPE type() {return GC_COMMAND;}
 
 	virtual QVariant data(int role, int column) const;
 
+	// Arcs are GCArcCommand, only G2/G3 moves pay for their parameters.
+	virtual bool isArc() const {return false;}
+	bool isMove() const {return !thread.isNull() || isArc();}
+	virtual double length() const;
+
 	double z;
 	QString commandText;			// G-commnad string.
 	double threadWidth;
 	double threadHeight;
-	QLineF thread;					// 2D graphical representation
+	QLineF thread;					// 2D graphical representation, chord of arc.
+
+	double time;					// Estimated by GCMotionPlanner, seconds.
 };
 
 #endif // GCCOMMAND_H
@@ -6,7 +6,8 @@
 
 GCLayer::GCLayer(double z, GCTreeNodeItem *parent)
 	: GCTreeNodeItem(parent),
-	  m_z(z)
+	  m_z(z),
+	  m_stats()
 {
 
 }
@@ -21,6 +22,11 @@ int GCLayer::addChild(GCTreeItem *child)
 	return -1;
 }
 
+double GCLayer::z() const
+{
+	return m_z;
+}
+
 QVariant GCLayer::data(int role, int column) const
 {
 	if (column != 0) {
@@ -34,10 +40,20 @@ QVariant GCLayer::data(int role, int column) const
 		break;
 
 	case Qt::ToolTipRole:
-		return QString("Layer: %1").arg(m_z);
+		return QString("Layer: %1\n%2").arg(m_z).arg(m_stats.text());
 		break;
 
 	default:
 		return QVariant();
 	}
 }
+
+void GCLayer::setStats(const GCLayerStats &stats)
+{
+	m_stats = stats;
+}
+
+const GCLayerStats &GCLayer::stats() const
+{
+	return m_stats;
+}
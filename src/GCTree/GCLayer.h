@@ -2,6 +2,7 @@
 #define GCLAYER_H
 
 #include "GCTreeItem.h"
+#include "GCLayerStats.h"
 
 #include <QVector>
 
@@ -17,8 +18,13 @@ public:
 
 	virtual QVariant data(int role, int column) const;
 
+	double z() const;
+	void setStats(const GCLayerStats &stats);
+	const GCLayerStats &stats() const;
+
 private:
 	double m_z;
+	GCLayerStats m_stats;
 };
 
 #endif // GCLAYER_H
@@ -0,0 +1,159 @@
+#include "GCLayerStats.h"
+#include "GCArcCommand.h"
+
+#include <QtGlobal>
+
+// Final step of splitmix64, spreads every input bit over the whole result.
+static quint64 mix(quint64 value)
+{
+	value = (value ^ (value >> 30)) * Q_UINT64_C(0xbf58476d1ce4e5b9);
+	value = (value ^ (value >> 27)) * Q_UINT64_C(0x94d049bb133111eb);
+
+	return value ^ (value >> 31);
+}
+
+static quint64 micrometres(double mm)
+{
+	return static_cast<quint64>(qRound64(mm * 1000.0));
+}
+
+// Straight moves and invalid arcs have zero radius and sweep.
+static void arcParameters(const GCCommand *gcCommand, double &arcRadius, double &arcSweep)
+{
+	arcRadius = 0.0;
+	arcSweep = 0.0;
+
+	if (gcCommand->isArc()) {
+		const GCArcCommand *arc = static_cast<const GCArcCommand *>(gcCommand);
+		arcRadius = arc->arcRadius;
+		arcSweep = arc->arcSweep;
+	}
+}
+
+void GCLayerStats::addMove(const QPointF &begin, const QPointF &end, double z, double length, double filament,
+						   double filamentXsectionArea, double arcRadius, double arcSweep)
+{
+	filamentLength += filament;
+	filamentVolume += filament * filamentXsectionArea;
+
+	if (length == 0.0) {
+		return;
+	}
+
+	++numMoves;
+
+	if (filament <= 0.0) {
+		travelLength += length;
+		return;
+	}
+
+	if (!numExtrusions) {
+		minX = maxX = begin.x();
+		minY = maxY = begin.y();
+		minZ = maxZ = z;
+	}
+
+	++numExtrusions;
+	extrusionLength += length;
+	hash += extrusionHash(begin, end, z, arcRadius, arcSweep);
+
+	minX = qMin(minX, qMin(begin.x(), end.x()));
+	maxX = qMax(maxX, qMax(begin.x(), end.x()));
+	minY = qMin(minY, qMin(begin.y(), end.y()));
+	maxY = qMax(maxY, qMax(begin.y(), end.y()));
+	minZ = qMin(minZ, z);
+	maxZ = qMax(maxZ, z);
+}
+
+void GCLayerStats::addMove(const GCCommand *gcCommand, double filament, double filamentXsectionArea)
+{
+	double arcRadius;
+	double arcSweep;
+	arcParameters(gcCommand, arcRadius, arcSweep);
+
+	addMove(gcCommand->thread.p1(), gcCommand->thread.p2(), gcCommand->z, gcCommand->length(), filament,
+			filamentXsectionArea, arcRadius, arcSweep);
+}
+
+void GCLayerStats::add(const GCLayerStats &other)
+{
+	if (other.numExtrusions) {
+		if (!numExtrusions) {
+			minX = other.minX;
+			minY = other.minY;
+			minZ = other.minZ;
+			maxX = other.maxX;
+			maxY = other.maxY;
+			maxZ = other.maxZ;
+		}
+
+		minX = qMin(minX, other.minX);
+		minY = qMin(minY, other.minY);
+		minZ = qMin(minZ, other.minZ);
+		maxX = qMax(maxX, other.maxX);
+		maxY = qMax(maxY, other.maxY);
+		maxZ = qMax(maxZ, other.maxZ);
+	}
+
+	numMoves += other.numMoves;
+	numExtrusions += other.numExtrusions;
+	extrusionLength += other.extrusionLength;
+	travelLength += other.travelLength;
+	filamentLength += other.filamentLength;
+	filamentVolume += other.filamentVolume;
+	printTime += other.printTime;
+	hash += other.hash;
+}
+
+quint64 GCLayerStats::extrusionHash(const QPointF &begin, const QPointF &end, double z, double arcRadius, double arcSweep)
+{
+	quint64 x1 = micrometres(begin.x());
+	quint64 y1 = micrometres(begin.y());
+	quint64 x2 = micrometres(end.x());
+	quint64 y2 = micrometres(end.y());
+
+	// Reversed arc turns the other way, signed arc length tells the two arcs over a chord apart.
+	if (x2 < x1 || (x2 == x1 && y2 < y1)) {
+		qSwap(x1, x2);
+		qSwap(y1, y2);
+		arcSweep = -arcSweep;
+	}
+
+	quint64 ends = mix(mix(mix(mix(x1) ^ y1) ^ x2) ^ y2);
+
+	return mix(mix(mix(ends ^ micrometres(z)) ^ micrometres(arcRadius)) ^ micrometres(arcSweep * arcRadius));
+}
+
+quint64 GCLayerStats::extrusionHash(const GCCommand *gcCommand)
+{
+	double arcRadius;
+	double arcSweep;
+	arcParameters(gcCommand, arcRadius, arcSweep);
+
+	return extrusionHash(gcCommand->thread.p1(), gcCommand->thread.p2(), gcCommand->z, arcRadius, arcSweep);
+}
+
+QString GCLayerStats::text() const
+{
+	int seconds = qRound(printTime);
+
+	QString result = QString("Moves: %1 (%2 extrusions)\nExtrusion length: %3 mm\nTravel length: %4 mm\n"
+							 "Filament: %5 mm (%6 mm3)\nPrint time: %7:%8:%9")
+					 .arg(numMoves).arg(numExtrusions)
+					 .arg(QString::number(extrusionLength, 'f', 1))
+					 .arg(QString::number(travelLength, 'f', 1))
+					 .arg(QString::number(filamentLength, 'f', 1))
+					 .arg(QString::number(filamentVolume, 'f', 1))
+					 .arg(seconds / 3600)
+					 .arg(seconds / 60 % 60, 2, 10, QChar('0'))
+					 .arg(seconds % 60, 2, 10, QChar('0'));
+
+	if (numExtrusions) {
+		result += QString("\nExtent: X %1 - %2, Y %3 - %4, Z %5 - %6")
+				  .arg(QString::number(minX, 'f', 2)).arg(QString::number(maxX, 'f', 2))
+				  .arg(QString::number(minY, 'f', 2)).arg(QString::number(maxY, 'f', 2))
+				  .arg(QString::number(minZ, 'f', 2)).arg(QString::number(maxZ, 'f', 2));
+	}
+
+	return result;
+}
@@ -0,0 +1,44 @@
+#ifndef GCLAYERSTATS_H
+#define GCLAYERSTATS_H
+
+#include <QPointF>
+#include <QString>
+
+class GCCommand;
+
+// Aggregates of moves in a layer, gathered while parsing.
+struct GCLayerStats {
+	GCLayerStats()
+		: numMoves(0), numExtrusions(0),
+		  extrusionLength(0.0), travelLength(0.0), filamentLength(0.0), filamentVolume(0.0), printTime(0.0), hash(0),
+		  minX(0.0), minY(0.0), minZ(0.0), maxX(0.0), maxY(0.0), maxZ(0.0) {}
+
+	// Move extrudes when it feeds filament over non-zero length, like in GCModel::createThread().
+	// Moves of zero length only feed or retract filament, they aren't counted.
+	void addMove(const QPointF &begin, const QPointF &end, double z, double length, double filament, double filamentXsectionArea,
+				 double arcRadius = 0.0, double arcSweep = 0.0);
+	// Parsed move, arcs are hashed with their radius and sweep.
+	void addMove(const GCCommand *gcCommand, double filament, double filamentXsectionArea);
+	void add(const GCLayerStats &other);
+	QString text() const;
+
+	// Same for an extrusion in either direction, ends and arc length are compared to a micrometre.
+	// Straight moves have zero arc radius and sweep.
+	static quint64 extrusionHash(const QPointF &begin, const QPointF &end, double z, double arcRadius, double arcSweep);
+	static quint64 extrusionHash(const GCCommand *gcCommand);
+
+	quint32 numMoves;
+	quint32 numExtrusions;
+	double extrusionLength;			// mm of extruding moves.
+	double travelLength;			// mm of other moves.
+	double filamentLength;			// mm of filament fed, retractions subtracted.
+	double filamentVolume;			// mm^3.
+	double printTime;				// s, estimated by GCMotionPlanner.
+	quint64 hash;					// Sum of extrusion hashes, equal for same extrusions in any order.
+
+	// Extent of extrusions, valid only when there are some. Arcs are bounded by their end points.
+	double minX, minY, minZ;
+	double maxX, maxY, maxZ;
+};
+
+#endif // GCLAYERSTATS_H
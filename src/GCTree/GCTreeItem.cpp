@@ -51,3 +51,19 @@ int GCTreeNodeItem::indexOf(const GCTreeItem *child) const
 {
 	return m_items.indexOf(const_cast<GCTreeItem *>(child));
 }
+
+void GCTreeNodeItem::takeChildren(GCTreeNodeItem *other)
+{
+	for (int i = 0; i < other->m_items.size(); ++i) {
+		other->m_items[i]->m_parent = this;
+	}
+
+	m_items += other->m_items;
+	other->m_items.clear();
+}
+
+void GCTreeNodeItem::deleteChildren()
+{
+	qDeleteAll(m_items);
+	m_items.clear();
+}
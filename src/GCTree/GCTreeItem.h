@@ -50,6 +50,9 @@ public:
 	virtual GCTreeItem *child(int n) const;
 	virtual int addChild(GCTreeItem *child);
 	int indexOf(const GCTreeItem *child) const;
+	// Moves all children of other node behind own children.
+	void takeChildren(GCTreeNodeItem *other);
+	void deleteChildren();
 	virtual TYPE type() {return GC_TREE_NODE_ITEM;}
 
 protected:
@@ -0,0 +1,110 @@
+#include "GCTreeWalker.h"
+
+#include "GCJob.h"
+#include "GCTree/GCCommand.h"
+
+GCTreeWalker::GCTreeWalker()
+{
+}
+
+GCTreeWalker::~GCTreeWalker()
+{
+}
+
+void GCTreeWalker::walk(const GCTreeItem *item, bool mergeRuns, const GCJob *job)
+{
+	if (item) {
+		walkItem(item, mergeRuns, job);
+	}
+}
+
+bool GCTreeWalker::isRunCommand(const GCCommand *gcCommand)
+{
+	return gcCommand && gcCommand->isMove() && !gcCommand->isArc() && gcCommand->threadWidth != 0.0;
+}
+
+void GCTreeWalker::collectExtrusions(GCTreeItem *item, std::vector<GCCommand *> &extrusions)
+{
+	if (!item) {
+		return;
+	}
+
+	int numItems = item->childCount();
+
+	for (int itemNo = 0; itemNo < numItems; ++itemNo) {
+		GCTreeItem *childItem = item->child(itemNo);
+		GCCommand *gcCommand = dynamic_cast<GCCommand *>(childItem);
+
+		if (!gcCommand) {
+			collectExtrusions(childItem, extrusions);
+		} else if (gcCommand->isMove() && gcCommand->threadWidth != 0.0) {
+			extrusions.push_back(gcCommand);
+		}
+	}
+}
+
+void GCTreeWalker::enterItem(int row)
+{
+	Q_UNUSED(row);
+}
+
+void GCTreeWalker::leaveItem()
+{
+}
+
+void GCTreeWalker::visitRun(const std::vector<const GCCommand *> &commands, const std::vector<int> &rows)
+{
+	for (size_t i = 0; i < commands.size(); ++i) {
+		visitCommand(commands[i], rows[i]);
+	}
+}
+
+void GCTreeWalker::visitCommand(const GCCommand *gcCommand, int row)
+{
+	Q_UNUSED(gcCommand);
+	Q_UNUSED(row);
+}
+
+void GCTreeWalker::walkItem(const GCTreeItem *item, bool mergeRuns, const GCJob *job)
+{
+	std::vector<const GCCommand *> commands;
+	std::vector<int> rows;
+	int numItems = item->childCount();
+
+	for (int row = 0; row < numItems && !(job && job->isCanceled()); ++row) {
+		const GCTreeItem *childItem = item->child(row);
+		const GCCommand *gcCommand = dynamic_cast<const GCCommand *>(childItem);
+
+		if (mergeRuns && isRunCommand(gcCommand)) {
+			commands.push_back(gcCommand);
+			rows.push_back(row);
+			continue;
+		}
+
+		// Other moves and nested items end the run, other commands don't.
+		if (!gcCommand || gcCommand->isMove()) {
+			flushRun(commands, rows);
+		}
+
+		if (gcCommand) {
+			visitCommand(gcCommand, row);
+		} else {
+			enterItem(row);
+			walkItem(childItem, mergeRuns, job);
+			leaveItem();
+		}
+	}
+
+	flushRun(commands, rows);
+}
+
+void GCTreeWalker::flushRun(std::vector<const GCCommand *> &commands, std::vector<int> &rows)
+{
+	if (commands.empty()) {
+		return;
+	}
+
+	visitRun(commands, rows);
+	commands.clear();
+	rows.clear();
+}
@@ -0,0 +1,38 @@
+#ifndef GCTREEWALKER_H
+#define GCTREEWALKER_H
+
+#include <vector>
+
+class GCTreeItem;
+class GCCommand;
+class GCJob;
+
+// Walks commands of a tree item in the order 2D view draws them. Consecutive straight extrusions
+// are visited as runs to be simplified together, other commands one by one.
+class GCTreeWalker
+{
+public:
+	GCTreeWalker();
+	virtual ~GCTreeWalker();
+
+	// Without merging runs are visited command by command. Walk stops early once job is canceled.
+	void walk(const GCTreeItem *item, bool mergeRuns = true, const GCJob *job = 0);
+
+	static bool isRunCommand(const GCCommand *gcCommand);
+	// Extrusions in tree order, the same moves as counted by GCLayerStats::addMove().
+	static void collectExtrusions(GCTreeItem *item, std::vector<GCCommand *> &extrusions);
+
+protected:
+	// Child at row of the item being walked is walked next, leaveItem() follows when it is done.
+	virtual void enterItem(int row);
+	virtual void leaveItem();
+	// Commands of run are children at rows, non-moves between them are visited before.
+	virtual void visitRun(const std::vector<const GCCommand *> &commands, const std::vector<int> &rows);
+	virtual void visitCommand(const GCCommand *gcCommand, int row);
+
+private:
+	void walkItem(const GCTreeItem *item, bool mergeRuns, const GCJob *job);
+	void flushRun(std::vector<const GCCommand *> &commands, std::vector<int> &rows);
+};
+
+#endif // GCTREEWALKER_H
@@ -4,7 +4,14 @@
 #include "FilamentSettingsDia.h"
 #include "GC3DViewSettingsDia.h"
 #include "GCModel.h"
+#include "GCDiffer.h"
+#include "GCGzipDevice.h"
 #include "GC2DView.h"
+#include "GCFollower.h"
+#include "GCLayerExporter.h"
+#include "GCLayerExtractor.h"
+#include "GCOverhangAnalyzer.h"
+#include "GCSearchPanel.h"
 
 #ifdef BUILD_3D
 #include "GC3DView.h"
@@ -13,20 +20,33 @@
 #include <QItemSelectionModel>
 #include <QModelIndex>
 #include <QFileDialog>
+#include <QInputDialog>
+#include <QStringList>
 #include <QMessageBox>
 #include <QLabel>
+#include <QDockWidget>
 #include <QFile>
 #include <QDir>
-#include <QTextStream>
 #include <QSettings>
+#include <QStatusBar>
+
+// Resolution of exported layer images.
+const double exportPixelsPerMm = 5;
 
 GCViewerMW::GCViewerMW(QWidget *parent, Qt::WindowFlags flags)
 	: QMainWindow(parent, flags),
 	  ui(0),
+	  m_statsLabel(0),
 	  m_filamentDiameter(0.0),
 	  m_packingDensity(0.0),
 	  m_gcModel(0),
-	  m_gcSelectionModel(0)
+	  m_referenceModel(0),
+	  m_gcSelectionModel(0),
+	  m_layerExporter(0),
+	  m_layerExtractor(0),
+	  m_overhangAnalyzer(0),
+	  m_follower(0),
+	  m_differ(0)
 {
 	ui = new Ui::GCViewerMW();
 	ui->setupUi(this);
@@ -45,9 +65,12 @@ GCViewerMW::GCViewerMW(QWidget *parent, Qt::WindowFlags flags)
 	GC3DView *gc3DView = new GC3DView();
 	GC3DViewSettingsDia gc3DViewSettings;
 	gc3DView->setLOD(gc3DViewSettings.LOD());
+	gc3DView->setMemoryBudget(static_cast<size_t>(gc3DViewSettings.memoryBudget()) * 1024 * 1024);
+	gc3DView->setPrewarm(gc3DViewSettings.prewarm());
 	gc3DView->setGridDimensions(QRectF(0, 0, 200, 200));
 	gc3DView->setModel(m_gcModel);
 	gc3DView->setSelectionModel(m_gcSelectionModel);
+	connect(ui->gc2DView, SIGNAL(sceneMemoryChanged(qint64)), gc3DView, SLOT(setSceneMemoryUsage(qint64)));
 
 	ui->tabWidget->addTab(gc3DView, "3D");
 
@@ -60,6 +83,56 @@ GCViewerMW::GCViewerMW(QWidget *parent, Qt::WindowFlags flags)
 
 	connect(m_gcSelectionModel, SIGNAL(currentChanged(QModelIndex, QModelIndex)), this, SLOT(currentChanged(QModelIndex, QModelIndex)));
 	connect(m_gcModel, SIGNAL(layersNumChanged(int)), this, SLOT(layersNumChanged(int)));
+	connect(m_gcModel, SIGNAL(loadProgress(int)), this, SLOT(loadProgress(int)));
+
+	// Statistics of current layer and whole file.
+	m_statsLabel = new QLabel();
+	m_statsLabel->setAlignment(Qt::AlignLeft | Qt::AlignTop);
+	m_statsLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+	QDockWidget *statsDock = new QDockWidget(tr("Statistics"), this);
+	statsDock->setObjectName("statsDock");
+	statsDock->setWidget(m_statsLabel);
+	addDockWidget(Qt::RightDockWidgetArea, statsDock);
+
+	GCSearchPanel *searchPanel = new GCSearchPanel(m_gcModel);
+	QDockWidget *searchDock = new QDockWidget(tr("Search"), this);
+	searchDock->setObjectName("searchDock");
+	searchDock->setWidget(searchPanel);
+	addDockWidget(Qt::RightDockWidgetArea, searchDock);
+	connect(searchPanel, SIGNAL(commandActivated(int, int)), this, SLOT(selectCommand(int, int)));
+
+	m_layerExporter = new GCLayerExporter(m_gcModel, this);
+	connect(m_layerExporter, SIGNAL(progressChanged(int)), this, SLOT(exportProgress(int)));
+	connect(m_layerExporter, SIGNAL(finished(int, int)), this, SLOT(exportFinished(int, int)));
+
+	m_layerExtractor = new GCLayerExtractor(m_gcModel, this);
+	connect(m_layerExtractor, SIGNAL(progressChanged(int)), this, SLOT(extractProgress(int)));
+	connect(m_layerExtractor, SIGNAL(finished(qint64, QString)), this, SLOT(extractFinished(qint64, QString)));
+
+	m_overhangAnalyzer = new GCOverhangAnalyzer(m_gcModel, this);
+	connect(m_overhangAnalyzer, SIGNAL(progressChanged(int)), this, SLOT(analysisProgress(int)));
+	connect(m_overhangAnalyzer, SIGNAL(finished(int, int)), this, SLOT(analysisFinished(int, int)));
+	ui->gc2DView->setOverhangAnalyzer(m_overhangAnalyzer);
+
+#ifdef BUILD_3D
+	gc3DView->setOverhangAnalyzer(m_overhangAnalyzer);
+#endif // BUILD_3D
+
+	m_follower = new GCFollower(this);
+	connect(m_follower, SIGNAL(lineReached(qint64)), this, SLOT(printerLineReached(qint64)));
+
+	m_referenceModel = new GCModel(this);
+	connect(m_referenceModel, SIGNAL(loadProgress(int)), this, SLOT(referenceLoadProgress(int)));
+	connect(m_referenceModel, SIGNAL(layersNumChanged(int)), this, SLOT(referenceLoaded(int)));
+
+	m_differ = new GCDiffer(m_gcModel, m_referenceModel, this);
+	connect(m_differ, SIGNAL(progressChanged(int)), this, SLOT(compareProgress(int)));
+	connect(m_differ, SIGNAL(finished(int, int, int)), this, SLOT(compareFinished(int, int, int)));
+	ui->gc2DView->setDiffer(m_differ);
+
+#ifdef BUILD_3D
+	gc3DView->setDiffer(m_differ);
+#endif // BUILD_3D
 
 	FilamentSettingsDia filamentSettings;
 	m_filamentDiameter = filamentSettings.filamentDiameter();
@@ -68,6 +141,12 @@ GCViewerMW::GCViewerMW(QWidget *parent, Qt::WindowFlags flags)
 
 GCViewerMW::~GCViewerMW()
 {
+	// Jobs of these read layers of the models, children are deleted in creation order.
+	delete m_differ;
+	delete m_overhangAnalyzer;
+	delete m_layerExtractor;
+	delete m_layerExporter;
+
 	delete ui;
 }
 
@@ -75,24 +154,139 @@ void GCViewerMW::on_action_FileOpen_triggered()
 {
 	QSettings settings;
 
-	QString gcFilename = QFileDialog::getOpenFileName(this, tr("Open File"), settings.value("last_file").toString(), tr("Supported files(*.gcode);;All files(*.*)"));
+	QString gcFilename = QFileDialog::getOpenFileName(this, tr("Open File"), settings.value("last_file").toString(), tr("Supported files(*.gcode *.gcode.gz *.gz);;All files(*.*)"));
 
 	if (!gcFilename.isEmpty()) {
-		QFile gcFile(gcFilename);
+		QIODevice *gcFile = GCGzipDevice::openGCode(gcFilename);
 
-		if (!gcFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+		if (!gcFile) {
 			QMessageBox::critical(this, tr("Error"), tr("Unable to open G-code file."));
 			return;
 		}
 
-		QTextStream g(&gcFile);
-		m_gcModel->loadGCode(g, m_filamentDiameter, m_packingDensity);
+		m_gcModel->loadGCode(gcFile, m_filamentDiameter, m_packingDensity);
+		loadProgress(0);
 
 		QDir dir;
 		settings.setValue("last_file", dir.absoluteFilePath(gcFilename));
 	}
 }
 
+void GCViewerMW::on_action_FileCompare_triggered()
+{
+	if (!m_gcModel->rowCount()) {
+		return;
+	}
+
+	QSettings settings;
+
+	QString fileName = QFileDialog::getOpenFileName(this, tr("Compare With"), settings.value("last_file").toString(), tr("Supported files(*.gcode *.gcode.gz *.gz);;All files(*.*)"));
+
+	if (fileName.isEmpty()) {
+		return;
+	}
+
+	QIODevice *gcFile = GCGzipDevice::openGCode(fileName);
+
+	if (!gcFile) {
+		QMessageBox::critical(this, tr("Error"), tr("Unable to open G-code file."));
+		return;
+	}
+
+	// Layer hashes are gathered while loading, files are compared once it is done.
+	m_referenceModel->loadGCode(gcFile, m_filamentDiameter, m_packingDensity);
+	referenceLoadProgress(0);
+}
+
+void GCViewerMW::on_action_FileExportLayers_triggered()
+{
+	int numLayers = m_gcModel->rowCount();
+
+	if (!numLayers) {
+		return;
+	}
+
+	QSettings settings;
+
+	QString fileName = QFileDialog::getSaveFileName(this, tr("Export Layers"), settings.value("last_export").toString(),
+													tr("PNG images (*.png);;SVG images (*.svg)"));
+
+	if (fileName.isEmpty()) {
+		return;
+	}
+
+	int firstLayer;
+	int lastLayer;
+
+	if (!getLayerRange(tr("Export Layers"), firstLayer, lastLayer)) {
+		return;
+	}
+
+	m_layerExporter->start(fileName, firstLayer - 1, lastLayer - 1, ui->gc2DView->gridDimensions(), exportPixelsPerMm);
+	exportProgress(0);
+
+	QDir dir;
+	settings.setValue("last_export", dir.absoluteFilePath(fileName));
+}
+
+void GCViewerMW::on_action_FileExtractLayers_triggered()
+{
+	if (!m_gcModel->rowCount()) {
+		return;
+	}
+
+	QSettings settings;
+
+	QString fileName = QFileDialog::getSaveFileName(this, tr("Extract Layers"), settings.value("last_extract").toString(),
+													tr("G-code files (*.gcode);;All files(*.*)"));
+
+	if (fileName.isEmpty()) {
+		return;
+	}
+
+	int firstLayer;
+	int lastLayer;
+
+	if (!getLayerRange(tr("Extract Layers"), firstLayer, lastLayer)) {
+		return;
+	}
+
+	// Start script of the printer, e.g. homing and heating, goes before the layers.
+	QByteArray preamble;
+	QString preambleName = QFileDialog::getOpenFileName(this, tr("Preamble (Cancel for none)"),
+														settings.value("last_preamble").toString(),
+														tr("G-code files (*.gcode);;All files(*.*)"));
+
+	if (!preambleName.isEmpty()) {
+		QFile preambleFile(preambleName);
+
+		if (!preambleFile.open(QIODevice::ReadOnly)) {
+			QMessageBox::critical(this, tr("Error"), tr("Unable to open preamble file."));
+			return;
+		}
+
+		preamble = preambleFile.readAll();
+
+		if (!preamble.isEmpty() && !preamble.endsWith('\n')) {
+			preamble += '\n';
+		}
+
+		settings.setValue("last_preamble", preambleName);
+	}
+
+	QString error = m_layerExtractor->start(fileName, firstLayer - 1, lastLayer - 1, preamble);
+
+	if (!error.isEmpty()) {
+		QMessageBox::critical(this, tr("Error"), error);
+		return;
+	}
+
+	extractProgress(0);
+
+	QDir dir;
+	settings.setValue("last_extract", dir.absoluteFilePath(fileName));
+}
+
 void GCViewerMW::on_action_FileQuit_triggered()
 {
 	// Close this G-code viewer window.
@@ -100,6 +294,48 @@ void GCViewerMW::on_action_FileQuit_triggered()
 	close();
 }
 
+void GCViewerMW::on_action_ToolsAnalyzeOverhangs_triggered()
+{
+	if (!m_gcModel->rowCount()) {
+		return;
+	}
+
+	m_overhangAnalyzer->start();
+	analysisProgress(0);
+}
+
+void GCViewerMW::on_action_ToolsFollowPrinter_triggered(bool checked)
+{
+	if (!checked) {
+		m_follower->stop();
+		printerLineReached(0);
+		statusBar()->clearMessage();
+		return;
+	}
+
+	QSettings settings;
+	bool ok;
+
+	QString address = QInputDialog::getText(this, tr("Follow Printer"), tr("TCP port or local socket:"), QLineEdit::Normal,
+											settings.value("follow_address", "5000").toString(), &ok);
+
+	if (!ok || address.isEmpty()) {
+		ui->action_ToolsFollowPrinter->setChecked(false);
+		return;
+	}
+
+	QString error = m_follower->listen(address);
+
+	if (!error.isEmpty()) {
+		ui->action_ToolsFollowPrinter->setChecked(false);
+		QMessageBox::critical(this, tr("Error"), tr("Unable to listen on %1: %2").arg(address).arg(error));
+		return;
+	}
+
+	settings.setValue("follow_address", address);
+	statusBar()->showMessage(tr("Waiting for printer on %1").arg(address));
+}
+
 void GCViewerMW::on_action_SettingsFilament_triggered()
 {
 	FilamentSettingsDia filamentSettings(m_filamentDiameter, m_packingDensity);
@@ -123,9 +359,12 @@ void GCViewerMW::on_action_Settings3DView_triggered()
 		return;
 	}
 
-	GC3DViewSettingsDia gc3DViewSettings(gc3DView->LOD());
+	GC3DViewSettingsDia gc3DViewSettings(gc3DView->LOD(), static_cast<int>(gc3DView->memoryBudget() / (1024 * 1024)),
+										 gc3DView->prewarm());
 	if (gc3DViewSettings.exec()) {
 		gc3DView->setLOD(gc3DViewSettings.LOD());
+		gc3DView->setMemoryBudget(static_cast<size_t>(gc3DViewSettings.memoryBudget()) * 1024 * 1024);
+		gc3DView->setPrewarm(gc3DViewSettings.prewarm());
 	}
 #endif // BUILD_3D
 }
@@ -159,10 +398,200 @@ void GCViewerMW::currentChanged(const QModelIndex &current, const QModelIndex &p
 	Q_UNUSED(previous)
 
 	ui->layerSlider->setValue(GCModel::getLayerIndex(current).row());
+	updateStats();
+}
+
+bool GCViewerMW::getLayerRange(const QString &title, int &firstLayer, int &lastLayer)
+{
+	int numLayers = m_gcModel->rowCount();
+	bool ok = false;
+	QString range = QInputDialog::getText(this, title, tr("Layers (first-last):"), QLineEdit::Normal,
+										  QString("1-%1").arg(numLayers), &ok);
+
+	if (!ok) {
+		return false;
+	}
+
+	// Single number gives one layer.
+	QStringList bounds = range.split('-');
+	bool firstOk = false;
+	bool lastOk = false;
+	firstLayer = bounds[0].trimmed().toInt(&firstOk);
+	lastLayer = bounds.size() > 1 ? bounds[1].trimmed().toInt(&lastOk) : firstLayer;
+	lastOk = lastOk || bounds.size() == 1;
+
+	if (bounds.size() > 2 || !firstOk || !lastOk || firstLayer < 1 || lastLayer < firstLayer || lastLayer > numLayers) {
+		QMessageBox::critical(this, tr("Error"), tr("Invalid layer range."));
+		return false;
+	}
+
+	return true;
+}
+
+void GCViewerMW::updateStats()
+{
+	if (!m_gcModel->rowCount()) {
+		m_statsLabel->clear();
+		return;
+	}
+
+	QString text;
+	int layer = GCModel::getLayerIndex(m_gcSelectionModel->currentIndex()).row();
+
+	if (layer >= 0) {
+		text = tr("Layer %1\n%2\n\n").arg(layer + 1).arg(m_gcModel->layerStats(layer).text());
+	}
+
+	text += tr("File\n%1").arg(m_gcModel->totalStats().text());
+	m_statsLabel->setText(text);
+}
+
+void GCViewerMW::loadProgress(int percent)
+{
+	statusBar()->showMessage(tr("Loading... %1%").arg(percent));
+}
+
+void GCViewerMW::exportProgress(int percent)
+{
+	statusBar()->showMessage(tr("Exporting... %1%").arg(percent));
+}
+
+void GCViewerMW::exportFinished(int numWritten, int numFailed)
+{
+	if (numFailed) {
+		statusBar()->showMessage(tr("Exported %1 layers, %2 could not be written").arg(numWritten).arg(numFailed));
+	} else {
+		statusBar()->showMessage(tr("Exported %1 layers").arg(numWritten));
+	}
+}
+
+void GCViewerMW::extractProgress(int percent)
+{
+	statusBar()->showMessage(tr("Extracting... %1%").arg(percent));
+}
+
+void GCViewerMW::extractFinished(qint64 bytesWritten, const QString &error)
+{
+	if (!error.isEmpty()) {
+		statusBar()->showMessage(tr("Extraction failed: %1").arg(error));
+	} else {
+		statusBar()->showMessage(tr("Extracted %1 MB").arg(bytesWritten / (1024.0 * 1024.0), 0, 'f', 1));
+	}
+}
+
+void GCViewerMW::analysisProgress(int percent)
+{
+	statusBar()->showMessage(tr("Analyzing overhangs... %1%").arg(percent));
+}
+
+void GCViewerMW::analysisFinished(int numOverhangs, int numExtrusions)
+{
+	statusBar()->showMessage(tr("%1 of %2 extrusions overhang").arg(numOverhangs).arg(numExtrusions));
+
+	// Views colored by scores look them up again.
+	ui->gc2DView->updateColors();
+
+#ifdef BUILD_3D
+	GC3DView *gc3DView = qobject_cast<GC3DView *>(ui->tabWidget->widget(1));
+	if (gc3DView) {
+		gc3DView->updateColors();
+	}
+#endif // BUILD_3D
+}
+
+void GCViewerMW::selectCommand(int layer, int command)
+{
+	// Views and layer slider follow current index.
+	QModelIndex index = m_gcModel->commandIndex(layer, command);
+
+	m_gcSelectionModel->setCurrentIndex(index, QItemSelectionModel::ClearAndSelect);
+	ui->gcTreeView->scrollTo(index);
+}
+
+void GCViewerMW::printerLineReached(qint64 line)
+{
+	QModelIndex command = m_gcModel->commandAtLine(line);
+
+	// Views follow per layer, progress inside of it is shown by 3D view without touching the selection.
+	QModelIndex layer = GCModel::getLayerIndex(command);
+
+	if (layer.isValid() && layer != GCModel::getLayerIndex(m_gcSelectionModel->currentIndex())) {
+		m_gcSelectionModel->setCurrentIndex(layer, QItemSelectionModel::ClearAndSelect);
+	}
+
+#ifdef BUILD_3D
+	GC3DView *gc3DView = qobject_cast<GC3DView *>(ui->tabWidget->widget(1));
+	if (gc3DView) {
+		gc3DView->setPrintProgress(command);
+	}
+#endif // BUILD_3D
+
+	if (line > 0) {
+		statusBar()->showMessage(tr("Printer at line %1").arg(line));
+	}
+}
+
+void GCViewerMW::referenceLoadProgress(int percent)
+{
+	statusBar()->showMessage(tr("Loading compared file... %1%").arg(percent));
+}
+
+void GCViewerMW::referenceLoaded(int numLayers)
+{
+	// Missing part of reference would show up as added extrusions.
+	if (!m_referenceModel->loadError().isEmpty()) {
+		statusBar()->clearMessage();
+		QMessageBox::critical(this, tr("Error"), tr("Unable to read compared file: %1").arg(m_referenceModel->loadError()));
+		return;
+	}
+
+	if (numLayers <= 0) {
+		return;
+	}
+
+	m_differ->start();
+
+	if (m_differ->isRunning()) {
+		compareProgress(0);
+	}
+}
+
+void GCViewerMW::compareProgress(int percent)
+{
+	statusBar()->showMessage(tr("Comparing... %1%").arg(percent));
+}
+
+void GCViewerMW::compareFinished(int numChangedLayers, int numAdded, int numRemoved)
+{
+	statusBar()->showMessage(tr("%1 layers differ, %2 extrusions added, %3 removed")
+							 .arg(numChangedLayers).arg(numAdded).arg(numRemoved));
+
+	// Views colored by changes look them up in differ.
+	ui->gc2DView->updateColors();
+
+#ifdef BUILD_3D
+	GC3DView *gc3DView = qobject_cast<GC3DView *>(ui->tabWidget->widget(1));
+	if (gc3DView) {
+		gc3DView->updateColors();
+	}
+#endif // BUILD_3D
 }
 
 void GCViewerMW::layersNumChanged(int value)
 {
+	statusBar()->clearMessage();
+
+	if (!m_gcModel->loadError().isEmpty()) {
+		QMessageBox::warning(this, tr("Error"), tr("G-code file was read only in part: %1").arg(m_gcModel->loadError()));
+	}
+
+	ui->action_FileCompare->setEnabled(value > 0);
+	ui->action_FileExportLayers->setEnabled(value > 0);
+	ui->action_FileExtractLayers->setEnabled(value > 0);
+	ui->action_ToolsAnalyzeOverhangs->setEnabled(value > 0);
+	ui->action_ToolsFollowPrinter->setEnabled(value > 0);
+	updateStats();
+
 	if (value > 0) {
 		ui->layerSlider->setRange(0, m_gcModel->rowCount() - 1);
 		ui->layerSlider->setEnabled(true);
@@ -4,9 +4,14 @@
 #include <QMainWindow>
 
 class GCModel;
+class GCDiffer;
+class GCFollower;
+class GCLayerExporter;
+class GCLayerExtractor;
+class GCOverhangAnalyzer;
 class QItemSelectionModel;
 class QModelIndex;
-class QTextStream;
+class QLabel;
 
 namespace Ui
 {
@@ -24,22 +29,51 @@ public:
 
 private slots:
 	void on_action_FileOpen_triggered();
+	void on_action_FileCompare_triggered();
+	void on_action_FileExportLayers_triggered();
+	void on_action_FileExtractLayers_triggered();
 	void on_action_FileQuit_triggered();
+	void on_action_ToolsAnalyzeOverhangs_triggered();
+	void on_action_ToolsFollowPrinter_triggered(bool checked);
 	void on_action_SettingsFilament_triggered();
 	void on_action_Settings3DView_triggered();
 	void on_action_HelpAbout_triggered();
 	void on_layerSlider_valueChanged(int);
 	void currentChanged(const QModelIndex &, const QModelIndex &);
 	void layersNumChanged(int);
+	void loadProgress(int percent);
+	void exportProgress(int percent);
+	void exportFinished(int numWritten, int numFailed);
+	void extractProgress(int percent);
+	void extractFinished(qint64 bytesWritten, const QString &error);
+	void analysisProgress(int percent);
+	void analysisFinished(int numOverhangs, int numExtrusions);
+	void selectCommand(int layer, int command);
+	void printerLineReached(qint64 line);
+	void referenceLoadProgress(int percent);
+	void referenceLoaded(int numLayers);
+	void compareProgress(int percent);
+	void compareFinished(int numChangedLayers, int numAdded, int numRemoved);
 
 private:
+	// Asks for range of layers numbered from 1, returns false when canceled or invalid.
+	bool getLayerRange(const QString &title, int &firstLayer, int &lastLayer);
+	void updateStats();
+
 	Ui::GCViewerMW *ui;
+	QLabel *m_statsLabel;
 
 	double m_filamentDiameter;
 	double m_packingDensity;
 
 	GCModel *m_gcModel;
+	GCModel *m_referenceModel;			// File compared with the shown one, it has no views.
 	QItemSelectionModel *m_gcSelectionModel;
+	GCLayerExporter *m_layerExporter;
+	GCLayerExtractor *m_layerExtractor;
+	GCOverhangAnalyzer *m_overhangAnalyzer;
+	GCFollower *m_follower;
+	GCDiffer *m_differ;
 };
 
 #endif // GCVIEWERMW_H
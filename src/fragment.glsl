@@ -1,9 +1,81 @@
 #version 130
 
-in vec4 color;
+const int GLOBAL_COLOR = 0;
+const int HIGHLIGHT_COLOR = 1;
+const int SCALAR_COLOR = 2;
+
+uniform int color_mode;
+uniform vec4 global_color;
+
+uniform vec4 object_color;
+uniform vec4 layer_color;
+uniform vec4 path_color;
+uniform vec4 command_color;
+
+// Highlighted segment IDs [first, end).
+uniform uvec2 layer_range;
+uniform uvec2 path_range;
+uniform uvec2 command_range;
+// Segments from printed_end on are not printed yet.
+uniform uint printed_end;
+
+uniform sampler2D segment_scalars;
+uniform sampler1D transfer_function;
+uniform vec2 scalar_range;
+// Segment IDs [first, end) held by segment_scalars.
+uniform uvec2 scalar_segments;
+
+in float shade;
+in float path_segment;
+flat in uint path_first_segment;
+
 out vec4 fragment_color;
 
+bool inRange(uint id, uvec2 range)
+{
+	return id >= range.x && id < range.y;
+}
+
+vec4 printProgressColor(uint id, vec4 color)
+{
+	if (id + 1u == printed_end) {
+		return command_color;
+	} else if (id >= printed_end) {
+		return mix(color, vec4(0.9, 0.9, 0.9, 1.0), 0.8);
+	}
+
+	return color;
+}
+
 void main()
 {
-	fragment_color = color;
+	vec4 color = global_color;
+
+	if (color_mode != GLOBAL_COLOR) {
+		uint id = path_first_segment + uint(path_segment);
+
+		if (color_mode == SCALAR_COLOR) {
+			int width = textureSize(segment_scalars, 0).x;
+			int texel = int(id - scalar_segments.x);
+			float value = inRange(id, scalar_segments) ? texelFetch(segment_scalars, ivec2(texel % width, texel / width), 0).r
+													   : scalar_range.x;
+			color = texture(transfer_function, clamp((value - scalar_range.x) / (scalar_range.y - scalar_range.x), 0.0, 1.0));
+
+			if (inRange(id, command_range)) {
+				color = command_color;
+			}
+		} else if (inRange(id, command_range)) {
+			color = command_color;
+		} else if (inRange(id, path_range)) {
+			color = path_color;
+		} else if (inRange(id, layer_range)) {
+			color = layer_color;
+		} else {
+			color = object_color;
+		}
+
+		color = printProgressColor(id, color);
+	}
+
+	fragment_color = color * shade;
 }
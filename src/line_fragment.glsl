@@ -0,0 +1,67 @@
+#version 130
+
+const uint TRAVEL_SEGMENT = 0xFFFFFFFFu;
+
+uniform bool show_extrusions;
+uniform bool show_travels;
+uniform vec4 travel_color;
+
+uniform vec4 object_color;
+uniform vec4 layer_color;
+uniform vec4 path_color;
+uniform vec4 command_color;
+
+// Highlighted segment IDs [first, end).
+uniform uvec2 layer_range;
+uniform uvec2 path_range;
+uniform uvec2 command_range;
+// Segments from printed_end on are not printed yet.
+uniform uint printed_end;
+
+flat in uint segment_id;
+
+out vec4 fragment_color;
+
+bool inRange(uint id, uvec2 range)
+{
+	return id >= range.x && id < range.y;
+}
+
+vec4 printProgressColor(uint id, vec4 color)
+{
+	if (id + 1u == printed_end) {
+		return command_color;
+	} else if (id >= printed_end) {
+		return mix(color, vec4(0.9, 0.9, 0.9, 1.0), 0.8);
+	}
+
+	return color;
+}
+
+void main()
+{
+	if (segment_id == TRAVEL_SEGMENT) {
+		if (!show_travels) {
+			discard;
+		}
+
+		fragment_color = travel_color;
+		return;
+	}
+
+	if (!show_extrusions) {
+		discard;
+	}
+
+	if (inRange(segment_id, command_range)) {
+		fragment_color = command_color;
+	} else if (inRange(segment_id, path_range)) {
+		fragment_color = path_color;
+	} else if (inRange(segment_id, layer_range)) {
+		fragment_color = layer_color;
+	} else {
+		fragment_color = object_color;
+	}
+
+	fragment_color = printProgressColor(segment_id, fragment_color);
+}
@@ -0,0 +1,19 @@
+#version 130
+
+uniform mat4 proj_view_matrix;
+uniform vec2 clip_z;		// Visible Z range.
+
+in vec3 position;
+in uint line_segment;	// Segment ID, all bits set for travel moves.
+
+flat out uint segment_id;
+
+void main()
+{
+	gl_Position = proj_view_matrix * vec4(position, 1.0);
+
+	gl_ClipDistance[0] = position.z - clip_z.x;
+	gl_ClipDistance[1] = clip_z.y - position.z;
+
+	segment_id = line_segment;
+}
@@ -1,13 +1,62 @@
 #include "GCViewerMW.h"
+#include "GCTrace.h"
+#ifdef BUILD_3D
+#include "GCBatchRenderer.h"
+#endif // BUILD_3D
 
 #include <QApplication>
+#include <QStringList>
+#include <QTextStream>
+
+#include <cstdio>
 
 int main(int argc, char **argv)
 {
 	QApplication app(argc, argv);
 	app.setApplicationName("gcviewer");
 
+	// Command line takes precedence over environment.
+	QString traceFile = QString::fromLocal8Bit(qgetenv("GCVIEWER_TRACE"));
+	QStringList arguments = app.arguments();
+	int traceArg = arguments.indexOf("--trace");
+	if (traceArg >= 0 && traceArg + 1 < arguments.size()) {
+		traceFile = arguments[traceArg + 1];
+	}
+
+	GCTrace::start(traceFile);
+
+	// Snapshots of files are rendered without showing main window.
+	if (arguments.contains("--render")) {
+#ifdef BUILD_3D
+		GCBatchRenderer::Options options;
+		QString error = GCBatchRenderer::parseArguments(arguments, options);
+
+		if (!error.isEmpty()) {
+			QTextStream(stderr) << error << endl;
+			GCTrace::stop();
+			return 1;
+		}
+
+		GCBatchRenderer renderer(options);
+		QObject::connect(&renderer, SIGNAL(finished()), &app, SLOT(quit()), Qt::QueuedConnection);
+		renderer.start();
+		app.exec();
+
+		GCTrace::stop();
+
+		return renderer.exitCode();
+#else
+		QTextStream(stderr) << QObject::tr("GCViewer was built without OpenGL support, --render is not available.") << endl;
+		GCTrace::stop();
+		return 1;
+#endif // BUILD_3D
+	}
+
 	GCViewerMW mainWindow;
 	mainWindow.show();
-	return app.exec();
+	int result = app.exec();
+
+	GCTrace::stop();
+
+	return result;
 }
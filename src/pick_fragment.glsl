@@ -0,0 +1,12 @@
+#version 130
+
+in float path_segment;
+flat in uint path_first_segment;
+
+out uint segment_id;
+
+void main()
+{
+	// Zero is reserved for background.
+	segment_id = path_first_segment + uint(path_segment) + 1u;
+}
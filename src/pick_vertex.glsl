@@ -0,0 +1,22 @@
+#version 130
+
+uniform mat4 proj_view_matrix;
+uniform vec2 clip_z;		// Visible Z range.
+
+in vec3 position;
+in float segment;
+in uint first_segment;
+
+out float path_segment;
+flat out uint path_first_segment;
+
+void main()
+{
+	gl_Position = proj_view_matrix * vec4(position, 1.0);
+
+	gl_ClipDistance[0] = position.z - clip_z.x;
+	gl_ClipDistance[1] = clip_z.y - position.z;
+
+	path_segment = segment;
+	path_first_segment = first_segment;
+}
@@ -1,23 +1,31 @@
 #version 130
 
 uniform mat4 proj_view_matrix;
+uniform vec2 clip_z;		// Visible Z range.
 uniform mat3 normal_matrix;
-uniform vec4 global_color;
 
 in vec3 position;		// gl_Vertex
 in vec3 normal;			// gl_Normal
+in float segment;		// Segment number within path.
+in uint first_segment;	// ID of the first segment of path.
 
-out vec4 color;
+out float shade;
+out float path_segment;
+flat out uint path_first_segment;
 
 void main()
 {
 	vec3 N = normalize(normal_matrix * normal);
 	gl_Position = proj_view_matrix * vec4(position, 1.0);
 
+	gl_ClipDistance[0] = position.z - clip_z.x;
+	gl_ClipDistance[1] = clip_z.y - position.z;
+
 	vec3 L = vec3(0.0, 0.0, 1.0);
 
-	vec4 ambient = global_color * 0.7;
-	vec4 diffuse = global_color * max(dot(N,L), 0.0);
+	// Ambient + diffuse.
+	shade = 0.7 + max(dot(N,L), 0.0);
 
-	color = ambient + diffuse;
+	path_segment = segment;
+	path_first_segment = first_segment;
 }